@@ -0,0 +1,54 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+// Blocking bounded FIFO used to hand whole batches between pipeline stages.
+// Traffic is one item per batch, so a mutex is cheap here; the per-order hot
+// path never touches it.
+template <typename T> class BoundedQueue {
+  public:
+    explicit BoundedQueue(size_t _capacity) : capacity{_capacity} {}
+
+    // Blocks while full. Returns false if the queue was closed.
+    bool Push(T item) {
+        std::unique_lock lock(mutex);
+        not_full.wait(lock, [&] { return closed || items.size() < capacity; });
+        if (closed) {
+            return false;
+        }
+        items.push_back(std::move(item));
+        not_empty.notify_one();
+        return true;
+    }
+
+    // Blocks while empty. Returns false once closed and drained.
+    bool Pop(T &out) {
+        std::unique_lock lock(mutex);
+        not_empty.wait(lock, [&] { return closed || !items.empty(); });
+        if (items.empty()) {
+            return false;
+        }
+        out = std::move(items.front());
+        items.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+
+    void Close() {
+        std::lock_guard lock(mutex);
+        closed = true;
+        not_full.notify_all();
+        not_empty.notify_all();
+    }
+
+  private:
+    size_t capacity;
+    std::deque<T> items;
+    bool closed{false};
+    std::mutex mutex;
+    std::condition_variable not_full;
+    std::condition_variable not_empty;
+};
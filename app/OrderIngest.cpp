@@ -0,0 +1,377 @@
+#include "OrderIngest.h"
+
+#include <arrow/api.h>
+#include <arrow/io/api.h>
+#include <parquet/arrow/reader.h>
+#include <parquet/file_reader.h>
+#include <parquet/properties.h>
+#include <parquet/schema.h>
+
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+
+namespace {
+
+void Check(const arrow::Status &st, const std::string &what) {
+    if (!st.ok()) {
+        throw std::runtime_error(what + ": " + st.ToString());
+    }
+}
+
+SIDE ParseSideString(std::string_view s) {
+    if (s == "B" || s == "BUY")
+        return SIDE::BUY;
+    if (s == "S" || s == "SELL")
+        return SIDE::SELL;
+    throw std::runtime_error("Invalid side value: " + std::string(s));
+}
+
+TYPE ParseTypeString(std::string_view s) {
+    if (s == "LO" || s == "LIMIT_ORDER")
+        return TYPE::LIMIT_ORDER;
+    if (s == "MO" || s == "MARKET_ORDER")
+        return TYPE::MARKET_ORDER;
+    if (s == "IOC" || s == "FAK" || s == "IOC_ORDER")
+        return TYPE::IOC_ORDER;
+    if (s == "FOK" || s == "FOK_ORDER")
+        return TYPE::FOK_ORDER;
+    throw std::runtime_error("Invalid type value: " + std::string(s));
+}
+
+int GetColumnIndex(const std::shared_ptr<arrow::Schema> &schema,
+                   const std::string &name) {
+    const int idx = schema->GetFieldIndex(name);
+    if (idx == -1) {
+        throw std::runtime_error("Missing required column: " + name);
+    }
+    return idx;
+}
+
+// The returned view points into the array's buffers.
+std::string_view StringAt(const arrow::Array &arr, int64_t i) {
+    switch (arr.type_id()) {
+    case arrow::Type::STRING:
+        return static_cast<const arrow::StringArray &>(arr).GetView(i);
+    case arrow::Type::LARGE_STRING:
+        return static_cast<const arrow::LargeStringArray &>(arr).GetView(i);
+    default:
+        throw std::runtime_error("Column is not a string-like type: " +
+                                 arr.type()->ToString());
+    }
+}
+
+// Event times as nanoseconds, from an int64 column (already in ns) or an
+// Arrow timestamp column of any unit.
+std::vector<int64_t> TimestampNanos(const arrow::Array &arr,
+                                    const std::string &name) {
+    int64_t scale = 1;
+    if (arr.type_id() == arrow::Type::TIMESTAMP) {
+        switch (static_cast<const arrow::TimestampType &>(*arr.type()).unit()) {
+        case arrow::TimeUnit::SECOND:
+            scale = 1'000'000'000;
+            break;
+        case arrow::TimeUnit::MILLI:
+            scale = 1'000'000;
+            break;
+        case arrow::TimeUnit::MICRO:
+            scale = 1'000;
+            break;
+        case arrow::TimeUnit::NANO:
+            break;
+        }
+    } else if (arr.type_id() != arrow::Type::INT64) {
+        throw std::runtime_error("Expected '" + name +
+                                 "' to be int64 or timestamp, got: " +
+                                 arr.type()->ToString());
+    }
+    // Both array types store plain int64 values.
+    const auto &values = static_cast<const arrow::Int64Array &>(arr);
+    std::vector<int64_t> out(arr.length());
+    for (int64_t i = 0; i < arr.length(); ++i) {
+        out[i] = values.Value(i) * scale;
+    }
+    return out;
+}
+
+template <typename IndexArray>
+void CopyIndices(const arrow::Array &indices, std::vector<uint32_t> &codes) {
+    const auto &ia = static_cast<const IndexArray &>(indices);
+    for (int64_t i = 0; i < ia.length(); ++i) {
+        codes[i] = static_cast<uint32_t>(ia.Value(i));
+    }
+}
+
+// Integer view of a string-like column. Dictionary-encoded columns reuse
+// their indices directly; plain string columns get a batch-local dictionary.
+// Either way each distinct string is looked at once per batch, not per row.
+class StringCodes {
+  public:
+    explicit StringCodes(const std::shared_ptr<arrow::Array> &arr)
+        : codes(arr->length()) {
+        if (arr->type_id() == arrow::Type::DICTIONARY) {
+            const auto &dict_arr =
+                static_cast<const arrow::DictionaryArray &>(*arr);
+            const auto &values = *dict_arr.dictionary();
+            dict.reserve(values.length());
+            for (int64_t j = 0; j < values.length(); ++j) {
+                dict.emplace_back(StringAt(values, j));
+            }
+            const auto &idx = *dict_arr.indices();
+            switch (idx.type_id()) {
+            case arrow::Type::INT8:
+                CopyIndices<arrow::Int8Array>(idx, codes);
+                break;
+            case arrow::Type::INT16:
+                CopyIndices<arrow::Int16Array>(idx, codes);
+                break;
+            case arrow::Type::INT32:
+                CopyIndices<arrow::Int32Array>(idx, codes);
+                break;
+            case arrow::Type::INT64:
+                CopyIndices<arrow::Int64Array>(idx, codes);
+                break;
+            default:
+                throw std::runtime_error("Unsupported dictionary index type: " +
+                                         idx.type()->ToString());
+            }
+            return;
+        }
+
+        std::unordered_map<std::string_view, uint32_t> seen;
+        for (int64_t i = 0; i < arr->length(); ++i) {
+            if (arr->IsNull(i)) {
+                continue;
+            }
+            const std::string_view s = StringAt(*arr, i);
+            auto [it, inserted] =
+                seen.emplace(s, static_cast<uint32_t>(dict.size()));
+            if (inserted) {
+                dict.emplace_back(s);
+            }
+            codes[i] = it->second;
+        }
+    }
+
+    [[nodiscard]] uint32_t operator[](int64_t i) const { return codes[i]; }
+    [[nodiscard]] const std::vector<std::string> &Dictionary() const {
+        return dict;
+    }
+    std::vector<std::string> TakeDictionary() { return std::move(dict); }
+
+  private:
+    std::vector<uint32_t> codes;
+    std::vector<std::string> dict;
+};
+
+// Parses each dictionary entry the first time a row refers to it.
+template <typename Enum, Enum (*Parse)(std::string_view)> class CodeTable {
+  public:
+    explicit CodeTable(const std::vector<std::string> &_dict)
+        : dict{_dict}, parsed(_dict.size(), false), values(_dict.size()) {}
+
+    Enum operator[](uint32_t code) {
+        if (!parsed[code]) {
+            values[code] = Parse(dict[code]);
+            parsed[code] = true;
+        }
+        return values[code];
+    }
+
+  private:
+    const std::vector<std::string> &dict;
+    std::vector<bool> parsed;
+    std::vector<Enum> values;
+};
+
+OrderBatch DecodeBatch(const arrow::RecordBatch &batch,
+                       const std::string &timestamp_column) {
+    auto schema = batch.schema();
+    const int col_trader = GetColumnIndex(schema, "trader");
+    const int col_side = GetColumnIndex(schema, "side");
+    const int col_price = GetColumnIndex(schema, "price");
+    const int col_qty = GetColumnIndex(schema, "size");
+    const int col_type = GetColumnIndex(schema, "type");
+
+    auto trader_arr = batch.column(col_trader);
+    auto side_arr = batch.column(col_side);
+    auto type_arr = batch.column(col_type);
+    auto price_col = batch.column(col_price);
+    if (price_col->type_id() != arrow::Type::DOUBLE) {
+        throw std::runtime_error("Expected 'price' to be double, got: " +
+                                 price_col->type()->ToString());
+    }
+    auto price_arr = std::static_pointer_cast<arrow::DoubleArray>(price_col);
+    auto qty_col = batch.column(col_qty);
+    if (qty_col->type_id() != arrow::Type::INT64) {
+        throw std::runtime_error("Expected 'size' to be int64, got: " +
+                                 qty_col->type()->ToString());
+    }
+    auto qty_arr = std::static_pointer_cast<arrow::Int64Array>(qty_col);
+    std::shared_ptr<arrow::Array> ts_arr;
+    std::vector<int64_t> ts_nanos;
+    if (!timestamp_column.empty()) {
+        ts_arr = batch.column(GetColumnIndex(schema, timestamp_column));
+        ts_nanos = TimestampNanos(*ts_arr, timestamp_column);
+    }
+
+    StringCodes trader_codes(trader_arr);
+    StringCodes side_codes(side_arr);
+    StringCodes type_codes(type_arr);
+    CodeTable<SIDE, ParseSideString> sides(side_codes.Dictionary());
+    CodeTable<TYPE, ParseTypeString> types(type_codes.Dictionary());
+
+    const int64_t n = batch.num_rows();
+    OrderBatch out;
+    out.trader.reserve(n);
+    out.side.reserve(n);
+    out.type.reserve(n);
+    out.price.reserve(n);
+    out.qty.reserve(n);
+    if (ts_arr) {
+        out.timestamp.reserve(n);
+    }
+
+    for (int64_t i = 0; i < n; ++i) {
+        if (trader_arr->IsNull(i) || side_arr->IsNull(i) ||
+            qty_arr->IsNull(i) || type_arr->IsNull(i) ||
+            (ts_arr && ts_arr->IsNull(i))) {
+            continue;
+        }
+        // Market orders may leave the price empty; they never use it.
+        const TYPE type = types[type_codes[i]];
+        if (price_arr->IsNull(i) && type != TYPE::MARKET_ORDER) {
+            continue;
+        }
+        const int64_t qty64 = qty_arr->Value(i);
+        if (qty64 < 0 || qty64 > std::numeric_limits<uint32_t>::max()) {
+            throw std::runtime_error("Invalid qty out of range: " +
+                                     std::to_string(qty64));
+        }
+        out.trader.push_back(trader_codes[i]);
+        out.side.push_back(sides[side_codes[i]]);
+        out.type.push_back(type);
+        out.price.push_back(price_arr->IsNull(i) ? 0.0 : price_arr->Value(i));
+        out.qty.push_back(static_cast<uint32_t>(qty64));
+        if (ts_arr) {
+            out.timestamp.push_back(ts_nanos[i]);
+        }
+    }
+    out.trader_dict = trader_codes.TakeDictionary();
+    return out;
+}
+
+} // namespace
+
+ParquetOrderSource::ParquetOrderSource(std::string _path, IngestOptions _opts)
+    : path{std::move(_path)}, opts{_opts} {
+    if (opts.decode_threads == 0) {
+        opts.decode_threads = 1;
+    }
+    num_row_groups =
+        parquet::ParquetFileReader::OpenFile(path)->metadata()->num_row_groups();
+
+    for (unsigned w = 0; w < opts.decode_threads; ++w) {
+        queues.push_back(
+            std::make_unique<BoundedQueue<OrderBatch>>(opts.queue_depth));
+    }
+    for (unsigned w = 0; w < opts.decode_threads; ++w) {
+        threads.emplace_back([this, w] { DecodeRowGroups(w); });
+    }
+}
+
+ParquetOrderSource::~ParquetOrderSource() {
+    for (auto &q : queues) {
+        q->Close();
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+}
+
+void ParquetOrderSource::Fail(std::exception_ptr e) {
+    {
+        std::lock_guard lock(error_mutex);
+        if (!error) {
+            error = e;
+        }
+    }
+    for (auto &q : queues) {
+        q->Close();
+    }
+}
+
+void ParquetOrderSource::DecodeRowGroups(unsigned worker) {
+    auto &queue = *queues[worker];
+    try {
+        parquet::arrow::FileReaderBuilder builder;
+        Check(builder.OpenFile(path), "Failed to open parquet file " + path);
+
+        parquet::ArrowReaderProperties props =
+            parquet::default_arrow_reader_properties();
+        props.set_use_threads(true);
+        props.set_pre_buffer(true);
+        props.set_batch_size(opts.batch_size);
+        // Read the string columns as dictionaries so they arrive as integer
+        // codes plus one small table of distinct values.
+        const parquet::SchemaDescriptor *descr =
+            builder.raw_reader()->metadata()->schema();
+        for (const char *name : {"trader", "side", "type"}) {
+            const int idx = descr->ColumnIndex(name);
+            if (idx >= 0) {
+                props.set_read_dictionary(idx, true);
+            }
+        }
+        builder.properties(props);
+
+        std::unique_ptr<parquet::arrow::FileReader> reader;
+        Check(builder.Build(&reader), "Failed to create parquet reader");
+
+        for (int rg = static_cast<int>(worker); rg < num_row_groups;
+             rg += static_cast<int>(opts.decode_threads)) {
+            auto rb_reader_result =
+                reader->GetRecordBatchReader(std::vector<int>{rg});
+            Check(rb_reader_result.status(), "Failed to get RecordBatchReader");
+            std::unique_ptr<arrow::RecordBatchReader> rb_reader =
+                std::move(rb_reader_result).ValueUnsafe();
+
+            while (true) {
+                auto rb_result = rb_reader->Next();
+                Check(rb_result.status(), "Error reading RecordBatch");
+                std::shared_ptr<arrow::RecordBatch> batch = *rb_result;
+                if (!batch)
+                    break;
+                if (!queue.Push(DecodeBatch(*batch, opts.timestamp_column)))
+                    return; // source shut down
+            }
+
+            OrderBatch marker;
+            marker.end_of_row_group = true;
+            if (!queue.Push(std::move(marker)))
+                return;
+        }
+    } catch (...) {
+        Fail(std::current_exception());
+    }
+}
+
+bool ParquetOrderSource::Next(OrderBatch &out) {
+    while (next_row_group < num_row_groups) {
+        auto &queue = *queues[next_row_group % opts.decode_threads];
+        if (!queue.Pop(out)) {
+            std::lock_guard lock(error_mutex);
+            if (error) {
+                std::rethrow_exception(error);
+            }
+            throw std::runtime_error("Parquet reader stopped unexpectedly");
+        }
+        if (out.end_of_row_group) {
+            ++next_row_group;
+        }
+        if (out.Size() > 0) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "BoundedQueue.h"
+#include "orderbook/Order.h"
+
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Decoded orders of one record batch, stored column by column. Trader names
+// are batch-local codes into `trader_dict`; the matcher interns the (small)
+// dictionary once per batch instead of every row's string.
+struct OrderBatch {
+    std::vector<uint32_t> trader;
+    std::vector<SIDE> side;
+    std::vector<TYPE> type;
+    std::vector<double> price;
+    std::vector<uint32_t> qty;
+    // Event time in nanoseconds, filled only when
+    // IngestOptions::timestamp_column is set.
+    std::vector<int64_t> timestamp;
+    std::vector<std::string> trader_dict;
+    // Set on the empty marker batch that closes each row group.
+    bool end_of_row_group{false};
+
+    [[nodiscard]] size_t Size() const { return price.size(); }
+};
+
+struct IngestOptions {
+    // Row groups are decoded concurrently by this many reader threads.
+    unsigned decode_threads = 2;
+    // Decoded batches buffered per reader thread before it blocks.
+    size_t queue_depth = 4;
+    int64_t batch_size = 64 * 1024;
+    // Optional int64 (nanoseconds) or timestamp column holding each order's
+    // event time. Rows with a null timestamp are skipped.
+    std::string timestamp_column;
+};
+
+// Pipelined Parquet reader for the order file. Reader threads each own a
+// FileReader (threaded column decode plus pre-buffered I/O) and take row
+// groups round-robin; Next() hands batches back in file order, so I/O and
+// decode overlap with matching without reordering any orders.
+class ParquetOrderSource {
+  public:
+    ParquetOrderSource(std::string _path, IngestOptions _opts = {});
+    ~ParquetOrderSource();
+
+    ParquetOrderSource(const ParquetOrderSource &) = delete;
+    ParquetOrderSource &operator=(const ParquetOrderSource &) = delete;
+
+    // Next non-empty batch in file order; false at end of file. Rethrows any
+    // error raised on a reader thread.
+    bool Next(OrderBatch &out);
+
+  private:
+    void DecodeRowGroups(unsigned worker);
+    void Fail(std::exception_ptr e);
+
+    std::string path;
+    IngestOptions opts;
+    int num_row_groups{0};
+    int next_row_group{0};
+
+    std::vector<std::unique_ptr<BoundedQueue<OrderBatch>>> queues;
+    std::vector<std::thread> threads;
+
+    std::mutex error_mutex;
+    std::exception_ptr error;
+};
@@ -0,0 +1,173 @@
+#include "TradeWriter.h"
+
+#include <arrow/api.h>
+#include <arrow/io/api.h>
+#include <parquet/arrow/writer.h>
+#include <parquet/properties.h>
+
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+void Check(const arrow::Status &st, const std::string &what) {
+    if (!st.ok()) {
+        throw std::runtime_error(what + ": " + st.ToString());
+    }
+}
+
+std::shared_ptr<arrow::Schema> TradeSchema() {
+    return arrow::schema({
+        arrow::field("buy_order_id", arrow::uint64(), false),
+        arrow::field("sell_order_id", arrow::uint64(), false),
+        arrow::field("timestamp", arrow::int64(), false),
+        arrow::field("price", arrow::float64(), false),
+        arrow::field("buyer", arrow::utf8(), false),
+        arrow::field("seller", arrow::utf8(), false),
+        arrow::field("qty", arrow::uint32(), false),
+    });
+}
+
+template <typename Builder, typename T>
+std::shared_ptr<arrow::Array> BuildColumn(const std::vector<T> &values) {
+    Builder builder;
+    Check(builder.AppendValues(values), "Failed to append trade column");
+    std::shared_ptr<arrow::Array> out;
+    Check(builder.Finish(&out), "Failed to finish trade column");
+    return out;
+}
+
+std::shared_ptr<arrow::Array> BuildNames(const std::vector<TraderId> &ids,
+                                         const std::vector<std::string> &names) {
+    arrow::StringBuilder builder;
+    Check(builder.Reserve(static_cast<int64_t>(ids.size())),
+          "Failed to reserve trader column");
+    for (const TraderId id : ids) {
+        Check(builder.Append(names.at(id)), "Failed to append trader name");
+    }
+    std::shared_ptr<arrow::Array> out;
+    Check(builder.Finish(&out), "Failed to finish trader column");
+    return out;
+}
+
+} // namespace
+
+ParquetTradeWriter::ParquetTradeWriter(const std::string &path,
+                                       const TraderTable &_traders,
+                                       TradeWriterOptions _opts)
+    : traders{_traders}, opts{_opts}, queue{_opts.queue_depth} {
+    if (opts.row_group_size <= 0) {
+        throw std::invalid_argument("Trade row group size must be positive");
+    }
+    auto out = arrow::io::FileOutputStream::Open(path);
+    Check(out.status(), "Failed to open trade output " + path);
+
+    std::shared_ptr<parquet::WriterProperties> props =
+        parquet::WriterProperties::Builder()
+            .max_row_group_length(opts.row_group_size)
+            ->compression(parquet::Compression::ZSTD)
+            ->build();
+    auto opened = parquet::arrow::FileWriter::Open(
+        *TradeSchema(), arrow::default_memory_pool(), *out, props);
+    Check(opened.status(), "Failed to create parquet writer");
+    writer = std::move(opened).ValueUnsafe();
+
+    chunk.qty.reserve(opts.row_group_size);
+    thread = std::thread([this] { WriteLoop(); });
+}
+
+ParquetTradeWriter::~ParquetTradeWriter() {
+    try {
+        Close();
+    } catch (const std::exception &) {
+        // Already reported by an explicit Close(), or unreportable here.
+    }
+}
+
+void ParquetTradeWriter::OnFill(const Fill &fill) {
+    chunk.buy_order_id.push_back(fill.buy_order_id);
+    chunk.sell_order_id.push_back(fill.sell_order_id);
+    chunk.timestamp.push_back(fill.timestamp);
+    chunk.price.push_back(fill.price);
+    chunk.buyer.push_back(fill.buyer);
+    chunk.seller.push_back(fill.seller);
+    chunk.qty.push_back(fill.qty);
+    ++rows;
+    if (static_cast<int64_t>(chunk.Size()) >= opts.row_group_size) {
+        FlushChunk();
+    }
+}
+
+void ParquetTradeWriter::FlushChunk() {
+    for (; traders_sent < traders.Size(); ++traders_sent) {
+        chunk.new_traders.push_back(
+            traders.Name(static_cast<TraderId>(traders_sent)));
+    }
+    if (!queue.Push(std::move(chunk))) {
+        ThrowIfFailed();
+        throw std::runtime_error("Trade writer stopped unexpectedly");
+    }
+    chunk = Chunk{};
+    chunk.qty.reserve(opts.row_group_size);
+}
+
+void ParquetTradeWriter::Close() {
+    if (closed) {
+        return;
+    }
+    closed = true;
+    try {
+        if (chunk.Size() > 0) {
+            FlushChunk();
+        }
+    } catch (...) {
+        Fail(std::current_exception());
+    }
+    queue.Close();
+    thread.join();
+    ThrowIfFailed();
+}
+
+void ParquetTradeWriter::Fail(std::exception_ptr e) {
+    {
+        std::lock_guard lock(error_mutex);
+        if (!error) {
+            error = e;
+        }
+    }
+    queue.Close();
+}
+
+void ParquetTradeWriter::ThrowIfFailed() {
+    std::lock_guard lock(error_mutex);
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void ParquetTradeWriter::WriteLoop() {
+    try {
+        const std::shared_ptr<arrow::Schema> schema = TradeSchema();
+        std::vector<std::string> names;
+        Chunk c;
+        while (queue.Pop(c)) {
+            for (auto &name : c.new_traders) {
+                names.push_back(std::move(name));
+            }
+            const auto n = static_cast<int64_t>(c.Size());
+            auto table = arrow::Table::Make(
+                schema,
+                {BuildColumn<arrow::UInt64Builder>(c.buy_order_id),
+                 BuildColumn<arrow::UInt64Builder>(c.sell_order_id),
+                 BuildColumn<arrow::Int64Builder>(c.timestamp),
+                 BuildColumn<arrow::DoubleBuilder>(c.price),
+                 BuildNames(c.buyer, names), BuildNames(c.seller, names),
+                 BuildColumn<arrow::UInt32Builder>(c.qty)},
+                n);
+            Check(writer->WriteTable(*table, n), "Failed to write trades");
+        }
+        Check(writer->Close(), "Failed to close trade output");
+    } catch (...) {
+        Fail(std::current_exception());
+    }
+}
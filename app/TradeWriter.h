@@ -0,0 +1,84 @@
+#pragma once
+#include "BoundedQueue.h"
+#include "orderbook/Fill.h"
+#include "orderbook/TraderTable.h"
+
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace parquet::arrow {
+class FileWriter;
+}
+
+struct TradeWriterOptions {
+    // Fills per Parquet row group, which is also how often buffered fills
+    // are handed to the writer thread.
+    int64_t row_group_size = 256 * 1024;
+    // Row groups queued for the writer thread before OnFill blocks.
+    size_t queue_depth = 4;
+};
+
+// Streams fills into a Parquet file with one row per fill (buy/sell order
+// id, timestamp, price, buyer/seller name, qty). OnFill only appends to
+// flat column buffers on the matcher thread; every `row_group_size` fills
+// the buffers move to a writer thread that builds the Arrow arrays and
+// writes them as one row group. Memory stays bounded by
+// (queue_depth + 2) row groups however many fills are produced.
+class ParquetTradeWriter : public FillSink {
+  public:
+    ParquetTradeWriter(const std::string &path, const TraderTable &_traders,
+                       TradeWriterOptions _opts = {});
+    // Closes the file if Close() was not called; errors are swallowed.
+    ~ParquetTradeWriter() override;
+
+    ParquetTradeWriter(const ParquetTradeWriter &) = delete;
+    ParquetTradeWriter &operator=(const ParquetTradeWriter &) = delete;
+
+    void OnFill(const Fill &fill) override;
+    // Writes the buffered fills and the file footer, then rethrows any error
+    // raised on the writer thread.
+    void Close();
+
+    [[nodiscard]] uint64_t Rows() const { return rows; }
+
+  private:
+    struct Chunk {
+        std::vector<uint64_t> buy_order_id;
+        std::vector<uint64_t> sell_order_id;
+        std::vector<int64_t> timestamp;
+        std::vector<double> price;
+        std::vector<TraderId> buyer;
+        std::vector<TraderId> seller;
+        std::vector<uint32_t> qty;
+        // Trader names interned since the previous chunk. The writer thread
+        // keeps its own copy of the table so it never reads `traders`,
+        // which the matcher thread keeps growing.
+        std::vector<std::string> new_traders;
+
+        [[nodiscard]] size_t Size() const { return qty.size(); }
+    };
+
+    void FlushChunk();
+    void WriteLoop();
+    void Fail(std::exception_ptr e);
+    void ThrowIfFailed();
+
+    const TraderTable &traders;
+    TradeWriterOptions opts;
+    Chunk chunk;
+    size_t traders_sent{0};
+    uint64_t rows{0};
+    bool closed{false};
+
+    std::unique_ptr<parquet::arrow::FileWriter> writer;
+    BoundedQueue<Chunk> queue;
+    std::thread thread;
+
+    std::mutex error_mutex;
+    std::exception_ptr error;
+};
@@ -0,0 +1,208 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BoundedQueue.h"
+#include "orderbook/BookStats.h"
+#include "orderbook/Fill.h"
+#include "orderbook/Order.h"
+
+// Book settings one what-if run changes.
+struct Variant {
+    std::string name;
+    STP stp{STP::NONE};
+};
+
+struct VariantResult {
+    std::string name;
+    // Including the fills of the shared prefix before the fork, so the
+    // totals match a plain run with the variant's settings.
+    uint64_t fills{0};
+    uint64_t traded_qty{0};
+    double notional{0.0};
+    BookStats stats;
+};
+
+// Runs one order stream through several variants of a book in a single
+// ingest pass. Orders up to `fork_after` go to the base book. The base is
+// then copied once per variant and every later batch is shared by all the
+// copies, which run on up to `threads` workers. Each worker owns a fixed
+// subset of the variants, so every copy sees the batches in order, and the
+// copies are made on the workers in parallel. Exposes the ProcessOrder /
+// ProcessBatch pair the app's driver calls on a book.
+template <typename Book> class VariantFanOut {
+  public:
+    VariantFanOut(Book &_base, std::vector<Variant> _variants,
+                  uint64_t _fork_after, unsigned threads)
+        : base{_base}, variants{std::move(_variants)},
+          fork_after{_fork_after}, results(variants.size()) {
+        const size_t n = std::min<size_t>(std::max(threads, 1u),
+                                          std::max<size_t>(variants.size(), 1));
+        for (size_t w = 0; w < n; ++w) {
+            workers.push_back(std::make_unique<Worker>());
+        }
+    }
+    ~VariantFanOut() { Join(); }
+
+    VariantFanOut(const VariantFanOut &) = delete;
+    VariantFanOut &operator=(const VariantFanOut &) = delete;
+
+    void ProcessOrder(const Order &o, FillSink &sink) {
+        ProcessBatch(std::span<const Order>(&o, 1), sink);
+    }
+
+    // Fills of the shared prefix go to `sink`; the variants' fills are
+    // only totalled.
+    void ProcessBatch(std::span<const Order> orders, FillSink &sink) {
+        if (!forked) {
+            const size_t n = static_cast<size_t>(
+                std::min<uint64_t>(orders.size(), fork_after - seen));
+            CountingSink prefix(&sink);
+            base.ProcessBatch(orders.first(n), prefix);
+            prefix_totals.Add(prefix.totals);
+            seen += n;
+            orders = orders.subspan(n);
+            if (seen < fork_after) {
+                return;
+            }
+            Fork();
+        }
+        if (orders.empty()) {
+            return;
+        }
+        const auto batch =
+            std::make_shared<const std::vector<Order>>(orders.begin(),
+                                                       orders.end());
+        for (auto &w : workers) {
+            w->batches.Push(batch);
+        }
+    }
+
+    // Waits for every variant to finish, then reports them in the order
+    // given. Rethrows the first error a variant hit.
+    std::vector<VariantResult> Finish() {
+        if (!forked) {
+            Fork();
+        }
+        Join();
+        for (const auto &w : workers) {
+            if (w->error) {
+                std::rethrow_exception(w->error);
+            }
+        }
+        return results;
+    }
+
+    [[nodiscard]] size_t Threads() const { return workers.size(); }
+
+  private:
+    using Batch = std::shared_ptr<const std::vector<Order>>;
+
+    // Batches buffered per worker ahead of the slowest variant it runs.
+    static constexpr size_t kQueuedBatches = 8;
+
+    struct Totals {
+        uint64_t fills{0};
+        uint64_t qty{0};
+        double notional{0.0};
+
+        void Add(const Totals &t) {
+            fills += t.fills;
+            qty += t.qty;
+            notional += t.notional;
+        }
+    };
+
+    // Totals fills, passing them on to `next` if set.
+    struct CountingSink : FillSink {
+        explicit CountingSink(FillSink *_next) : next{_next} {}
+        void OnFill(const Fill &f) override {
+            ++totals.fills;
+            totals.qty += f.qty;
+            totals.notional += f.price * f.qty;
+            if (next) {
+                next->OnFill(f);
+            }
+        }
+        FillSink *next;
+        Totals totals;
+    };
+
+    struct Worker {
+        BoundedQueue<Batch> batches{kQueuedBatches};
+        std::thread thread;
+        std::exception_ptr error;
+    };
+
+    void Fork() {
+        forked = true;
+        for (size_t w = 0; w < workers.size(); ++w) {
+            workers[w]->thread = std::thread([this, w] { RunWorker(w); });
+        }
+    }
+
+    void RunWorker(size_t w) {
+        Worker &worker = *workers[w];
+        struct Copy {
+            size_t variant;
+            std::unique_ptr<Book> book;
+            CountingSink sink;
+        };
+        std::vector<Copy> copies;
+        Batch batch;
+        try {
+            for (size_t v = w; v < variants.size(); v += workers.size()) {
+                auto book = std::make_unique<Book>(base);
+                book->SetSelfTradePrevention(variants[v].stp);
+                book->SetDepthSink(nullptr);
+                copies.push_back(
+                    Copy{v, std::move(book), CountingSink(nullptr)});
+            }
+            while (worker.batches.Pop(batch)) {
+                for (Copy &c : copies) {
+                    c.book->ProcessBatch(*batch, c.sink);
+                }
+            }
+            for (Copy &c : copies) {
+                VariantResult &r = results[c.variant];
+                r.name = variants[c.variant].name;
+                r.fills = prefix_totals.fills + c.sink.totals.fills;
+                r.traded_qty = prefix_totals.qty + c.sink.totals.qty;
+                r.notional = prefix_totals.notional + c.sink.totals.notional;
+                r.stats = c.book->Stats();
+            }
+        } catch (...) {
+            worker.error = std::current_exception();
+            // Keep taking batches so the ingest thread never blocks.
+            while (worker.batches.Pop(batch)) {
+            }
+        }
+    }
+
+    void Join() {
+        for (auto &w : workers) {
+            w->batches.Close();
+        }
+        for (auto &w : workers) {
+            if (w->thread.joinable()) {
+                w->thread.join();
+            }
+        }
+    }
+
+    Book &base;
+    std::vector<Variant> variants;
+    uint64_t fork_after;
+    uint64_t seen{0};
+    bool forked{false};
+    Totals prefix_totals;
+    std::vector<VariantResult> results;
+    std::vector<std::unique_ptr<Worker>> workers;
+};
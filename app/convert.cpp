@@ -0,0 +1,88 @@
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "OrderIngest.h"
+#include "orderbook/OrderFile.h"
+#include "orderbook/TraderTable.h"
+
+// Converts the Parquet order file once into the native order file that
+// orderbook_app maps directly (see OrderFile.h), so later runs skip the
+// Parquet decode entirely.
+struct ConvertOptions {
+    std::string input = "data/order_data.parquet";
+    std::string output = "data/order_data.obo";
+    // Integer price units per 1.0; conversion fails on any price that is
+    // not a whole number of units.
+    int64_t price_scale = 1'000'000;
+    IngestOptions ingest;
+};
+
+static ConvertOptions ParseArgs(int argc, char **argv) {
+    ConvertOptions opts;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::runtime_error("Missing value for " + arg);
+            }
+            return argv[++i];
+        };
+        if (arg == "--input") {
+            opts.input = value();
+        } else if (arg == "--output") {
+            opts.output = value();
+        } else if (arg == "--price-scale") {
+            opts.price_scale = std::stoll(value());
+        } else if (arg == "--timestamp-column") {
+            opts.ingest.timestamp_column = value();
+        } else if (arg == "--ingest-threads") {
+            opts.ingest.decode_threads =
+                static_cast<unsigned>(std::stoul(value()));
+        } else if (arg == "--batch-size") {
+            opts.ingest.batch_size = std::stoll(value());
+        } else {
+            throw std::runtime_error("Unknown argument: " + arg);
+        }
+    }
+    if (opts.ingest.batch_size <= 0) {
+        throw std::runtime_error("--batch-size must be positive");
+    }
+    return opts;
+}
+
+int main(int argc, char **argv) {
+    try {
+        const ConvertOptions opts = ParseArgs(argc, argv);
+        const bool timestamps = !opts.ingest.timestamp_column.empty();
+
+        ParquetOrderSource source(opts.input, opts.ingest);
+        OrderFileWriter writer(opts.output, opts.price_scale, timestamps);
+        TraderTable traders;
+        std::vector<TraderId> trader_ids;
+
+        OrderBatch batch;
+        while (source.Next(batch)) {
+            trader_ids.clear();
+            for (const auto &name : batch.trader_dict) {
+                trader_ids.push_back(traders.Intern(name));
+            }
+            for (size_t i = 0; i < batch.Size(); ++i) {
+                writer.Add(timestamps ? batch.timestamp[i] : 0,
+                           trader_ids[batch.trader[i]], batch.side[i],
+                           batch.type[i], batch.price[i], batch.qty[i]);
+            }
+        }
+        writer.Commit(traders);
+
+        std::cout << "Wrote " << writer.Count() << " orders ("
+                  << traders.Size() << " traders) to: " << opts.output
+                  << "\n";
+        return 0;
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,109 @@
+#include <csignal>
+#include <ctime>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include <pthread.h>
+
+#include "orderbook/Gateway.h"
+
+// Serves the order-entry protocol (see GatewayProtocol.h) over a Unix
+// socket and/or loopback TCP until SIGINT or SIGTERM. Symbols 0..N-1 all
+// use the same instrument spec.
+struct GatewayAppOptions {
+    GatewayOptions gateway;
+    uint32_t symbols = 1;
+    double tick_size = 0.01;
+    double min_price = 90.0;
+    double max_price = 110.0;
+    uint32_t max_orders = MatchingEngine::kDefaultMaxOrders;
+};
+
+static GatewayAppOptions ParseArgs(int argc, char **argv) {
+    GatewayAppOptions opts;
+    opts.gateway.unix_path = "/tmp/orderbook_gateway.sock";
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::runtime_error("Missing value for " + arg);
+            }
+            return argv[++i];
+        };
+        if (arg == "--unix") {
+            opts.gateway.unix_path = value();
+        } else if (arg == "--no-unix") {
+            opts.gateway.unix_path.clear();
+        } else if (arg == "--tcp-port") {
+            opts.gateway.tcp_port = std::stoi(value());
+        } else if (arg == "--workers") {
+            opts.gateway.workers = static_cast<uint32_t>(std::stoul(value()));
+        } else if (arg == "--pin") {
+            opts.gateway.pin_threads = true;
+        } else if (arg == "--busy-poll") {
+            opts.gateway.busy_poll = true;
+        } else if (arg == "--symbols") {
+            opts.symbols = static_cast<uint32_t>(std::stoul(value()));
+        } else if (arg == "--tick-size") {
+            opts.tick_size = std::stod(value());
+        } else if (arg == "--min-price") {
+            opts.min_price = std::stod(value());
+        } else if (arg == "--max-price") {
+            opts.max_price = std::stod(value());
+        } else if (arg == "--max-orders") {
+            opts.max_orders = static_cast<uint32_t>(std::stoul(value()));
+        } else {
+            throw std::runtime_error("Unknown argument: " + arg);
+        }
+    }
+    return opts;
+}
+
+int main(int argc, char **argv) {
+    try {
+        const GatewayAppOptions opts = ParseArgs(argc, argv);
+
+        // Block the stop signals before any thread starts, so only
+        // sigwait below ever sees them.
+        sigset_t stop_signals;
+        sigemptyset(&stop_signals);
+        sigaddset(&stop_signals, SIGINT);
+        sigaddset(&stop_signals, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &stop_signals, nullptr);
+
+        Gateway gateway(opts.gateway);
+        const InstrumentSpec spec(opts.tick_size, opts.min_price,
+                                  opts.max_price);
+        for (SymbolId s = 0; s < opts.symbols; ++s) {
+            gateway.AddInstrument(s, spec, opts.max_orders);
+        }
+        gateway.Start();
+
+        std::cout << "Gateway serving " << opts.symbols << " symbol(s) on";
+        if (!opts.gateway.unix_path.empty()) {
+            std::cout << " unix:" << opts.gateway.unix_path;
+        }
+        if (gateway.TcpPort() >= 0) {
+            std::cout << " tcp:127.0.0.1:" << gateway.TcpPort();
+        }
+        std::cout << std::endl;
+
+        // Wake now and then to notice a network thread that failed; Stop()
+        // reports its error.
+        const timespec poll_interval{0, 200'000'000};
+        while (sigtimedwait(&stop_signals, nullptr, &poll_interval) < 0 &&
+               !gateway.Failed()) {
+        }
+        gateway.Stop();
+
+        std::cout << "Sessions: " << gateway.SessionsAccepted()
+                  << ", requests: " << gateway.RequestsHandled()
+                  << ", reports: " << gateway.ReportsSent() << "\n";
+        return 0;
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+}
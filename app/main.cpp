@@ -1,217 +1,425 @@
+#include <algorithm>
+#include <charconv>
 #include <chrono>
+#include <cinttypes>
 #include <cstdint>
+#include <cstdio>
 #include <iostream>
 #include <memory>
+#include <optional>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <vector>
 
+#include "OrderIngest.h"
+#include "TradeWriter.h"
+#include "VariantFanOut.h"
+#include "orderbook/BookStats.h"
+#include "orderbook/Instrument.h"
+#include "orderbook/Journal.h"
 #include "orderbook/Order.h"
 #include "orderbook/OrderBook.h"
+#include "orderbook/OrderFile.h"
+#include "orderbook/TickOrderBook.h"
+#include "orderbook/TraderTable.h"
 
-#include <arrow/api.h>
-#include <arrow/io/api.h>
-#include <parquet/arrow/reader.h>
+struct Options {
+    // Parquet order data, or a native order file made by orderbook_convert
+    // (told apart by its magic bytes).
+    std::string filename = "data/order_data.parquet";
+    // A positive tick size selects the array-based TickOrderBook over the
+    // [min_price, max_price] band instead of the std::map book.
+    double tick_size = 0.0;
+    double min_price = 0.0;
+    double max_price = 0.0;
+    // Non-empty: journal every order to this directory and, on start,
+    // recover the book from it and skip the rows it already holds.
+    std::string journal_dir;
+    // Replay pacing relative to the data's timestamps; 0 runs as fast as
+    // possible. Needs --timestamp-column.
+    double speed = 0.0;
+    // Non-empty: write every fill to this CSV file.
+    std::string trade_log;
+    // Non-empty: stream every fill to this Parquet file.
+    std::string trades_out;
+    TradeWriterOptions trade_writer;
+    IngestOptions ingest;
+    // Non-empty: after the first `fork_after` orders, run the rest of the
+    // input through one copy of the book per variant, on up to
+    // `variant_threads` threads.
+    std::vector<Variant> variants;
+    uint64_t fork_after = 0;
+    unsigned variant_threads =
+        std::max(1u, std::thread::hardware_concurrency());
+};
 
-static SIDE ParseSideString(const std::string &s) {
-    if (s == "B" || s == "BUY")
-        return SIDE::BUY;
-    if (s == "S" || s == "SELL")
-        return SIDE::SELL;
-    throw std::runtime_error("Invalid side value: " + s);
-}
-
-static TYPE ParseTypeString(const std::string &s) {
-    if (s == "LO" || s == "LIMIT_ORDER")
-        return TYPE::LIMIT_ORDER;
-    throw std::runtime_error("Invalid type value: " + s);
-}
-
-static int GetColumnIndex(const std::shared_ptr<arrow::Schema> &schema,
-                          const std::string &name) {
-    const int idx = schema->GetFieldIndex(name);
-    if (idx == -1) {
-        throw std::runtime_error("Missing required column: " + name);
+// Comma-separated self-trade prevention policies, one variant each.
+static std::vector<Variant> ParseVariants(const std::string &list) {
+    std::vector<Variant> variants;
+    size_t begin = 0;
+    while (begin <= list.size()) {
+        const size_t end = std::min(list.find(',', begin), list.size());
+        const std::string name = list.substr(begin, end - begin);
+        Variant v{name};
+        if (name == "none") {
+            v.stp = STP::NONE;
+        } else if (name == "cancel-newest") {
+            v.stp = STP::CANCEL_NEWEST;
+        } else if (name == "cancel-oldest") {
+            v.stp = STP::CANCEL_OLDEST;
+        } else if (name == "decrement") {
+            v.stp = STP::DECREMENT_BOTH;
+        } else {
+            throw std::runtime_error("Unknown variant: " + name);
+        }
+        variants.push_back(v);
+        begin = end + 1;
     }
-    return idx;
+    return variants;
 }
 
-static std::string GetStringValue(const std::shared_ptr<arrow::Array> &arr,
-                                  int64_t i) {
-    if (!arr || arr->IsNull(i))
-        return {};
-
-    switch (arr->type_id()) {
-    case arrow::Type::STRING: {
-        auto a = std::static_pointer_cast<arrow::StringArray>(arr);
-        return a->GetString(i);
-    }
-    case arrow::Type::LARGE_STRING: {
-        auto a = std::static_pointer_cast<arrow::LargeStringArray>(arr);
-        return a->GetString(i);
-    }
-    case arrow::Type::DICTIONARY: {
-        auto dict = std::static_pointer_cast<arrow::DictionaryArray>(arr);
-        const auto &dict_values = dict->dictionary();
-
-        // dictionary values should be strings
-        if (dict_values->type_id() == arrow::Type::STRING) {
-            auto dv = std::static_pointer_cast<arrow::StringArray>(dict_values);
-
-            // indices can be int8/int16/int32/int64 depending on encoding
-            const auto &idx = dict->indices();
-            switch (idx->type_id()) {
-            case arrow::Type::INT8: {
-                auto ia = std::static_pointer_cast<arrow::Int8Array>(idx);
-                return dv->GetString(ia->Value(i));
-            }
-            case arrow::Type::INT16: {
-                auto ia = std::static_pointer_cast<arrow::Int16Array>(idx);
-                return dv->GetString(ia->Value(i));
-            }
-            case arrow::Type::INT32: {
-                auto ia = std::static_pointer_cast<arrow::Int32Array>(idx);
-                return dv->GetString(ia->Value(i));
-            }
-            case arrow::Type::INT64: {
-                auto ia = std::static_pointer_cast<arrow::Int64Array>(idx);
-                return dv->GetString(ia->Value(i));
-            }
-            default:
-                throw std::runtime_error("Unsupported dictionary index type: " +
-                                         idx->type()->ToString());
-            }
-        }
-
-        // Some writers can produce large_string dictionaries
-        if (dict_values->type_id() == arrow::Type::LARGE_STRING) {
-            auto dv =
-                std::static_pointer_cast<arrow::LargeStringArray>(dict_values);
-            const auto &idx = dict->indices();
-            if (idx->type_id() == arrow::Type::INT32) {
-                auto ia = std::static_pointer_cast<arrow::Int32Array>(idx);
-                return dv->GetString(ia->Value(i));
+static Options ParseArgs(int argc, char **argv) {
+    Options opts;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::runtime_error("Missing value for " + arg);
             }
-            throw std::runtime_error(
-                "Unsupported large_string dictionary index type: " +
-                idx->type()->ToString());
+            return argv[++i];
+        };
+        if (arg == "--input") {
+            opts.filename = value();
+        } else if (arg == "--tick-size") {
+            opts.tick_size = std::stod(value());
+        } else if (arg == "--min-price") {
+            opts.min_price = std::stod(value());
+        } else if (arg == "--max-price") {
+            opts.max_price = std::stod(value());
+        } else if (arg == "--ingest-threads") {
+            opts.ingest.decode_threads =
+                static_cast<unsigned>(std::stoul(value()));
+        } else if (arg == "--batch-size") {
+            opts.ingest.batch_size = std::stoll(value());
+        } else if (arg == "--journal") {
+            opts.journal_dir = value();
+        } else if (arg == "--timestamp-column") {
+            opts.ingest.timestamp_column = value();
+        } else if (arg == "--speed") {
+            opts.speed = std::stod(value());
+        } else if (arg == "--trade-log") {
+            opts.trade_log = value();
+        } else if (arg == "--trades-out") {
+            opts.trades_out = value();
+        } else if (arg == "--trade-row-group") {
+            opts.trade_writer.row_group_size = std::stoll(value());
+        } else if (arg == "--variants") {
+            opts.variants = ParseVariants(value());
+        } else if (arg == "--fork-after") {
+            opts.fork_after = std::stoull(value());
+        } else if (arg == "--variant-threads") {
+            opts.variant_threads = static_cast<unsigned>(std::stoul(value()));
+        } else {
+            throw std::runtime_error("Unknown argument: " + arg);
         }
-
-        throw std::runtime_error("Dictionary values are not string type: " +
-                                 dict_values->type()->ToString());
     }
-    default:
-        throw std::runtime_error("Column is not a string-like type: " +
-                                 arr->type()->ToString());
+    if (opts.ingest.batch_size <= 0) {
+        throw std::runtime_error("--batch-size must be positive");
+    }
+    if (opts.speed < 0.0 ||
+        (opts.speed > 0.0 && opts.ingest.timestamp_column.empty())) {
+        throw std::runtime_error(
+            "--speed must be non-negative and needs --timestamp-column");
     }
+    if (!opts.variants.empty() &&
+        (!opts.journal_dir.empty() || !opts.trade_log.empty() ||
+         !opts.trades_out.empty())) {
+        throw std::runtime_error("--variants cannot be combined with "
+                                 "--journal, --trade-log or --trades-out");
+    }
+    return opts;
 }
 
-int main() {
-    auto start = std::chrono::system_clock::now();
-    const std::string filename = "data/order_data.parquet";
-
-    auto infile_result = arrow::io::ReadableFile::Open(filename);
-    if (!infile_result.ok()) {
-        std::cerr << "Failed to open parquet file: " << filename
-                  << " error=" << infile_result.status().ToString() << "\n";
-        return 1;
+// CSV of every fill. For the same input it is byte-identical across runs
+// when timestamps come from the data: prices are printed in shortest
+// round-trip form and nothing depends on the wall clock.
+class TradeLog {
+  public:
+    TradeLog(const std::string &path, const TraderTable &_traders)
+        : traders{_traders} {
+        file = std::fopen(path.c_str(), "w");
+        if (!file) {
+            throw std::runtime_error("Failed to open trade log: " + path);
+        }
+        std::setvbuf(file, nullptr, _IOFBF, 1 << 20);
+        std::fputs("buy_order_id,sell_order_id,timestamp,price,buyer,seller,"
+                   "qty\n",
+                   file);
     }
-    std::shared_ptr<arrow::io::ReadableFile> infile = *infile_result;
+    ~TradeLog() { std::fclose(file); }
 
-    auto reader_result =
-        parquet::arrow::OpenFile(infile, arrow::default_memory_pool());
-    if (!reader_result.ok()) {
-        std::cerr << "Failed to create parquet reader: "
-                  << reader_result.status().ToString() << "\n";
-        return 1;
+    TradeLog(const TradeLog &) = delete;
+    TradeLog &operator=(const TradeLog &) = delete;
+
+    void Write(const Fill &f) {
+        char price[32];
+        *std::to_chars(price, price + sizeof(price) - 1, f.price).ptr = '\0';
+        std::fprintf(file,
+                     "%" PRIu64 ",%" PRIu64 ",%" PRId64 ",%s,%s,%s,%" PRIu32
+                     "\n",
+                     f.buy_order_id, f.sell_order_id, f.timestamp, price,
+                     traders.Name(f.buyer).c_str(),
+                     traders.Name(f.seller).c_str(), f.qty);
     }
-    std::unique_ptr<parquet::arrow::FileReader> reader =
-        std::move(reader_result).ValueUnsafe();
 
-    auto rb_reader_result = reader->GetRecordBatchReader();
-    if (!rb_reader_result.ok()) {
-        std::cerr << "Failed to get RecordBatchReader: "
-                  << rb_reader_result.status().ToString() << "\n";
-        return 1;
+  private:
+    const TraderTable &traders;
+    std::FILE *file;
+};
+
+// Holds each order back until its data timestamp is due, with the first
+// order anchored at the wall-clock time it is seen.
+class ReplayPacer {
+  public:
+    explicit ReplayPacer(double _speed) : speed{_speed} {}
+
+    void Wait(int64_t timestamp) {
+        if (speed <= 0.0) {
+            return;
+        }
+        const auto now = std::chrono::steady_clock::now();
+        if (!started) {
+            started = true;
+            first = timestamp;
+            wall_start = now;
+            return;
+        }
+        const auto due =
+            wall_start +
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double, std::nano>(
+                    static_cast<double>(timestamp - first) / speed));
+        if (now < due) {
+            std::this_thread::sleep_until(due);
+        }
     }
-    std::unique_ptr<arrow::RecordBatchReader> rb_reader =
-        std::move(rb_reader_result).ValueUnsafe();
 
-    OrderBook book;
-    TradeVector trade_vector;
-    trade_vector.reserve(1024);
+  private:
+    double speed;
+    bool started{false};
+    int64_t first{0};
+    std::chrono::steady_clock::time_point wall_start;
+};
+
+// Whether the tick book takes `o`: market and stop-market orders carry no
+// price, any other must lie on the grid and in the band.
+static bool OnGrid(const InstrumentSpec &spec, const Order &o) {
+    return o.Type() == TYPE::MARKET_ORDER || o.Type() == TYPE::STOP_ORDER ||
+           spec.ToTick(o.Price()).has_value();
+}
+
+template <typename Book>
+static int Run(Book &book, const Options &opts,
+               std::chrono::system_clock::time_point start,
+               uint64_t resume_after) {
+    TraderTable traders;
+    std::vector<TraderId> trader_ids;
+    uint64_t total_fills = 0;
+    std::unique_ptr<TradeLog> trade_log;
+    if (!opts.trade_log.empty()) {
+        trade_log = std::make_unique<TradeLog>(opts.trade_log, traders);
+    }
+    std::unique_ptr<ParquetTradeWriter> trades_out;
+    if (!opts.trades_out.empty()) {
+        trades_out = std::make_unique<ParquetTradeWriter>(
+            opts.trades_out, traders, opts.trade_writer);
+    }
+    CallbackSink fill_counter([&](const Fill &f) {
+        ++total_fills;
+        if (trade_log) {
+            trade_log->Write(f);
+        }
+        if (trades_out) {
+            trades_out->OnFill(f);
+        }
+    });
+    const bool replay = !opts.ingest.timestamp_column.empty();
+    ReplayPacer pacer(opts.speed);
+    // The tick book throws on a price off its grid, which would end the
+    // run midway through a batch; such rows are rejected here instead.
+    std::optional<InstrumentSpec> spec;
+    if (opts.tick_size > 0.0) {
+        spec.emplace(opts.tick_size, opts.min_price, opts.max_price);
+    }
+    uint64_t rejected = 0;
 
     uint64_t order_id = 1;
-    while (true) {
-        auto rb_result = rb_reader->Next();
-        if (!rb_result.ok()) {
-            std::cerr << "Error reading RecordBatch: "
-                      << rb_result.status().ToString() << "\n";
-            return 1;
-        }
-        std::shared_ptr<arrow::RecordBatch> batch = *rb_result;
-        if (!batch)
-            break; // EOF
-
-        auto schema = batch->schema();
-
-        auto now = std::chrono::system_clock::now();
-        auto duration_since_start = now - start;
-        const int64_t timestamp =
-            std::chrono::duration_cast<std::chrono::nanoseconds>(
-                duration_since_start)
-                .count();
-        const int col_trader = GetColumnIndex(schema, "trader");
-        const int col_side = GetColumnIndex(schema, "side");
-        const int col_price = GetColumnIndex(schema, "price");
-        const int col_qty = GetColumnIndex(schema, "size");
-        const int col_type = GetColumnIndex(schema, "type");
-
-        // Cast columns to expected Arrow array types
-        auto trader_arr = std::static_pointer_cast<arrow::StringArray>(
-            batch->column(col_trader));
-        auto side_arr = std::static_pointer_cast<arrow::StringArray>(
-            batch->column(col_side));
-        auto price_arr = std::static_pointer_cast<arrow::DoubleArray>(
-            batch->column(col_price));
-        auto qty_col = batch->column(col_qty);
-        if (qty_col->type_id() != arrow::Type::INT64) {
-            throw std::runtime_error("Expected 'size' to be int64, got: " +
-                                     qty_col->type()->ToString());
-        }
-        auto qty_arr = std::static_pointer_cast<arrow::Int64Array>(qty_col);
-        auto type_arr = std::static_pointer_cast<arrow::StringArray>(
-            batch->column(col_type));
-
-        const int64_t n = batch->num_rows();
-        for (int64_t i = 0; i < n; ++i) {
-            if (trader_arr->IsNull(i) || side_arr->IsNull(i) ||
-                price_arr->IsNull(i) || qty_arr->IsNull(i) ||
-                type_arr->IsNull(i)) {
-                continue;
-            }
+    std::vector<Order> orders;
+    // Without a timestamp column, every order of a batch is stamped with
+    // the time the batch reached the matcher.
+    auto batch_timestamp = [&] {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::system_clock::now() - start)
+            .count();
+    };
+    // Queues the next input row, skipping the ones a recovered journal
+    // already holds.
+    auto submit = [&](int64_t ts, TraderId trader, SIDE side, double price,
+                      uint32_t qty, TYPE type) {
+        if (order_id <= resume_after) {
+            order_id++;
+            return;
+        }
+        const Order o(order_id++, ts, trader, side, price, qty, type);
+        if (spec && !OnGrid(*spec, o)) {
+            ++rejected;
+            std::cerr << "Rejected order " << o.OrderId() << ": price "
+                      << price << " off instrument tick grid\n";
+            return;
+        }
+        if (opts.speed > 0.0) {
+            // Paced replay releases orders one at a time.
+            pacer.Wait(ts);
+            book.ProcessOrder(o, fill_counter);
+        } else {
+            orders.push_back(o);
+        }
+    };
+    auto flush = [&] {
+        book.ProcessBatch(orders, fill_counter);
+        orders.clear();
+        if constexpr (requires { book.Flush(); }) {
+            book.Flush();
+        }
+    };
 
-            const std::string trader = GetStringValue(trader_arr, i);
-            const std::string side_s = GetStringValue(side_arr, i);
-            const SIDE side = ParseSideString(side_s);
-            const double price = price_arr->Value(i);
-            const int64_t qty64 = qty_arr->Value(i);
-            if (qty64 < 0 || qty64 > std::numeric_limits<uint32_t>::max()) {
-                throw std::runtime_error("Invalid qty out of range: " +
-                                         std::to_string(qty64));
+    if (OrderFile::Detect(opts.filename)) {
+        // Converted input: records are read straight out of the mapping.
+        const OrderFile file(opts.filename);
+        if (replay && !file.HasTimestamps()) {
+            throw std::runtime_error("Order file has no timestamps: " +
+                                     opts.filename);
+        }
+        for (const auto &name : file.TraderNames()) {
+            trader_ids.push_back(traders.Intern(name));
+        }
+        const auto records = file.Records();
+        const auto chunk = static_cast<size_t>(opts.ingest.batch_size);
+        for (size_t begin = 0; begin < records.size(); begin += chunk) {
+            const size_t end = std::min(records.size(), begin + chunk);
+            const int64_t timestamp = batch_timestamp();
+            for (size_t i = begin; i < end; ++i) {
+                const OrderFileRecord &r = records[i];
+                if (!file.Valid(r)) {
+                    throw std::runtime_error("Corrupt order file record " +
+                                             std::to_string(i));
+                }
+                submit(replay ? r.timestamp : timestamp,
+                       trader_ids[r.trader], r.side, file.Price(r), r.qty,
+                       r.type);
             }
-            const uint32_t qty = static_cast<uint32_t>(qty64);
-            const std::string type_s = GetStringValue(type_arr, i);
-            const TYPE type = ParseTypeString(type_s);
+            flush();
+        }
+        std::cout << "Processed order file: " << opts.filename << "\n";
+    } else {
+        ParquetOrderSource source(opts.filename, opts.ingest);
+        OrderBatch batch;
+        while (source.Next(batch)) {
+            const int64_t timestamp = batch_timestamp();
 
-            Order o(order_id, timestamp, trader, side, price, qty);
+            // Intern the batch's distinct trader names once, then rows only
+            // carry integer codes.
+            trader_ids.clear();
+            for (const auto &name : batch.trader_dict) {
+                trader_ids.push_back(traders.Intern(name));
+            }
 
-            auto trades = book.ProcessOrder(o);
-            trade_vector.insert(trade_vector.end(), trades.begin(),
-                                trades.end());
-            order_id++;
+            for (size_t i = 0; i < batch.Size(); ++i) {
+                submit(replay ? batch.timestamp[i] : timestamp,
+                       trader_ids[batch.trader[i]], batch.side[i],
+                       batch.price[i], batch.qty[i], batch.type[i]);
+            }
+            flush();
         }
+        std::cout << "Processed parquet file: " << opts.filename << "\n";
     }
 
-    std::cout << "Processed parquet file: " << filename << "\n";
-    std::cout << "Total trades: " << trade_vector.size() << "\n";
+    if (trades_out) {
+        trades_out->Close();
+        std::cout << "Wrote " << trades_out->Rows()
+                  << " trades to: " << opts.trades_out << "\n";
+    }
+    std::cout << "Total trades: " << total_fills << "\n";
+    if (rejected != 0) {
+        std::cout << "Rejected orders: " << rejected << "\n";
+    }
+    std::cout << "Distinct traders: " << traders.Size() << "\n";
     return 0;
 }
+
+template <typename Book>
+static int RunVariants(Book &book, const Options &opts,
+                       std::chrono::system_clock::time_point start) {
+    VariantFanOut<Book> fan_out(book, opts.variants, opts.fork_after,
+                                opts.variant_threads);
+    const int rc = Run(fan_out, opts, start, 0);
+    const auto results = fan_out.Finish();
+    std::cout << "Ran " << results.size() << " variant(s) on "
+              << fan_out.Threads() << " thread(s), forked after "
+              << opts.fork_after << " orders\n";
+    for (const VariantResult &r : results) {
+        std::cout << "Variant " << r.name << ": " << r.fills << " trades, "
+                  << r.traded_qty << " traded qty, notional " << r.notional
+                  << ", " << r.stats.resting_orders << " resting orders";
+        if (r.stats.enabled) {
+            std::cout << ", " << r.stats.self_trades_prevented
+                      << " self-trades prevented";
+        }
+        std::cout << "\n";
+    }
+    return rc;
+}
+
+template <typename Book>
+static int RunBook(Book &book, const Options &opts,
+                   std::chrono::system_clock::time_point start) {
+    if (!opts.variants.empty()) {
+        return RunVariants(book, opts, start);
+    }
+    if (opts.journal_dir.empty()) {
+        const int rc = Run(book, opts, start, 0);
+        PrintBookStats(std::cout, book.Stats());
+        return rc;
+    }
+    JournalOptions journal_opts;
+    journal_opts.dir = opts.journal_dir;
+    JournaledBook<Book> journaled(book, journal_opts);
+    const RecoveryStats &rec = journaled.Recovery();
+    std::cout << "Recovered journal " << opts.journal_dir << ": "
+              << rec.snapshot_orders << " resting orders from snapshot @"
+              << rec.snapshot_seq << ", " << rec.replayed
+              << " records replayed, " << rec.truncated_bytes
+              << " torn bytes dropped\n";
+    const int rc = Run(journaled, opts, start, rec.max_order_id);
+    PrintBookStats(std::cout, book.Stats());
+    return rc;
+}
+
+int main(int argc, char **argv) {
+    auto start = std::chrono::system_clock::now();
+    try {
+        const Options opts = ParseArgs(argc, argv);
+
+        if (opts.tick_size > 0.0) {
+            TickOrderBook book(
+                InstrumentSpec(opts.tick_size, opts.min_price, opts.max_price));
+            return RunBook(book, opts, start);
+        }
+        OrderBook book;
+        return RunBook(book, opts, start);
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+}
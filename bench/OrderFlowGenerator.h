@@ -0,0 +1,176 @@
+#pragma once
+#include "orderbook/Instrument.h"
+#include "orderbook/Order.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+struct FlowConfig {
+    uint64_t seed = 1;
+    uint64_t messages = 1'000'000;
+    // Passive orders placed before timing starts, to give the book depth.
+    uint64_t warmup_orders = 100'000;
+    // Fraction of timed messages that cancel a previously placed order.
+    double cancel_ratio = 0.3;
+    // Fraction of timed messages that amend one: mostly size-downs in place,
+    // the rest re-priced by a few ticks on the same side.
+    double amend_ratio = 0.0;
+    // Fraction of new orders priced through the opposite side.
+    double marketable_fraction = 0.1;
+    // Fraction of those marketable orders sent as IOC instead of limit.
+    double ioc_fraction = 0.0;
+    // Typical distance of passive orders from the touch, in ticks.
+    uint32_t depth_ticks = 50;
+    // "uniform": passive distance uniform in [0, depth_ticks);
+    // "exponential": mean depth_ticks / 4, so liquidity clusters at the touch.
+    std::string price_dist = "uniform";
+    uint32_t max_qty = 100;
+    uint32_t num_traders = 1000;
+
+    double tick_size = 0.01;
+    double mid_price = 100.0;
+
+    // Band wide enough for every price the generator can produce.
+    [[nodiscard]] InstrumentSpec Spec() const {
+        const double half = (MaxOffset() + 2) * tick_size;
+        return InstrumentSpec(tick_size, mid_price - half, mid_price + half);
+    }
+    [[nodiscard]] uint32_t MaxOffset() const { return depth_ticks * 4; }
+};
+
+struct FlowMessage {
+    enum class Kind : uint8_t { NEW, CANCEL, MODIFY };
+    Kind kind;
+    SIDE side;
+    TraderId trader;
+    uint32_t qty;
+    uint64_t order_id;
+    double price;
+    TYPE type{TYPE::LIMIT_ORDER};
+
+    [[nodiscard]] Order ToOrder(int64_t timestamp) const {
+        return Order(order_id, timestamp, trader, side, price, qty, type);
+    }
+};
+
+// Deterministic synthetic order flow around a fixed mid. Bids rest below
+// the mid and asks above it; marketable orders are priced into the other
+// side, and cancels and amends target uniformly random earlier passive
+// orders (some of which may have filled in the meantime, as in real flow).
+class OrderFlowGenerator {
+  public:
+    explicit OrderFlowGenerator(const FlowConfig &_cfg)
+        : cfg{_cfg}, rng{_cfg.seed} {}
+
+    std::vector<FlowMessage> Warmup() {
+        std::vector<FlowMessage> out;
+        out.reserve(cfg.warmup_orders);
+        for (uint64_t i = 0; i < cfg.warmup_orders; ++i) {
+            out.push_back(NewOrder(false));
+        }
+        return out;
+    }
+
+    std::vector<FlowMessage> Timed() {
+        std::vector<FlowMessage> out;
+        out.reserve(cfg.messages);
+        std::uniform_real_distribution<double> u(0.0, 1.0);
+        for (uint64_t i = 0; i < cfg.messages; ++i) {
+            const double r = u(rng);
+            if (!resting.empty() && r < cfg.cancel_ratio) {
+                out.push_back(Cancel());
+            } else if (!resting.empty() &&
+                       r < cfg.cancel_ratio + cfg.amend_ratio) {
+                out.push_back(Amend());
+            } else {
+                out.push_back(NewOrder(u(rng) < cfg.marketable_fraction));
+            }
+        }
+        return out;
+    }
+
+  private:
+    uint32_t Offset() {
+        double d;
+        if (cfg.price_dist == "exponential") {
+            std::exponential_distribution<double> e(
+                4.0 / std::max<uint32_t>(cfg.depth_ticks, 1));
+            d = e(rng);
+        } else {
+            std::uniform_real_distribution<double> e(0.0, cfg.depth_ticks);
+            d = e(rng);
+        }
+        return std::min(static_cast<uint32_t>(d), cfg.MaxOffset());
+    }
+
+    FlowMessage NewOrder(bool marketable) {
+        const SIDE side = (rng() & 1) ? SIDE::BUY : SIDE::SELL;
+        // Passive orders sit 1+offset ticks away from the mid on their own
+        // side; marketable ones reach 1+offset ticks into the other side.
+        const double ticks = 1.0 + Offset();
+        const bool above = (side == SIDE::SELL) != marketable;
+        const double price =
+            cfg.mid_price + (above ? ticks : -ticks) * cfg.tick_size;
+
+        FlowMessage m{FlowMessage::Kind::NEW,
+                      side,
+                      static_cast<TraderId>(rng() % cfg.num_traders),
+                      static_cast<uint32_t>(1 + rng() % cfg.max_qty),
+                      next_id++,
+                      price};
+        if (marketable && cfg.ioc_fraction > 0.0) {
+            std::uniform_real_distribution<double> u(0.0, 1.0);
+            if (u(rng) < cfg.ioc_fraction) {
+                m.type = TYPE::IOC_ORDER;
+            }
+        }
+        if (!marketable) {
+            resting.push_back(Resting{m.order_id, m.price, m.qty, side});
+        }
+        return m;
+    }
+
+    FlowMessage Cancel() {
+        const size_t i = rng() % resting.size();
+        const uint64_t id = resting[i].order_id;
+        resting[i] = resting.back();
+        resting.pop_back();
+        return FlowMessage{FlowMessage::Kind::CANCEL, SIDE::BUY, 0, 0, id, 0.0};
+    }
+
+    FlowMessage Amend() {
+        Resting &o = resting[rng() % resting.size()];
+        if (o.qty > 1 && rng() % 4 != 0) {
+            o.qty = 1 + static_cast<uint32_t>(rng() % (o.qty - 1));
+        } else {
+            // Step away from the mid so the order stays passive.
+            const double step = (1.0 + static_cast<double>(rng() % 3)) *
+                                cfg.tick_size;
+            const double away = o.side == SIDE::BUY ? -step : step;
+            if (std::abs(o.price + away - cfg.mid_price) <=
+                cfg.MaxOffset() * cfg.tick_size) {
+                o.price += away;
+            } else {
+                o.price -= away;
+            }
+        }
+        return FlowMessage{FlowMessage::Kind::MODIFY, o.side, 0, o.qty,
+                           o.order_id, o.price};
+    }
+
+    struct Resting {
+        uint64_t order_id;
+        double price;
+        uint32_t qty;
+        SIDE side;
+    };
+
+    FlowConfig cfg;
+    std::mt19937_64 rng;
+    uint64_t next_id{1};
+    std::vector<Resting> resting;
+};
@@ -0,0 +1,314 @@
+#include "LatencyHistogram.h"
+#include "OrderFlowGenerator.h"
+#include "orderbook/OrderBook.h"
+#include "orderbook/TickOrderBook.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct BenchOptions {
+    std::string book = "tick";
+    std::string output;
+    // Positive: runs of consecutive new orders go through ProcessBatch in
+    // groups of up to this many, and each order is charged the batch's
+    // mean latency.
+    size_t batch = 0;
+    // "eager" or "lazy"; see OrderBookOptions. Only the map book has a
+    // lazy mode.
+    std::string cancel_mode = "eager";
+    // "none", "cancel-newest", "cancel-oldest" or "decrement"; see STP.
+    std::string stp_name = "none";
+    STP stp = STP::NONE;
+    OrderBookOptions book_options;
+    FlowConfig flow;
+};
+
+// Named starting points; individual flags given after --workload override.
+void ApplyWorkload(const std::string &name, FlowConfig &flow) {
+    if (name == "balanced") {
+        flow.cancel_ratio = 0.3;
+        flow.marketable_fraction = 0.1;
+    } else if (name == "cancel-heavy") {
+        // Every order can be cancelled at most once, so a >90% cancel share
+        // needs a deep starting book for the cancels to drain.
+        flow.warmup_orders = 1'000'000;
+        flow.messages = 1'000'000;
+        flow.cancel_ratio = 0.92;
+        flow.marketable_fraction = 0.05;
+    } else if (name == "cancel-storm") {
+        // Quote flicker: almost every message pulls a resting order, and
+        // the deep book keeps many orders per level.
+        flow.warmup_orders = 1'000'000;
+        flow.messages = 1'000'000;
+        flow.cancel_ratio = 0.97;
+        flow.marketable_fraction = 0.02;
+        flow.depth_ticks = 20;
+    } else if (name == "amend-heavy") {
+        flow.cancel_ratio = 0.1;
+        flow.amend_ratio = 0.4;
+        flow.marketable_fraction = 0.1;
+    } else if (name == "ingest") {
+        // What the Parquet driver sends: new orders only, a share of them
+        // crossing.
+        flow.cancel_ratio = 0.0;
+        flow.marketable_fraction = 0.3;
+    } else if (name == "aggressive") {
+        flow.cancel_ratio = 0.1;
+        flow.marketable_fraction = 0.5;
+        flow.ioc_fraction = 0.8;
+        flow.price_dist = "exponential";
+    } else {
+        throw std::runtime_error("Unknown workload: " + name);
+    }
+}
+
+STP ParseStp(const std::string &name) {
+    if (name == "none") {
+        return STP::NONE;
+    } else if (name == "cancel-newest") {
+        return STP::CANCEL_NEWEST;
+    } else if (name == "cancel-oldest") {
+        return STP::CANCEL_OLDEST;
+    } else if (name == "decrement") {
+        return STP::DECREMENT_BOTH;
+    }
+    throw std::runtime_error("Unknown self-trade prevention: " + name);
+}
+
+BenchOptions ParseArgs(int argc, char **argv) {
+    BenchOptions opts;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::runtime_error("Missing value for " + arg);
+            }
+            return argv[++i];
+        };
+        if (arg == "--book") {
+            opts.book = value();
+        } else if (arg == "--output") {
+            opts.output = value();
+        } else if (arg == "--batch") {
+            opts.batch = std::stoull(value());
+        } else if (arg == "--cancel-mode") {
+            opts.cancel_mode = value();
+            if (opts.cancel_mode != "eager" && opts.cancel_mode != "lazy") {
+                throw std::runtime_error("Unknown cancel mode: " +
+                                         opts.cancel_mode);
+            }
+            opts.book_options.lazy_cancel = opts.cancel_mode == "lazy";
+        } else if (arg == "--stp") {
+            opts.stp_name = value();
+            opts.stp = ParseStp(opts.stp_name);
+        } else if (arg == "--traders") {
+            opts.flow.num_traders = static_cast<uint32_t>(std::stoul(value()));
+        } else if (arg == "--compact-threshold") {
+            opts.book_options.compact_threshold = std::stoull(value());
+        } else if (arg == "--workload") {
+            ApplyWorkload(value(), opts.flow);
+        } else if (arg == "--seed") {
+            opts.flow.seed = std::stoull(value());
+        } else if (arg == "--messages") {
+            opts.flow.messages = std::stoull(value());
+        } else if (arg == "--warmup") {
+            opts.flow.warmup_orders = std::stoull(value());
+        } else if (arg == "--cancel-ratio") {
+            opts.flow.cancel_ratio = std::stod(value());
+        } else if (arg == "--ioc") {
+            opts.flow.ioc_fraction = std::stod(value());
+        } else if (arg == "--amend-ratio") {
+            opts.flow.amend_ratio = std::stod(value());
+        } else if (arg == "--marketable") {
+            opts.flow.marketable_fraction = std::stod(value());
+        } else if (arg == "--depth") {
+            opts.flow.depth_ticks = static_cast<uint32_t>(std::stoul(value()));
+        } else if (arg == "--price-dist") {
+            opts.flow.price_dist = value();
+        } else {
+            throw std::runtime_error("Unknown argument: " + arg);
+        }
+    }
+    return opts;
+}
+
+struct BenchResult {
+    LatencyHistogram process_order;
+    LatencyHistogram cancel_order;
+    LatencyHistogram modify_order;
+    uint64_t fills{0};
+    uint64_t cancels_hit{0};
+    int64_t elapsed_ns{0};
+};
+
+template <typename Book>
+BenchResult RunFlow(Book &book, const std::vector<FlowMessage> &warmup,
+                    const std::vector<FlowMessage> &timed, size_t batch) {
+    BenchResult r;
+    CallbackSink fill_counter([&](const Fill &) { ++r.fills; });
+
+    for (const auto &m : warmup) {
+        book.ProcessOrder(m.ToOrder(0), fill_counter);
+    }
+    r.fills = 0;
+
+    // Orders are built before the clock starts, as a decoded batch would be.
+    std::vector<Order> orders;
+    if (batch > 0) {
+        orders.reserve(timed.size());
+        int64_t ts = 0;
+        for (const auto &m : timed) {
+            if (m.kind == FlowMessage::Kind::NEW) {
+                orders.push_back(m.ToOrder(++ts));
+            }
+        }
+    }
+
+    const auto start = Clock::now();
+    int64_t ts = 0;
+    size_t next_order = 0;
+    for (size_t i = 0; i < timed.size(); ++i) {
+        const FlowMessage &m = timed[i];
+        const auto t0 = Clock::now();
+        if (batch > 0 && m.kind == FlowMessage::Kind::NEW) {
+            size_t n = 1;
+            while (n < batch && i + n < timed.size() &&
+                   timed[i + n].kind == FlowMessage::Kind::NEW) {
+                ++n;
+            }
+            book.ProcessBatch(std::span<const Order>(&orders[next_order], n),
+                              fill_counter);
+            const auto t1 = Clock::now();
+            const auto per_order = static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0)
+                    .count()) /
+                n;
+            for (size_t k = 0; k < n; ++k) {
+                r.process_order.Record(per_order);
+            }
+            next_order += n;
+            i += n - 1;
+        } else if (m.kind == FlowMessage::Kind::NEW) {
+            book.ProcessOrder(m.ToOrder(++ts), fill_counter);
+            const auto t1 = Clock::now();
+            r.process_order.Record(static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0)
+                    .count()));
+        } else if (m.kind == FlowMessage::Kind::MODIFY) {
+            book.ModifyOrder(m.order_id, m.price, m.qty, fill_counter);
+            const auto t1 = Clock::now();
+            r.modify_order.Record(static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0)
+                    .count()));
+        } else {
+            r.cancels_hit += book.CancelOrder(m.order_id) ? 1 : 0;
+            const auto t1 = Clock::now();
+            r.cancel_order.Record(static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0)
+                    .count()));
+        }
+    }
+    r.elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       Clock::now() - start)
+                       .count();
+    return r;
+}
+
+std::string HistogramJson(const LatencyHistogram &h) {
+    std::ostringstream os;
+    os << "{\"count\": " << h.Count() << ", \"mean_ns\": " << h.Mean()
+       << ", \"p50_ns\": " << h.Percentile(50.0)
+       << ", \"p99_ns\": " << h.Percentile(99.0)
+       << ", \"p999_ns\": " << h.Percentile(99.9)
+       << ", \"max_ns\": " << h.Max() << "}";
+    return os.str();
+}
+
+std::string ResultJson(const BenchOptions &opts, const BenchResult &r) {
+    const FlowConfig &f = opts.flow;
+    const double seconds = static_cast<double>(r.elapsed_ns) / 1e9;
+    std::ostringstream os;
+    os << "{\n"
+       << "  \"book\": \"" << opts.book << "\",\n"
+       << "  \"batch\": " << opts.batch << ",\n"
+       << "  \"cancel_mode\": \"" << opts.cancel_mode << "\",\n"
+       << "  \"stp\": \"" << opts.stp_name << "\",\n"
+       << "  \"config\": {\"seed\": " << f.seed
+       << ", \"messages\": " << f.messages
+       << ", \"warmup_orders\": " << f.warmup_orders
+       << ", \"cancel_ratio\": " << f.cancel_ratio
+       << ", \"amend_ratio\": " << f.amend_ratio
+       << ", \"marketable_fraction\": " << f.marketable_fraction
+       << ", \"ioc_fraction\": " << f.ioc_fraction
+       << ", \"depth_ticks\": " << f.depth_ticks
+       << ", \"traders\": " << f.num_traders << ", \"price_dist\": \""
+       << f.price_dist << "\"},\n"
+       << "  \"elapsed_ns\": " << r.elapsed_ns << ",\n"
+       << "  \"throughput_msgs_per_sec\": "
+       << (seconds > 0 ? static_cast<double>(f.messages) / seconds : 0.0)
+       << ",\n"
+       << "  \"fills\": " << r.fills << ",\n"
+       << "  \"cancels_hit\": " << r.cancels_hit << ",\n"
+       << "  \"ops\": {\n"
+       << "    \"process_order\": " << HistogramJson(r.process_order) << ",\n"
+       << "    \"cancel_order\": " << HistogramJson(r.cancel_order) << ",\n"
+       << "    \"modify_order\": " << HistogramJson(r.modify_order) << "\n"
+       << "  }\n"
+       << "}\n";
+    return os.str();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    try {
+        const BenchOptions opts = ParseArgs(argc, argv);
+
+        OrderFlowGenerator gen(opts.flow);
+        const auto warmup = gen.Warmup();
+        const auto timed = gen.Timed();
+
+        BenchResult result;
+        if (opts.book == "tick") {
+            // Size the pool so no flow can exhaust it.
+            const uint64_t max_orders =
+                std::min<uint64_t>(warmup.size() + timed.size() + 1,
+                                   TickOrderBook::kDefaultMaxOrders * 16ull);
+            TickOrderBook book(opts.flow.Spec(),
+                               static_cast<uint32_t>(max_orders));
+            book.SetSelfTradePrevention(opts.stp);
+            result = RunFlow(book, warmup, timed, opts.batch);
+        } else if (opts.book == "map") {
+            OrderBook book(opts.book_options);
+            book.SetSelfTradePrevention(opts.stp);
+            result = RunFlow(book, warmup, timed, opts.batch);
+        } else {
+            throw std::runtime_error("Unknown book: " + opts.book);
+        }
+
+        const std::string json = ResultJson(opts, result);
+        std::cout << json;
+        if (!opts.output.empty()) {
+            std::ofstream out(opts.output);
+            if (!out) {
+                throw std::runtime_error("Cannot write " + opts.output);
+            }
+            out << json;
+        }
+        return 0;
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+}
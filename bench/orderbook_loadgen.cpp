@@ -0,0 +1,267 @@
+#include "LatencyHistogram.h"
+#include "OrderFlowGenerator.h"
+#include "orderbook/Gateway.h"
+
+#include <algorithm>
+#include <barrier>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Drives a running orderbook_gateway with synthetic flow over one or more
+// connections and reports end-to-end throughput and round-trip latency,
+// measured from the write of a request to the read of the report that
+// completes it.
+struct LoadOptions {
+    std::string unix_path = "/tmp/orderbook_gateway.sock";
+    // Non-negative: connect over loopback TCP instead of the Unix socket.
+    int tcp_port = -1;
+    uint32_t connections = 1;
+    // Connection i sends to symbol i % symbols.
+    uint32_t symbols = 1;
+    // Requests each connection keeps in flight; 1 is strict ping-pong.
+    size_t window = 64;
+    std::string output;
+    FlowConfig flow;
+};
+
+LoadOptions ParseArgs(int argc, char **argv) {
+    LoadOptions opts;
+    opts.flow.messages = 200'000;
+    opts.flow.warmup_orders = 10'000;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::runtime_error("Missing value for " + arg);
+            }
+            return argv[++i];
+        };
+        if (arg == "--unix") {
+            opts.unix_path = value();
+        } else if (arg == "--tcp-port") {
+            opts.tcp_port = std::stoi(value());
+        } else if (arg == "--connections") {
+            opts.connections = static_cast<uint32_t>(std::stoul(value()));
+        } else if (arg == "--symbols") {
+            opts.symbols = static_cast<uint32_t>(std::stoul(value()));
+        } else if (arg == "--window") {
+            opts.window = std::stoull(value());
+        } else if (arg == "--output") {
+            opts.output = value();
+        } else if (arg == "--seed") {
+            opts.flow.seed = std::stoull(value());
+        } else if (arg == "--messages") {
+            opts.flow.messages = std::stoull(value());
+        } else if (arg == "--warmup") {
+            opts.flow.warmup_orders = std::stoull(value());
+        } else if (arg == "--cancel-ratio") {
+            opts.flow.cancel_ratio = std::stod(value());
+        } else if (arg == "--amend-ratio") {
+            opts.flow.amend_ratio = std::stod(value());
+        } else if (arg == "--marketable") {
+            opts.flow.marketable_fraction = std::stod(value());
+        } else if (arg == "--ioc") {
+            opts.flow.ioc_fraction = std::stod(value());
+        } else if (arg == "--depth") {
+            opts.flow.depth_ticks = static_cast<uint32_t>(std::stoul(value()));
+        } else {
+            throw std::runtime_error("Unknown argument: " + arg);
+        }
+    }
+    if (opts.connections == 0 || opts.symbols == 0 || opts.window == 0) {
+        throw std::runtime_error(
+            "--connections, --symbols and --window must be positive");
+    }
+    return opts;
+}
+
+struct ConnectionResult {
+    LatencyHistogram rtt;
+    uint64_t fills{0};
+    uint64_t rejects{0};
+    int64_t elapsed_ns{0};
+};
+
+WireRequest ToRequest(const FlowMessage &m, SymbolId symbol, uint64_t tag) {
+    WireRequest r{};
+    r.kind = m.kind == FlowMessage::Kind::NEW      ? RequestKind::NEW
+             : m.kind == FlowMessage::Kind::CANCEL ? RequestKind::CANCEL
+                                                   : RequestKind::MODIFY;
+    r.side = m.side;
+    r.type = m.type;
+    r.symbol = symbol;
+    r.client_order_id = m.order_id;
+    r.tag = tag;
+    r.price = m.price;
+    r.qty = m.qty;
+    r.trader = m.trader;
+    return r;
+}
+
+// Sends `msgs` keeping at most `window` of them unanswered, tagged by
+// index, and records each one's round trip in `r`.
+void Drive(GatewayClient &client, const std::vector<FlowMessage> &msgs,
+           SymbolId symbol, size_t window, ConnectionResult &r) {
+    std::vector<int64_t> sent_at(msgs.size());
+    std::vector<WireRequest> batch;
+    std::vector<WireReport> received;
+    size_t next = 0;
+    size_t done = 0;
+    while (done < msgs.size()) {
+        batch.clear();
+        const int64_t now = Clock::now().time_since_epoch().count();
+        while (next < msgs.size() && next - done < window) {
+            batch.push_back(ToRequest(msgs[next], symbol, next));
+            sent_at[next++] = now;
+        }
+        if (!batch.empty()) {
+            client.Send(batch);
+        }
+        received.clear();
+        if (!client.Receive(received)) {
+            throw std::runtime_error("Gateway closed the connection");
+        }
+        const int64_t at = Clock::now().time_since_epoch().count();
+        for (const WireReport &rep : received) {
+            if (rep.kind == ReportKind::FILL) {
+                ++r.fills;
+                continue;
+            }
+            r.rejects += rep.kind == ReportKind::REJECTED ? 1 : 0;
+            r.rtt.Record(static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    Clock::duration(at - sent_at[rep.tag]))
+                    .count()));
+            ++done;
+        }
+    }
+}
+
+std::string HistogramJson(const LatencyHistogram &h) {
+    std::ostringstream os;
+    os << "{\"count\": " << h.Count() << ", \"mean_ns\": " << h.Mean()
+       << ", \"p50_ns\": " << h.Percentile(50.0)
+       << ", \"p99_ns\": " << h.Percentile(99.0)
+       << ", \"p999_ns\": " << h.Percentile(99.9)
+       << ", \"max_ns\": " << h.Max() << "}";
+    return os.str();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    try {
+        const LoadOptions opts = ParseArgs(argc, argv);
+
+        // Each connection replays its own seeded flow with its own client
+        // order ids; together they send --messages timed requests.
+        std::vector<ConnectionResult> results(opts.connections);
+        std::vector<std::exception_ptr> errors(opts.connections);
+        std::barrier ready(opts.connections);
+        std::vector<std::thread> threads;
+        for (uint32_t c = 0; c < opts.connections; ++c) {
+            threads.emplace_back([&, c] {
+                bool arrived = false;
+                try {
+                    FlowConfig flow = opts.flow;
+                    flow.seed += c;
+                    flow.messages = opts.flow.messages / opts.connections;
+                    OrderFlowGenerator gen(flow);
+                    const auto warmup = gen.Warmup();
+                    const auto timed = gen.Timed();
+
+                    auto client = opts.tcp_port >= 0
+                                      ? std::make_unique<GatewayClient>(
+                                            opts.tcp_port)
+                                      : std::make_unique<GatewayClient>(
+                                            opts.unix_path);
+                    const SymbolId symbol = c % opts.symbols;
+                    ConnectionResult untimed;
+                    Drive(*client, warmup, symbol, opts.window, untimed);
+
+                    arrived = true;
+                    ready.arrive_and_wait();
+                    const auto start = Clock::now();
+                    Drive(*client, timed, symbol, opts.window, results[c]);
+                    results[c].elapsed_ns =
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            Clock::now() - start)
+                            .count();
+                } catch (...) {
+                    errors[c] = std::current_exception();
+                    if (!arrived) {
+                        ready.arrive_and_drop();
+                    }
+                }
+            });
+        }
+        for (auto &t : threads) {
+            t.join();
+        }
+        for (const auto &e : errors) {
+            if (e) {
+                std::rethrow_exception(e);
+            }
+        }
+
+        ConnectionResult total;
+        for (const auto &r : results) {
+            total.rtt.Merge(r.rtt);
+            total.fills += r.fills;
+            total.rejects += r.rejects;
+            total.elapsed_ns = std::max(total.elapsed_ns, r.elapsed_ns);
+        }
+        const double seconds = static_cast<double>(total.elapsed_ns) / 1e9;
+        const FlowConfig &f = opts.flow;
+        std::ostringstream os;
+        os << "{\n"
+           << "  \"transport\": \""
+           << (opts.tcp_port >= 0 ? "tcp" : "unix") << "\",\n"
+           << "  \"connections\": " << opts.connections << ",\n"
+           << "  \"symbols\": " << opts.symbols << ",\n"
+           << "  \"window\": " << opts.window << ",\n"
+           << "  \"config\": {\"seed\": " << f.seed
+           << ", \"messages\": " << f.messages
+           << ", \"warmup_orders\": " << f.warmup_orders
+           << ", \"cancel_ratio\": " << f.cancel_ratio
+           << ", \"amend_ratio\": " << f.amend_ratio
+           << ", \"marketable_fraction\": " << f.marketable_fraction
+           << ", \"ioc_fraction\": " << f.ioc_fraction
+           << ", \"depth_ticks\": " << f.depth_ticks << "},\n"
+           << "  \"elapsed_ns\": " << total.elapsed_ns << ",\n"
+           << "  \"throughput_msgs_per_sec\": "
+           << (seconds > 0
+                   ? static_cast<double>(total.rtt.Count()) / seconds
+                   : 0.0)
+           << ",\n"
+           << "  \"fills\": " << total.fills << ",\n"
+           << "  \"rejects\": " << total.rejects << ",\n"
+           << "  \"round_trip\": " << HistogramJson(total.rtt) << "\n"
+           << "}\n";
+        std::cout << os.str();
+        if (!opts.output.empty()) {
+            std::ofstream out(opts.output);
+            if (!out) {
+                throw std::runtime_error("Cannot write " + opts.output);
+            }
+            out << os.str();
+        }
+        return 0;
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+}
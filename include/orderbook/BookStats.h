@@ -0,0 +1,168 @@
+#pragma once
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Per-book counters and latency buckets, compiled in only when the build
+// defines ORDERBOOK_STATS=1 (CMake option ORDERBOOK_STATS). Otherwise every
+// recording call below is an empty inline function and the books' hot
+// paths are unchanged.
+#ifndef ORDERBOOK_STATS
+#define ORDERBOOK_STATS 0
+#endif
+
+inline constexpr bool kBookStatsEnabled = ORDERBOOK_STATS != 0;
+
+// Cheapest monotonic timestamp available: the TSC on x86 (reference
+// cycles, not serialising), steady_clock nanoseconds elsewhere.
+struct StatsClock {
+    static uint64_t Now() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return static_cast<uint64_t>(
+            std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+    }
+    static const char *Unit();
+};
+
+// Power-of-two latency histogram: bucket i counts samples below 2^i ticks
+// and at or above 2^(i-1).
+struct LatencyBuckets {
+    std::array<uint64_t, 65> counts{};
+    uint64_t samples{0};
+    uint64_t max{0};
+
+    void Record(uint64_t ticks) {
+        ++counts[std::bit_width(ticks)];
+        ++samples;
+        if (ticks > max) {
+            max = ticks;
+        }
+    }
+
+    // Upper bound (in ticks) of the bucket holding quantile `q` in [0, 1].
+    [[nodiscard]] uint64_t Quantile(double q) const;
+};
+
+struct BookStats {
+    bool enabled{kBookStatsEnabled};
+
+    // Counted on the hot path; zero unless enabled.
+    uint64_t orders{0};
+    uint64_t fills{0};
+    uint64_t cancels{0};
+    // Cancels (and zero-quantity amends) for ids that are not resting.
+    uint64_t cancel_misses{0};
+    // Cancels whose order was indexed but whose level was already gone.
+    uint64_t cancel_level_misses{0};
+    uint64_t modifies{0};
+    // Matches between orders of one trader stopped by self-trade
+    // prevention.
+    uint64_t self_trades_prevented{0};
+    // Price levels emptied by incoming orders, in total and by the worst
+    // single order.
+    uint64_t levels_swept{0};
+    uint64_t max_levels_swept{0};
+    // Longest queue an order has joined.
+    uint64_t max_queue_length{0};
+    LatencyBuckets process_latency;
+    LatencyBuckets cancel_latency;
+
+    // Sampled when Stats() is called, whether or not enabled.
+    uint64_t resting_orders{0};
+    uint64_t bid_levels{0};
+    uint64_t ask_levels{0};
+    // Orders cancelled under lazy cancel that are still linked into a
+    // level.
+    uint64_t dead_orders{0};
+};
+
+// Human-readable dump, as printed by orderbook_app at exit.
+void PrintBookStats(std::ostream &os, const BookStats &s);
+
+// What the books hold and call on their hot paths.
+class BookStatsRecorder {
+  public:
+    void CountOrder() {
+        if constexpr (kBookStatsEnabled) {
+            ++s.orders;
+        }
+    }
+    void CountFill() {
+        if constexpr (kBookStatsEnabled) {
+            ++s.fills;
+        }
+    }
+    void CountCancel(bool found) {
+        if constexpr (kBookStatsEnabled) {
+            ++(found ? s.cancels : s.cancel_misses);
+        }
+    }
+    void CountCancelLevelMiss() {
+        if constexpr (kBookStatsEnabled) {
+            ++s.cancel_level_misses;
+        }
+    }
+    void CountModify() {
+        if constexpr (kBookStatsEnabled) {
+            ++s.modifies;
+        }
+    }
+    void CountSelfTrade() {
+        if constexpr (kBookStatsEnabled) {
+            ++s.self_trades_prevented;
+        }
+    }
+    void CountSweep(uint64_t levels) {
+        if constexpr (kBookStatsEnabled) {
+            s.levels_swept += levels;
+            if (levels > s.max_levels_swept) {
+                s.max_levels_swept = levels;
+            }
+        }
+    }
+    void CountQueueLength(uint64_t length) {
+        if constexpr (kBookStatsEnabled) {
+            if (length > s.max_queue_length) {
+                s.max_queue_length = length;
+            }
+        }
+    }
+
+    // Records the lifetime of the scope into `buckets`.
+    class Timer {
+      public:
+        explicit Timer(LatencyBuckets &_buckets) : buckets{_buckets} {
+            if constexpr (kBookStatsEnabled) {
+                start = StatsClock::Now();
+            }
+        }
+        ~Timer() {
+            if constexpr (kBookStatsEnabled) {
+                buckets.Record(StatsClock::Now() - start);
+            }
+        }
+        Timer(const Timer &) = delete;
+        Timer &operator=(const Timer &) = delete;
+
+      private:
+        LatencyBuckets &buckets;
+        uint64_t start{0};
+    };
+
+    Timer TimeProcess() { return Timer(s.process_latency); }
+    Timer TimeCancel() { return Timer(s.cancel_latency); }
+
+    [[nodiscard]] const BookStats &Counters() const { return s; }
+
+  private:
+    BookStats s;
+};
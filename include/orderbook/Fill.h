@@ -0,0 +1,82 @@
+#pragma once
+#include "Order.h"
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Plain execution record written by the sink-based ProcessOrder overloads.
+// It is a flat value, so reporting a fill never allocates.
+struct Fill {
+    uint64_t buy_order_id;
+    uint64_t sell_order_id;
+    int64_t timestamp;
+    double price;
+    TraderId buyer;
+    TraderId seller;
+    uint32_t qty;
+};
+static_assert(std::is_trivially_copyable_v<Fill>);
+
+// Receives fills synchronously from inside the match loop.
+class FillSink {
+  public:
+    virtual ~FillSink() = default;
+    virtual void OnFill(const Fill &fill) = 0;
+};
+
+// Fixed-capacity ring of fills that the caller drains between calls. The
+// storage is allocated once; OnFill throws std::length_error when full.
+class FillRing : public FillSink {
+  public:
+    explicit FillRing(const size_t _capacity) : buffer(_capacity) {
+        if (buffer.empty()) {
+            throw std::invalid_argument("FillRing capacity must be positive");
+        }
+    }
+
+    void OnFill(const Fill &fill) override {
+        if (count == buffer.size()) {
+            throw std::length_error("FillRing overflow");
+        }
+        buffer[(head + count) % buffer.size()] = fill;
+        ++count;
+    }
+
+    [[nodiscard]] bool Empty() const { return count == 0; }
+    [[nodiscard]] size_t Size() const { return count; }
+    [[nodiscard]] size_t Capacity() const { return buffer.size(); }
+
+    // i-th oldest fill still in the ring.
+    [[nodiscard]] const Fill &operator[](size_t i) const {
+        return buffer[(head + i) % buffer.size()];
+    }
+
+    Fill Pop() {
+        const Fill f = buffer[head];
+        head = (head + 1) % buffer.size();
+        --count;
+        return f;
+    }
+
+    void Clear() {
+        head = 0;
+        count = 0;
+    }
+
+  private:
+    std::vector<Fill> buffer;
+    size_t head{0};
+    size_t count{0};
+};
+
+// Forwards each fill to a callable, e.g. a lambda capturing local state.
+template <typename F> class CallbackSink : public FillSink {
+  public:
+    explicit CallbackSink(F _f) : f{std::move(_f)} {}
+    void OnFill(const Fill &fill) override { f(fill); }
+
+  private:
+    F f;
+};
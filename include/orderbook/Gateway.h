@@ -0,0 +1,208 @@
+#pragma once
+#include "GatewayProtocol.h"
+#include "Instrument.h"
+#include "MatchingEngine.h"
+#include "OrderIdIndex.h"
+#include "SpscQueue.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <span>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct GatewayOptions {
+    // Unix domain socket to listen on; empty disables it. A file already
+    // at the path is replaced.
+    std::string unix_path;
+    // Loopback TCP port to listen on: 0 picks a free one (see TcpPort()),
+    // -1 disables TCP.
+    int tcp_port{-1};
+    uint32_t workers{1};
+    bool pin_threads{false};
+    // Poll epoll without sleeping: lower latency for one busy core.
+    bool busy_poll{false};
+    // Per-worker ring of engine output waiting for the network thread.
+    size_t report_queue_capacity{1u << 16};
+};
+
+// Order-entry front end for a MatchingEngine it owns. One network thread
+// runs an epoll loop over every session: per wakeup it reads each ready
+// socket until it is drained, feeds the decoded requests to the engine's
+// lock-free rings, collects the execution reports the workers pushed back
+// and then writes each session's reports with a single call. Client order
+// ids are mapped to engine-wide ids here, so sessions cannot collide.
+// Orders stay on the book when their session disconnects.
+class Gateway : private EngineListener {
+  public:
+    explicit Gateway(const GatewayOptions &_opts);
+    ~Gateway() override;
+
+    Gateway(const Gateway &) = delete;
+    Gateway &operator=(const Gateway &) = delete;
+
+    // Registers a symbol with the engine. Only allowed before Start().
+    void AddInstrument(SymbolId symbol, const InstrumentSpec &spec,
+                       uint32_t max_orders = MatchingEngine::kDefaultMaxOrders);
+
+    // Starts the engine workers and the network thread.
+    void Start();
+    // Stops accepting input, closes every session and stops the engine.
+    // Rethrows the error that stopped the network thread, if any.
+    void Stop();
+
+    // Whether the network thread has stopped on an error; Stop() reports
+    // it.
+    [[nodiscard]] bool Failed() const {
+        return failed.load(std::memory_order_acquire);
+    }
+
+    [[nodiscard]] int TcpPort() const { return tcp_port; }
+    // Totals published by the network thread once per wakeup.
+    [[nodiscard]] uint64_t SessionsAccepted() const {
+        return sessions_accepted.load(std::memory_order_relaxed);
+    }
+    [[nodiscard]] uint64_t RequestsHandled() const {
+        return requests_handled.load(std::memory_order_relaxed);
+    }
+    [[nodiscard]] uint64_t ReportsSent() const {
+        return reports_sent.load(std::memory_order_relaxed);
+    }
+
+  private:
+    // What a worker hands back to the network thread.
+    struct EngineReport {
+        enum class Kind : uint8_t { FILL, DONE };
+        Kind kind;
+        bool ok;
+        uint32_t qty;
+        // FILL: the buy and sell order ids.
+        uint64_t order_id;
+        uint64_t other_id;
+        double price;
+    };
+
+    // A request sent to a worker, answered by its next DONE report. The
+    // worker reports messages in order, so fills popped while an amend is
+    // at the front of its queue are the amend's own re-match.
+    struct Pending {
+        uint32_t session;
+        RequestKind kind;
+        // MODIFY: whether leaves were reset to `qty` by its first fill.
+        bool amended{false};
+        uint32_t qty;
+        uint64_t order_id;
+        uint64_t client_order_id;
+        uint64_t tag;
+    };
+
+    // Owner of an engine order id, until the order leaves the book. A stop
+    // that fires and leaves the book unfilled is only noticed, and its
+    // route dropped, when the client next cancels or amends it.
+    struct Route {
+        uint32_t session;
+        SymbolId symbol;
+        uint32_t leaves;
+        uint64_t client_order_id;
+    };
+
+    struct Session {
+        int fd;
+        uint32_t id;
+        std::vector<uint8_t> in;
+        size_t in_len{0};
+        std::vector<uint8_t> out;
+        size_t out_sent{0};
+        bool dirty{false};
+        bool want_write{false};
+        // Client order id -> engine order id of the session's open orders.
+        FlatIdMap<uint64_t> orders;
+    };
+
+    void OnFill(SymbolId symbol, const Fill &fill) override;
+    void OnProcessed(SymbolId symbol, uint64_t order_id, EngineOp op, bool ok,
+                     uint32_t open_qty) override;
+    void Push(SymbolId symbol, const EngineReport &r);
+
+    void Run();
+    void Loop();
+    void Accept(int listen_fd);
+    void ReadSession(Session &s);
+    void HandleRequest(Session &s, const WireRequest &req);
+    void DrainReports();
+    void ReportFill(uint64_t order_id, double price, uint32_t qty,
+                    Pending *current);
+    void Complete(const Pending &p, const EngineReport &r);
+    void Forget(uint64_t order_id, const Route &route);
+    void Send(uint32_t session, const WireReport &report);
+    void Flush();
+    void CloseSession(uint32_t session);
+
+    GatewayOptions opts;
+    MatchingEngine engine;
+    std::unordered_map<SymbolId, uint32_t> symbol_worker;
+
+    std::vector<std::unique_ptr<SpscQueue<EngineReport>>> reports;
+    // Requests in flight per worker, oldest first.
+    std::vector<std::deque<Pending>> pending;
+
+    int epoll_fd{-1};
+    int wake_fd{-1};
+    int unix_fd{-1};
+    int tcp_fd{-1};
+    int tcp_port{-1};
+    // Spare descriptor given up to accept and shed a client when the
+    // process is out of descriptors.
+    int reserve_fd{-1};
+    // Set by a worker that has written wake_fd and not yet been drained.
+    std::atomic<bool> wake_pending{false};
+    // Set on Stop(): workers drop output instead of waiting for room.
+    std::atomic<bool> closing{false};
+    std::atomic<bool> stopping{false};
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+    std::thread network;
+    bool running{false};
+
+    std::unordered_map<uint32_t, std::unique_ptr<Session>> sessions;
+    std::vector<uint32_t> dirty;
+    uint32_t next_session{0};
+    uint64_t next_order_id{1};
+    OrderIdIndex<Route> routes;
+
+    std::atomic<uint64_t> sessions_accepted{0};
+    std::atomic<uint64_t> requests_handled{0};
+    std::atomic<uint64_t> reports_sent{0};
+    uint64_t requests{0};
+    uint64_t sent{0};
+};
+
+// Blocking client end of the protocol, as used by tests and the load
+// generator.
+class GatewayClient {
+  public:
+    explicit GatewayClient(const std::string &unix_path);
+    // Connects to the gateway's loopback TCP port.
+    explicit GatewayClient(int tcp_port);
+    ~GatewayClient();
+
+    GatewayClient(const GatewayClient &) = delete;
+    GatewayClient &operator=(const GatewayClient &) = delete;
+
+    // Writes every request, in as few calls as the socket allows.
+    void Send(std::span<const WireRequest> requests);
+    // Blocks until at least one report has arrived and appends every
+    // complete report read so far. Returns false once the gateway has
+    // closed the connection.
+    bool Receive(std::vector<WireReport> &out);
+
+  private:
+    int fd{-1};
+    std::vector<uint8_t> in;
+    size_t in_len{0};
+};
@@ -0,0 +1,67 @@
+#pragma once
+#include "Order.h"
+#include <bit>
+#include <cstdint>
+#include <type_traits>
+
+// Binary order-entry protocol spoken by Gateway over a stream socket. Each
+// direction is a plain sequence of fixed-size records laid out as below, so
+// a whole read() buffer decodes in place and any number of records goes out
+// in one write(). Only little-endian hosts speak it.
+static_assert(std::endian::native == std::endian::little,
+              "Gateway records are sent as little-endian structs");
+
+enum class RequestKind : uint8_t { NEW, CANCEL, MODIFY };
+
+struct WireRequest {
+    RequestKind kind;
+    SIDE side;
+    // Limit, market, IOC or FOK. There are no stop price or display
+    // fields, so stop orders are rejected and icebergs cannot be sent.
+    TYPE type;
+    uint8_t reserved;
+    // NEW only; cancels and amends go to the order's own symbol.
+    uint32_t symbol;
+    // The client's id for the order, unique among its session's open
+    // orders. Cancels and amends name the order by it.
+    uint64_t client_order_id;
+    // Echoed in the report that completes this request.
+    uint64_t tag;
+    // NEW: limit price; MODIFY: new price.
+    double price;
+    // NEW: quantity; MODIFY: new open quantity.
+    uint32_t qty;
+    TraderId trader;
+};
+static_assert(sizeof(WireRequest) == 40);
+static_assert(std::is_trivially_copyable_v<WireRequest>);
+
+// Every request is completed by exactly one ACCEPTED, CANCELED, MODIFIED or
+// REJECTED report. The fills an order takes while it is being processed
+// come before that report; fills of a resting order come as they happen.
+enum class ReportKind : uint8_t {
+    ACCEPTED,
+    FILL,
+    CANCELED,
+    MODIFIED,
+    REJECTED
+};
+
+struct WireReport {
+    ReportKind kind;
+    // The kind of request this report completes; NEW for fills.
+    RequestKind request;
+    uint8_t reserved[2];
+    // FILL: traded quantity.
+    uint32_t qty;
+    uint64_t client_order_id;
+    // Tag of the completed request; 0 for fills.
+    uint64_t tag;
+    // FILL: trade price.
+    double price;
+    // Open quantity the order has left after this report.
+    uint32_t leaves_qty;
+    uint32_t reserved2;
+};
+static_assert(sizeof(WireReport) == 40);
+static_assert(std::is_trivially_copyable_v<WireReport>);
@@ -0,0 +1,55 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+
+// Tick grid and admissible price band of one instrument. Every price in
+// [min_price, max_price] that lies on the grid maps to a dense integer tick
+// offset, which is what the array-based book indexes its levels with.
+class InstrumentSpec {
+  public:
+    InstrumentSpec(const double _tick_size, const double _min_price,
+                   const double _max_price)
+        : tick_size{_tick_size}, min_price{_min_price}, max_price{_max_price} {
+        if (!(tick_size > 0.0) || !(max_price >= min_price)) {
+            throw std::invalid_argument("Invalid instrument tick/price band");
+        }
+        const double span = std::round((max_price - min_price) / tick_size);
+        if (span >= static_cast<double>(UINT32_MAX)) {
+            throw std::invalid_argument("Instrument price band too wide");
+        }
+        num_ticks = static_cast<uint32_t>(span) + 1;
+    }
+
+    [[nodiscard]] double TickSize() const { return tick_size; }
+    [[nodiscard]] double MinPrice() const { return min_price; }
+    [[nodiscard]] double MaxPrice() const { return max_price; }
+    [[nodiscard]] uint32_t NumTicks() const { return num_ticks; }
+
+    // Returns the tick offset of `price`, or nothing when the price is outside
+    // the band or not on the tick grid.
+    [[nodiscard]] std::optional<uint32_t> ToTick(const double price) const {
+        const double offset = (price - min_price) / tick_size;
+        const double rounded = std::round(offset);
+        if (rounded < 0.0 || rounded >= static_cast<double>(num_ticks) ||
+            std::abs(offset - rounded) > kGridTolerance) {
+            return std::nullopt;
+        }
+        return static_cast<uint32_t>(rounded);
+    }
+
+    [[nodiscard]] double ToPrice(const uint32_t tick) const {
+        return min_price + static_cast<double>(tick) * tick_size;
+    }
+
+  private:
+    // Fraction of a tick a price may be off the grid and still be accepted,
+    // so that e.g. 100.07 with a 0.01 tick survives binary rounding.
+    static constexpr double kGridTolerance = 1e-6;
+
+    double tick_size;
+    double min_price;
+    double max_price;
+    uint32_t num_ticks;
+};
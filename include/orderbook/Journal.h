@@ -0,0 +1,241 @@
+#pragma once
+#include "Fill.h"
+#include "Order.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// One journaled book operation. On disk every record is a fixed 64-byte
+// little-endian block ending in a checksum, so a write torn by a crash is
+// detected and dropped on recovery.
+struct JournalRecord {
+    enum class Kind : uint8_t { NEW = 1, CANCEL = 2, MODIFY = 3 };
+
+    Kind kind;
+    SIDE side;
+    TYPE type;
+    TraderId trader;
+    uint64_t seq;
+    uint64_t order_id;
+    int64_t timestamp;
+    double price;
+    uint32_t qty;
+    // Stop and iceberg fields of a NEW order (see Order).
+    double stop_price{0.0};
+    uint32_t display_qty{0};
+    uint32_t shown_qty{0};
+
+    static JournalRecord New(uint64_t seq, const Order &o);
+    static JournalRecord Cancel(uint64_t seq, uint64_t order_id);
+    static JournalRecord Modify(uint64_t seq, uint64_t order_id,
+                                double new_price, uint32_t new_qty);
+    [[nodiscard]] Order ToOrder() const;
+};
+
+inline constexpr size_t kJournalRecordSize = 64;
+
+void EncodeJournalRecord(const JournalRecord &r, uint8_t *out);
+// Returns false if the block is not a valid record (bad checksum or kind).
+bool DecodeJournalRecord(const uint8_t *in, JournalRecord &r);
+
+struct JournalOptions {
+    // Directory holding snapshot.bin and journal-<first seq>.log segments.
+    std::string dir;
+    // Records buffered per write() + fdatasync(); 1 makes every op durable
+    // before it is applied.
+    uint32_t group_commit = 256;
+    // Without fdatasync the journal survives process crashes but not power
+    // loss.
+    bool sync = true;
+    // Journal records between automatic snapshots; 0 disables them.
+    uint64_t snapshot_every = 1'000'000;
+};
+
+// Append-only journal segment with group commit: records are encoded into
+// a buffer and written with one write() (and fdatasync()) per
+// `group_commit` records or explicit Flush().
+class JournalWriter {
+  public:
+    JournalWriter(const std::string &path, uint32_t _group_commit,
+                  bool _sync);
+    ~JournalWriter();
+
+    JournalWriter(const JournalWriter &) = delete;
+    JournalWriter &operator=(const JournalWriter &) = delete;
+
+    void Append(const JournalRecord &r);
+    void Flush();
+
+  private:
+    int fd;
+    std::vector<uint8_t> buffer;
+    uint32_t group_commit;
+    uint32_t pending{0};
+    bool sync;
+};
+
+// Streams the resting book into <dir>/snapshot.bin. The file is built under
+// a temporary name and renamed into place by Commit(), so a crash leaves
+// the previous snapshot intact. `_max_order_id` is the largest order id
+// journaled up to `_seq`, kept even once that order has left the book.
+class SnapshotWriter {
+  public:
+    SnapshotWriter(const std::string &_dir, uint64_t _seq,
+                   uint64_t _max_order_id);
+    ~SnapshotWriter();
+
+    SnapshotWriter(const SnapshotWriter &) = delete;
+    SnapshotWriter &operator=(const SnapshotWriter &) = delete;
+
+    void Add(const Order &o);
+    void Commit();
+
+  private:
+    void WriteBuffer();
+
+    std::string dir;
+    std::string tmp_path;
+    int fd;
+    uint64_t seq;
+    uint64_t max_order_id;
+    uint64_t count{0};
+    std::vector<uint8_t> buffer;
+};
+
+struct RecoveryStats {
+    // Journal sequence number covered by the loaded snapshot (0 if none).
+    uint64_t snapshot_seq{0};
+    uint64_t snapshot_orders{0};
+    // Journal records replayed after the snapshot.
+    uint64_t replayed{0};
+    // Last sequence number recovered; new records continue after it.
+    uint64_t last_seq{0};
+    // Largest order id in the snapshot header or a recovered NEW record;
+    // new order ids continue after it.
+    uint64_t max_order_id{0};
+    // Bytes of torn journal tail that were discarded.
+    uint64_t truncated_bytes{0};
+};
+
+// Rebuilds state from `dir`: every order of the latest snapshot (mapped
+// read-only) is passed to `apply` as a NEW record, then every journal
+// record after the snapshot's sequence number. A torn final record is cut
+// off; corruption anywhere else throws std::runtime_error.
+RecoveryStats RecoverJournal(
+    const std::string &dir,
+    const std::function<void(const JournalRecord &)> &apply);
+
+std::string JournalSegmentPath(const std::string &dir, uint64_t first_seq);
+// Deletes segments that only hold records up to `seq`.
+void RemoveJournalSegmentsThrough(const std::string &dir, uint64_t seq);
+
+// Write-ahead journaling wrapper with the book's own interface. Each
+// operation is appended to the journal before it is applied, so replay
+// reproduces it exactly, including orders the book rejects. Construction
+// recovers `book` (which must be empty) from `opts.dir`.
+template <typename Book> class JournaledBook {
+  public:
+    JournaledBook(Book &_book, const JournalOptions &_opts)
+        : book{_book}, opts{_opts} {
+        CallbackSink discard([](const Fill &) {});
+        recovery = RecoverJournal(opts.dir, [&](const JournalRecord &r) {
+            try {
+                Apply(r, discard);
+            } catch (const std::exception &) {
+                // Rejected the first time round as well.
+            }
+        });
+        seq = recovery.last_seq;
+        max_order_id = recovery.max_order_id;
+        writer = std::make_unique<JournalWriter>(
+            JournalSegmentPath(opts.dir, seq + 1), opts.group_commit,
+            opts.sync);
+    }
+
+    void ProcessOrder(const Order &o, FillSink &sink) {
+        max_order_id = std::max(max_order_id, o.OrderId());
+        Log(JournalRecord::New(++seq, o), sink);
+    }
+    void ProcessBatch(std::span<const Order> orders, FillSink &sink) {
+        for (const Order &o : orders) {
+            ProcessOrder(o, sink);
+        }
+    }
+    bool CancelOrder(uint64_t order_id) {
+        CallbackSink discard([](const Fill &) {});
+        return Log(JournalRecord::Cancel(++seq, order_id), discard);
+    }
+    bool ModifyOrder(uint64_t order_id, double new_price, uint32_t new_qty,
+                     FillSink &sink) {
+        return Log(JournalRecord::Modify(++seq, order_id, new_price, new_qty),
+                   sink);
+    }
+
+    // Makes everything journaled so far durable.
+    void Flush() { writer->Flush(); }
+
+    // Writes a snapshot covering every record so far, starts a new journal
+    // segment and drops the segments the snapshot replaces.
+    void Snapshot() {
+        writer->Flush();
+        SnapshotWriter snapshot(opts.dir, seq, max_order_id);
+        book.ForEachResting([&](const Order &o) { snapshot.Add(o); });
+        snapshot.Commit();
+        writer = std::make_unique<JournalWriter>(
+            JournalSegmentPath(opts.dir, seq + 1), opts.group_commit,
+            opts.sync);
+        RemoveJournalSegmentsThrough(opts.dir, seq);
+        since_snapshot = 0;
+    }
+
+    [[nodiscard]] const RecoveryStats &Recovery() const { return recovery; }
+    [[nodiscard]] uint64_t LastSeq() const { return seq; }
+
+  private:
+    bool Log(const JournalRecord &r, FillSink &sink) {
+        writer->Append(r);
+        bool result;
+        try {
+            result = Apply(r, sink);
+        } catch (...) {
+            MaybeSnapshot();
+            throw;
+        }
+        MaybeSnapshot();
+        return result;
+    }
+
+    void MaybeSnapshot() {
+        if (opts.snapshot_every != 0 &&
+            ++since_snapshot >= opts.snapshot_every) {
+            Snapshot();
+        }
+    }
+
+    bool Apply(const JournalRecord &r, FillSink &sink) {
+        switch (r.kind) {
+        case JournalRecord::Kind::NEW:
+            book.ProcessOrder(r.ToOrder(), sink);
+            return true;
+        case JournalRecord::Kind::CANCEL:
+            return book.CancelOrder(r.order_id);
+        case JournalRecord::Kind::MODIFY:
+            return book.ModifyOrder(r.order_id, r.price, r.qty, sink);
+        }
+        return false;
+    }
+
+    Book &book;
+    JournalOptions opts;
+    RecoveryStats recovery;
+    std::unique_ptr<JournalWriter> writer;
+    uint64_t seq{0};
+    uint64_t max_order_id{0};
+    uint64_t since_snapshot{0};
+};
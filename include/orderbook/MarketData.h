@@ -0,0 +1,31 @@
+#pragma once
+#include "Order.h"
+#include <cstdint>
+#include <type_traits>
+
+// Aggregated view of one price level: total open quantity and number of
+// resting orders.
+struct DepthLevel {
+    double price;
+    uint64_t qty;
+    uint32_t orders;
+};
+static_assert(std::is_trivially_copyable_v<DepthLevel>);
+
+// New state of one level after a book change. `qty == 0` (and
+// `orders == 0`) means the level was removed.
+struct LevelUpdate {
+    SIDE side;
+    double price;
+    uint64_t qty;
+    uint32_t orders;
+};
+static_assert(std::is_trivially_copyable_v<LevelUpdate>);
+
+// Receives level updates synchronously, in the order the book applies them,
+// interleaved with the fills that caused them.
+class DepthSink {
+  public:
+    virtual ~DepthSink() = default;
+    virtual void OnLevelUpdate(const LevelUpdate &update) = 0;
+};
@@ -0,0 +1,123 @@
+#pragma once
+#include "Fill.h"
+#include "Instrument.h"
+#include "Order.h"
+#include "SpscQueue.h"
+#include "TickOrderBook.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using SymbolId = uint32_t;
+
+enum class EngineOp : uint8_t { NEW, CANCEL, MODIFY };
+
+// Receives engine output on the worker thread that owns the symbol. All
+// callbacks for one symbol come from the same thread, in message order;
+// callbacks for different symbols may run concurrently.
+class EngineListener {
+  public:
+    virtual ~EngineListener() = default;
+    virtual void OnFill(SymbolId symbol, const Fill &fill) = 0;
+    virtual void OnReject(SymbolId /*symbol*/, uint64_t /*order_id*/) {}
+    // Called for every message once it has been applied and its fills
+    // reported. `ok` is false for rejected orders and for cancels and
+    // amends the book refused; `open_qty` is what the order has left
+    // resting or pending as a stop afterwards.
+    virtual void OnProcessed(SymbolId /*symbol*/, uint64_t /*order_id*/,
+                             EngineOp /*op*/, bool /*ok*/,
+                             uint32_t /*open_qty*/) {}
+};
+
+// Owns one TickOrderBook per symbol and shards symbols over worker threads.
+// Each worker drains its own SPSC ring, so a symbol's book is only ever
+// touched by one thread and the hot path takes no locks. Submit, Cancel and
+// Modify must all be called from a single producer thread; that keeps
+// per-symbol price-time order identical to the submission order.
+class MatchingEngine {
+  public:
+    static constexpr size_t kDefaultQueueCapacity = 1u << 16;
+    // Resting orders per symbol. Books are created up front for every
+    // symbol, so the default stays well below a lone book's.
+    static constexpr uint32_t kDefaultMaxOrders = 1u << 16;
+
+    explicit MatchingEngine(uint32_t _num_workers,
+                            EngineListener *_listener = nullptr,
+                            size_t queue_capacity = kDefaultQueueCapacity,
+                            bool _pin_threads = true);
+    ~MatchingEngine();
+
+    MatchingEngine(const MatchingEngine &) = delete;
+    MatchingEngine &operator=(const MatchingEngine &) = delete;
+
+    // Registers a symbol. Only allowed before Start().
+    void AddInstrument(SymbolId symbol, const InstrumentSpec &spec,
+                       uint32_t max_orders = kDefaultMaxOrders);
+
+    void Start();
+    // Lets the workers drain everything already submitted, then joins them.
+    void Stop();
+
+    // Runs on the producer thread in place of a pause while Submit, Cancel
+    // or Modify wait for room in a full ring, e.g. to drain listener output
+    // the workers are waiting on.
+    void SetBackoff(std::function<void()> _backoff) {
+        backoff = std::move(_backoff);
+    }
+
+    // Enqueue to the owning worker, spinning while its ring is full. Return
+    // false for symbols that were never registered.
+    bool Submit(SymbolId symbol, const Order &o);
+    bool Cancel(SymbolId symbol, uint64_t order_id);
+    // See TickOrderBook::ModifyOrder. An off-grid price is reported through
+    // EngineListener::OnReject.
+    bool Modify(SymbolId symbol, uint64_t order_id, double new_price,
+                uint32_t new_qty);
+
+    [[nodiscard]] uint32_t NumWorkers() const {
+        return static_cast<uint32_t>(workers.size());
+    }
+    [[nodiscard]] uint32_t WorkerOf(SymbolId symbol) const;
+
+    // Totals across workers; exact once Stop() has returned.
+    [[nodiscard]] uint64_t MessagesProcessed() const;
+    [[nodiscard]] uint64_t FillsEmitted() const;
+
+  private:
+    // Flat message carried through the rings; Order is rebuilt on the worker.
+    struct Command {
+        EngineOp kind;
+        SIDE side;
+        TYPE type;
+        SymbolId symbol;
+        TraderId trader;
+        uint32_t qty;
+        uint64_t order_id;
+        int64_t timestamp;
+        double price;
+    };
+
+    struct Worker {
+        explicit Worker(size_t queue_capacity) : queue{queue_capacity} {}
+        SpscQueue<Command> queue;
+        std::unordered_map<SymbolId, std::unique_ptr<TickOrderBook>> books;
+        std::thread thread;
+        alignas(64) std::atomic<uint64_t> messages{0};
+        std::atomic<uint64_t> fills{0};
+    };
+
+    void Enqueue(uint32_t worker, const Command &cmd);
+    void RunWorker(uint32_t index);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::unordered_map<SymbolId, uint32_t> symbol_worker;
+    EngineListener *listener;
+    std::function<void()> backoff;
+    bool pin_threads;
+    bool running{false};
+    std::atomic<bool> stopping{false};
+};
@@ -1,39 +1,89 @@
 #pragma once
 #include <cstdint>
 #include <memory>
-#include <string>
-#include <utility>
 
-enum class SIDE { BUY, SELL };
-enum class TYPE { LIMIT_ORDER };
+enum class SIDE : uint8_t { BUY, SELL };
+// LIMIT_ORDER rests any remainder. MARKET_ORDER takes liquidity at any
+// price, IOC_ORDER up to its limit, and FOK_ORDER trades its full quantity
+// up to its limit or not at all; none of them rest. STOP_ORDER and
+// STOP_LIMIT_ORDER wait off the book until a trade reaches their stop
+// price, then enter as a MARKET_ORDER or LIMIT_ORDER respectively.
+enum class TYPE : uint8_t {
+    LIMIT_ORDER,
+    MARKET_ORDER,
+    IOC_ORDER,
+    FOK_ORDER,
+    STOP_ORDER,
+    STOP_LIMIT_ORDER
+};
+
+// Self-trade prevention: what a book does when an order would trade with
+// a resting order of the same trader. CANCEL_NEWEST drops what is left of
+// the incoming order, CANCEL_OLDEST cancels the resting order and keeps
+// matching, DECREMENT_BOTH takes the would-be fill off both without a
+// trade.
+enum class STP : uint8_t { NONE, CANCEL_NEWEST, CANCEL_OLDEST, DECREMENT_BOTH };
+
+// Compact trader identifier handed out by TraderTable.
+using TraderId = uint32_t;
 
 class Order {
   public:
     Order(const uint64_t _order_id, const int64_t _timestamp,
-          std::string _trader, const SIDE _side, const double _price,
-          const uint32_t _qty)
-        : order_id{_order_id}, timestamp{_timestamp},
-          trader{std::move(_trader)}, side{_side}, price{_price}, qty{_qty},
-          qty_remaining{_qty} {}
+          const TraderId _trader, const SIDE _side, const double _price,
+          const uint32_t _qty, const TYPE _type = TYPE::LIMIT_ORDER)
+        : order_id{_order_id}, timestamp{_timestamp}, price{_price},
+          trader{_trader}, qty{_qty}, qty_remaining{_qty}, side{_side},
+          type{_type} {}
 
     [[nodiscard]] uint64_t OrderId() const { return order_id; }
     [[nodiscard]] int64_t Timestamp() const { return timestamp; }
-    [[nodiscard]] const std::string &Trader() const { return trader; }
+    [[nodiscard]] TraderId Trader() const { return trader; }
     [[nodiscard]] SIDE Side() const { return side; }
+    [[nodiscard]] TYPE Type() const { return type; }
+    void Type(TYPE _type) { type = _type; }
     [[nodiscard]] double Price() const { return price; }
+    void Price(double _price) { price = _price; }
     [[nodiscard]] uint32_t Qty() const { return qty; }
     [[nodiscard]] uint32_t QtyRemaining() const { return qty_remaining; }
     void QtyRemaining(uint32_t _qty_remaining) {
         qty_remaining = _qty_remaining;
     }
+    // Trade price that activates a stop order: at or above it for a buy,
+    // at or below it for a sell.
+    [[nodiscard]] double StopPrice() const { return stop_price; }
+    void StopPrice(double _stop_price) { stop_price = _stop_price; }
+    // An iceberg shows at most this much of its open quantity at a time and
+    // refills from the hidden rest at the back of its level; 0 shows all.
+    [[nodiscard]] uint32_t DisplayQty() const { return display_qty; }
+    void DisplayQty(uint32_t _display_qty) { display_qty = _display_qty; }
+    // Open quantity left in a resting iceberg's current slice, as reported
+    // by ForEachResting so a rebuilt book resumes the same slice. 0 (as on
+    // new orders) starts a full one.
+    [[nodiscard]] uint32_t ShownQty() const { return shown_qty; }
+    void ShownQty(uint32_t _shown_qty) { shown_qty = _shown_qty; }
+    // How much of the open quantity shows once the order rests.
+    [[nodiscard]] uint32_t RestingShownQty() const {
+        if (display_qty == 0) {
+            return qty_remaining;
+        }
+        if (shown_qty != 0 && shown_qty <= qty_remaining) {
+            return shown_qty;
+        }
+        return display_qty < qty_remaining ? display_qty : qty_remaining;
+    }
 
   private:
     uint64_t order_id;
     int64_t timestamp;
-    std::string trader;
-    SIDE side;
     double price;
+    double stop_price{0.0};
+    TraderId trader;
     uint32_t qty;
     uint32_t qty_remaining;
+    uint32_t display_qty{0};
+    uint32_t shown_qty{0};
+    SIDE side;
+    TYPE type;
 };
 using OrderPtr = std::shared_ptr<Order>;
@@ -1,15 +1,93 @@
 #pragma once
+#include "BookStats.h"
+#include "Fill.h"
+#include "MarketData.h"
 #include "Order.h"
+#include "OrderIdIndex.h"
+#include "StopBook.h"
 #include "Trade.h"
 #include <functional>
+#include <limits>
 #include <list>
 #include <map>
-#include <unordered_map>
+#include <optional>
+#include <span>
+#include <vector>
+
+struct OrderBookOptions {
+    // Cancels only mark the order dead and update the level aggregates;
+    // the queue entry (and a level left with no live orders) stays until
+    // matching reaches it or a compaction pass sweeps it out. A level left
+    // with no live orders on top of its side is erased at once, so the
+    // best bid and ask stay O(1).
+    bool lazy_cancel = false;
+    // Dead orders are otherwise reclaimed when matching reaches them or by
+    // Compact(). As a bound on memory, a cancel compacts the whole book
+    // once this many have piled up and they outnumber the live orders.
+    size_t compact_threshold = 1 << 20;
+};
 
 class OrderBook {
   public:
+    OrderBook() = default;
+    explicit OrderBook(const OrderBookOptions &_options) : options{_options} {}
+    // A copy is an independent book in the same state, down to queue
+    // positions, iceberg slices, pending stops and lazily cancelled orders;
+    // it costs one allocation per resting order. It keeps the depth sink.
+    OrderBook(const OrderBook &other);
+    OrderBook(OrderBook &&) noexcept = default;
+    OrderBook &operator=(const OrderBook &other);
+    OrderBook &operator=(OrderBook &&) noexcept = default;
+
     TradeVector ProcessOrder(const Order &_incoming);
+    // Same matching, but fills are written to `sink` as they happen and no
+    // Trade objects are built. The TradeVector overload wraps this one.
+    void ProcessOrder(const Order &_incoming, FillSink &sink);
+    // Runs `orders` in sequence with exactly the per-order semantics of
+    // ProcessOrder, writing every fill to `sink` (a FillRing or one
+    // CallbackSink gives a single output buffer). If an order throws, the
+    // ones before it stay applied.
+    void ProcessBatch(std::span<const Order> orders, FillSink &sink);
+    // Cancels a resting or pending stop order.
     bool CancelOrder(uint64_t order_id);
+    // Drops every dead order and empty level left by lazy cancels. Cheap to
+    // call when idle; a no-op in eager mode.
+    void Compact();
+    // Amends a resting order to `new_price` with `new_qty` left open. A
+    // decrease at the same price keeps queue priority; anything else
+    // re-matches the order and queues it behind its new level. A zero
+    // quantity cancels. Returns false for unknown ids and pending stops.
+    // For an iceberg `new_qty` is its whole open quantity; a decrease comes
+    // out of the hidden part first.
+    bool ModifyOrder(uint64_t order_id, double new_price, uint32_t new_qty,
+                     FillSink &sink);
+
+    // Aggregated L2 view, maintained incrementally as orders rest, fill and
+    // leave. Top of book is O(1); Depth writes the best `levels` levels of
+    // `side` (best first) into `out`, replacing its contents.
+    [[nodiscard]] std::optional<DepthLevel> BestBid() const;
+    [[nodiscard]] std::optional<DepthLevel> BestAsk() const;
+    void Depth(SIDE side, size_t levels, std::vector<DepthLevel> &out) const;
+    // Every level change is reported to `sink` (nullptr turns it off).
+    void SetDepthSink(DepthSink *_depth_sink) { depth_sink = _depth_sink; }
+    // Self-trade prevention policy, off (STP::NONE) by default. With it on,
+    // a fill-or-kill order is killed if the levels it needs hold an order
+    // of its own trader.
+    void SetSelfTradePrevention(STP _stp) { stp = _stp; }
+
+    // Visits every resting order: bids then asks, each from the best level
+    // outwards and in queue order within a level, then the pending stops.
+    // Re-submitting them in this order to an empty book rebuilds the same
+    // book. Icebergs are reported with their whole open quantity.
+    void ForEachResting(const std::function<void(const Order &)> &visit) const;
+
+    // Whole open quantity of a resting or pending stop order, 0 if there
+    // is none.
+    [[nodiscard]] uint32_t OpenQty(uint64_t order_id) const;
+
+    // Snapshot of the hot-path counters (see BookStats.h) plus current
+    // order and level counts.
+    [[nodiscard]] BookStats Stats() const;
 
   private:
     // This is a good place to define your order book data structures.
@@ -20,21 +98,93 @@ class OrderBook {
     // efficient."
     using OrderQueue = std::list<OrderPtr>;
 
-    std::map<double, OrderQueue> sell_book;
-    std::map<double, OrderQueue, std::greater<double>> buy_book;
+    // `live` counts the orders in `orders` that are not dead; it differs
+    // from orders.size() only under lazy cancel. A dead order has zero
+    // quantity remaining, which no resting order otherwise has. `qty` is
+    // the displayed quantity; `hidden` sums the icebergs' reserves.
+    // `traders` has bit TraderBit(t) set once trader t rests here, so a
+    // clear bit rules out a self-trade without reading the orders.
+    struct PriceLevel {
+        OrderQueue orders;
+        uint64_t qty{0};
+        uint64_t hidden{0};
+        uint32_t live{0};
+        uint32_t traders{0};
+
+        static uint32_t TraderBit(TraderId t) { return 1u << (t & 31); }
+    };
+
+    std::map<double, PriceLevel> sell_book;
+    std::map<double, PriceLevel, std::greater<double>> buy_book;
 
-    TradeVector MatchBuy(OrderPtr incoming);
-    TradeVector MatchSell(OrderPtr incoming);
-    void AddToBuyBook(OrderPtr o);
-    void AddToSellBook(OrderPtr o);
+    DepthSink *depth_sink{nullptr};
+    STP stp{STP::NONE};
 
+    // Map nodes are stable and a level is only erased once it has no live
+    // orders, so `level` stays valid for as long as the locator exists.
+    // A resting order's QtyRemaining() is what it shows; `hidden` is the
+    // reserve an iceberg refills from.
     struct OrderLocator {
         SIDE side;
         double price;
         OrderQueue::iterator it;
+        PriceLevel *level;
+        uint32_t hidden;
     };
 
-    std::unordered_map<uint64_t, OrderLocator> locators;
+    template <SIDE S> auto &Book() {
+        if constexpr (S == SIDE::BUY) {
+            return buy_book;
+        } else {
+            return sell_book;
+        }
+    }
+    template <SIDE S> const auto &Book() const {
+        if constexpr (S == SIDE::BUY) {
+            return buy_book;
+        } else {
+            return sell_book;
+        }
+    }
+
+    // Matching, resting and cancel paths, written once and instantiated per
+    // side through SideTraits; S is the side of the order being handled.
+    // Runs a non-stop order against the book; the public entry points then
+    // call FireStops.
+    void Execute(Order incoming, FillSink &sink);
+    // Runs the stops set off by the range traded since the last call,
+    // including any that those trades set off in turn.
+    void FireStops(FillSink &sink);
+    template <SIDE S> void Match(Order &incoming, FillSink &sink);
+    // Refills the iceberg at the front of `level` whose shown slice just
+    // traded out, moving it to the back; false if it has no reserve left.
+    bool Replenish(PriceLevel &level);
+    template <SIDE S> void AddToBook(const Order &_o);
+    template <SIDE S> bool RemoveFromBook(const OrderLocator &loc);
+    // Whether matching would take the whole quantity of `o` within its
+    // limit, from the level aggregates; orders are only read in levels
+    // where `o`'s trader may rest under CANCEL_NEWEST or CANCEL_OLDEST.
+    template <SIDE S> [[nodiscard]] bool CanFill(const Order &o) const;
+    void PublishLevel(SIDE side, double price, const PriceLevel *level);
+    // Lazy-cancel helpers: pop dead orders off the front of `level`, drop
+    // every dead order in it, sweep a whole side, and erase the dead levels
+    // on top of a side so its best level is live.
+    void DropDeadFront(PriceLevel &level);
+    void CompactLevel(PriceLevel &level);
+    template <SIDE S> void CompactSide();
+    template <SIDE S> void DropDeadLevels();
+
+    OrderBookOptions options;
+    OrderIdIndex<OrderLocator> locators;
+    StopBook stops;
+    std::vector<Order> triggered;
+    // Price range traded since stops were last checked; empty when low >
+    // high.
+    double traded_low{std::numeric_limits<double>::infinity()};
+    double traded_high{-std::numeric_limits<double>::infinity()};
+    BookStatsRecorder stats;
+    // Dead orders still linked into some level.
+    size_t dead_orders{0};
 
   private:
     // Feel free to add helper methods here as needed
@@ -0,0 +1,105 @@
+#pragma once
+#include "Order.h"
+#include "TraderTable.h"
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+// Native binary order file: a 64-byte header, then one fixed-width record
+// per order, then the trader name table. Records are read in place from a
+// read-only mapping, so replaying a converted dataset costs no decoding.
+// The layout is little-endian and only little-endian hosts read it.
+static_assert(std::endian::native == std::endian::little,
+              "Order files are read in place as little-endian records");
+
+struct OrderFileRecord {
+    // Event time in nanoseconds; 0 unless the file HasTimestamps().
+    int64_t timestamp;
+    // Price in units of 1 / price_scale.
+    int64_t price;
+    uint32_t qty;
+    // Index into the file's trader table.
+    uint32_t trader;
+    SIDE side;
+    TYPE type;
+    uint8_t reserved[6];
+};
+static_assert(sizeof(OrderFileRecord) == 32);
+
+// Writes an order file under a temporary name; Commit() appends the trader
+// table, fills in the header and renames the file into place, so a failed
+// conversion never leaves a file that looks complete.
+class OrderFileWriter {
+  public:
+    // `_price_scale` is the number of integer price units per 1.0 (100 for
+    // cents). Add() rejects prices that do not survive the round trip.
+    OrderFileWriter(const std::string &_path, int64_t _price_scale,
+                    bool _has_timestamps);
+    ~OrderFileWriter();
+
+    OrderFileWriter(const OrderFileWriter &) = delete;
+    OrderFileWriter &operator=(const OrderFileWriter &) = delete;
+
+    // `trader` is an id from the table later passed to Commit().
+    void Add(int64_t timestamp, TraderId trader, SIDE side, TYPE type,
+             double price, uint32_t qty);
+    void Commit(const TraderTable &traders);
+
+    [[nodiscard]] uint64_t Count() const { return count; }
+
+  private:
+    void WriteBuffer();
+
+    std::string path;
+    std::string tmp_path;
+    int fd;
+    int64_t price_scale;
+    bool has_timestamps;
+    uint64_t count{0};
+    TraderId max_trader{0};
+    std::vector<OrderFileRecord> buffer;
+};
+
+// Read-only mapping of an order file. The header and trader table are
+// checked on open; records are handed out as they lie in the file.
+class OrderFile {
+  public:
+    explicit OrderFile(const std::string &path);
+    ~OrderFile();
+
+    OrderFile(const OrderFile &) = delete;
+    OrderFile &operator=(const OrderFile &) = delete;
+
+    // Whether `path` starts with the order file magic.
+    static bool Detect(const std::string &path);
+
+    [[nodiscard]] std::span<const OrderFileRecord> Records() const {
+        return records;
+    }
+    [[nodiscard]] const std::vector<std::string> &TraderNames() const {
+        return trader_names;
+    }
+    [[nodiscard]] int64_t PriceScale() const { return price_scale; }
+    [[nodiscard]] bool HasTimestamps() const { return has_timestamps; }
+
+    [[nodiscard]] double Price(const OrderFileRecord &r) const {
+        return static_cast<double>(r.price) / static_cast<double>(price_scale);
+    }
+    // Whether `r` has known side and type codes and a trader in the table.
+    // Records are not checked on open, so readers test each one as they go.
+    [[nodiscard]] bool Valid(const OrderFileRecord &r) const {
+        return r.side <= SIDE::SELL && r.type <= TYPE::FOK_ORDER &&
+               r.trader < trader_names.size();
+    }
+
+  private:
+    const uint8_t *data{nullptr};
+    size_t size{0};
+    std::span<const OrderFileRecord> records;
+    std::vector<std::string> trader_names;
+    int64_t price_scale{1};
+    bool has_timestamps{false};
+};
@@ -0,0 +1,372 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+// Flat open-addressing map from order id to a small trivially copyable
+// value. Entries live inline in one power-of-two array with linear probing,
+// and erase shifts later entries back instead of leaving tombstones, so
+// lookups stay short under cancel churn and nothing is allocated per entry.
+// The table doubles when half full.
+template <typename V> class FlatIdMap {
+  public:
+    // Reserved key marking an empty slot; it cannot be stored.
+    static constexpr uint64_t kEmptyKey = UINT64_MAX;
+
+    FlatIdMap() { Rehash(kMinCapacity); }
+
+    [[nodiscard]] V *Find(uint64_t id) {
+        for (size_t i = Home(id);; i = (i + 1) & mask) {
+            Entry &e = entries[i];
+            if (e.key == id) {
+                return &e.value;
+            }
+            if (e.key == kEmptyKey) {
+                return nullptr;
+            }
+        }
+    }
+    [[nodiscard]] const V *Find(uint64_t id) const {
+        return const_cast<FlatIdMap *>(this)->Find(id);
+    }
+
+    // Inserts or overwrites the value stored for `id`.
+    void Assign(uint64_t id, const V &value) {
+        if (id == kEmptyKey) {
+            throw std::invalid_argument("Order id reserved by FlatIdMap");
+        }
+        if ((size + 1) * 2 > entries.size()) {
+            Rehash(entries.size() * 2);
+        }
+        for (size_t i = Home(id);; i = (i + 1) & mask) {
+            Entry &e = entries[i];
+            if (e.key == kEmptyKey) {
+                e.key = id;
+                e.value = value;
+                ++size;
+                return;
+            }
+            if (e.key == id) {
+                e.value = value;
+                return;
+            }
+        }
+    }
+
+    bool Erase(uint64_t id) {
+        size_t i = Home(id);
+        while (entries[i].key != id) {
+            if (entries[i].key == kEmptyKey) {
+                return false;
+            }
+            i = (i + 1) & mask;
+        }
+        // Pull later members of the probe run back into the hole so no
+        // lookup ever has to step over a deleted slot.
+        for (size_t j = (i + 1) & mask; entries[j].key != kEmptyKey;
+             j = (j + 1) & mask) {
+            const size_t home = Home(entries[j].key);
+            if (((j - home) & mask) >= ((j - i) & mask)) {
+                entries[i] = entries[j];
+                i = j;
+            }
+        }
+        entries[i].key = kEmptyKey;
+        --size;
+        return true;
+    }
+
+    [[nodiscard]] size_t Size() const { return size; }
+
+  private:
+    static constexpr size_t kMinCapacity = 16;
+
+    struct Entry {
+        uint64_t key;
+        V value;
+    };
+
+    // Fibonacci hashing spreads structured ids evenly over the table.
+    [[nodiscard]] size_t Home(uint64_t id) const {
+        return static_cast<size_t>((id * 0x9E3779B97F4A7C15ull) >> shift);
+    }
+
+    void Rehash(size_t new_capacity) {
+        std::vector<Entry> old = std::move(entries);
+        entries.assign(new_capacity, Entry{kEmptyKey, V{}});
+        mask = new_capacity - 1;
+        shift = 64;
+        for (size_t c = new_capacity; c > 1; c >>= 1) {
+            --shift;
+        }
+        size = 0;
+        for (const Entry &e : old) {
+            if (e.key != kEmptyKey) {
+                Assign(e.key, e.value);
+            }
+        }
+    }
+
+    std::vector<Entry> entries;
+    size_t mask{0};
+    int shift{64};
+    size_t size{0};
+};
+
+// Order-id index tuned for dense, mostly increasing ids (as exchanges and
+// the Parquet driver assign them). Ids inside a sliding window are stored in
+// fixed pages addressed directly by id, so lookup is a shift, an index and
+// a bit test with no probing, and consecutive ids share cache lines. Pages
+// are carved from geometrically growing blocks and recycled through a spare
+// list once emptied, so steady-state churn allocates nothing. Ids outside
+// the window (far below it, or too sparse to page) fall back to a
+// FlatIdMap.
+//
+// A new page is only opened where it will fill up: on or right after the
+// page of the newest ids once kMinPageFill of them landed there, or
+// elsewhere while paged ids average kMinPageFill per page and the
+// directory stays at least 1/kMaxDirSpread populated. Any other id goes to
+// the overflow map, so sparse ids cost an entry each rather than a page
+// each.
+template <typename V> class OrderIdIndex {
+  public:
+    OrderIdIndex() = default;
+    // A copy holds only the live pages, packed into a single block.
+    OrderIdIndex(const OrderIdIndex &other)
+        : base{other.base}, run_page{other.run_page},
+          run_ids{other.run_ids}, overflow{other.overflow},
+          size{other.size} {
+        const auto live = static_cast<size_t>(std::count_if(
+            other.dir.begin(), other.dir.end(),
+            [](const Page *p) { return p != nullptr; }));
+        if (live > 0) {
+            Grow(live);
+        }
+        dir.resize(other.dir.size());
+        for (size_t i = 0; i < dir.size(); ++i) {
+            if (other.dir[i]) {
+                dir[i] = spare.back();
+                spare.pop_back();
+                *dir[i] = *other.dir[i];
+            }
+        }
+    }
+    OrderIdIndex(OrderIdIndex &&) noexcept = default;
+    OrderIdIndex &operator=(const OrderIdIndex &other) {
+        if (this != &other) {
+            *this = OrderIdIndex(other);
+        }
+        return *this;
+    }
+    OrderIdIndex &operator=(OrderIdIndex &&) noexcept = default;
+
+    [[nodiscard]] V *Find(uint64_t id) {
+        if (Page *p = PageOf(id)) {
+            const uint32_t slot = SlotOf(id);
+            if (p->Test(slot)) {
+                return &p->values[slot];
+            }
+        }
+        return overflow.Size() ? overflow.Find(id) : nullptr;
+    }
+    [[nodiscard]] const V *Find(uint64_t id) const {
+        return const_cast<OrderIdIndex *>(this)->Find(id);
+    }
+
+    // Inserts or overwrites the value stored for `id`.
+    void Assign(uint64_t id, const V &value) {
+        if (overflow.Size()) {
+            if (V *v = overflow.Find(id)) {
+                *v = value;
+                return;
+            }
+        }
+        Page *p = PageFor(id);
+        if (!p) {
+            overflow.Assign(id, value);
+            ++size;
+            CountRun(id);
+            return;
+        }
+        const uint32_t slot = SlotOf(id);
+        if (!p->Test(slot)) {
+            p->Set(slot);
+            ++p->live;
+            ++size;
+            CountRun(id);
+        }
+        p->values[slot] = value;
+    }
+
+    bool Erase(uint64_t id) {
+        if (Page *p = PageOf(id)) {
+            const uint32_t slot = SlotOf(id);
+            if (p->Test(slot)) {
+                p->Clear(slot);
+                --size;
+                if (--p->live == 0) {
+                    ReleasePage(id >> kPageBits);
+                }
+                return true;
+            }
+        }
+        if (overflow.Size() && overflow.Erase(id)) {
+            --size;
+            return true;
+        }
+        return false;
+    }
+
+    // Pre-allocates pages for `expected` live ids so the first pass over a
+    // fresh id range does not allocate either.
+    void Reserve(size_t expected) {
+        const size_t pages = (expected + kPageSize - 1) / kPageSize + 1;
+        if (spare.size() < pages) {
+            Grow(pages - spare.size());
+        }
+    }
+
+    [[nodiscard]] size_t Size() const { return size; }
+    // Pages allocated, in use or spare.
+    [[nodiscard]] size_t Pages() const { return total_pages; }
+
+  private:
+    static constexpr int kPageBits = 10;
+    static constexpr uint64_t kPageSize = uint64_t{1} << kPageBits;
+    // Widest id span (in pages) kept directly addressable: 2^30 ids.
+    static constexpr uint64_t kMaxPages = uint64_t{1} << 20;
+    // Leading empty directory entries tolerated before compacting.
+    static constexpr size_t kTrimSlack = 64;
+    static constexpr size_t kMinBlockPages = 16;
+    static constexpr size_t kMaxBlockPages = 256;
+    // Ids a page must be expected to hold before one is opened for them.
+    static constexpr size_t kMinPageFill = kPageSize / 16;
+    // Directory entries allowed per live page when opening a page away
+    // from the newest ids.
+    static constexpr size_t kMaxDirSpread = 8;
+
+    struct Page {
+        V values[kPageSize];
+        uint64_t occupied[kPageSize / 64] = {};
+        uint32_t live{0};
+
+        [[nodiscard]] bool Test(uint32_t s) const {
+            return (occupied[s >> 6] >> (s & 63)) & 1;
+        }
+        void Set(uint32_t s) { occupied[s >> 6] |= uint64_t{1} << (s & 63); }
+        void Clear(uint32_t s) {
+            occupied[s >> 6] &= ~(uint64_t{1} << (s & 63));
+        }
+    };
+
+    static uint32_t SlotOf(uint64_t id) {
+        return static_cast<uint32_t>(id & (kPageSize - 1));
+    }
+
+    Page *PageOf(uint64_t id) const {
+        const uint64_t page = id >> kPageBits;
+        if (page < base || page - base >= dir.size()) {
+            return nullptr;
+        }
+        return dir[page - base];
+    }
+
+    // Page for `id`, creating it if needed, or nullptr if `id` belongs in
+    // the overflow map.
+    Page *PageFor(uint64_t id) {
+        const uint64_t page = id >> kPageBits;
+        if (dir.empty()) {
+            base = page;
+        }
+        if (page < base || page - base >= kMaxPages) {
+            return nullptr;
+        }
+        const size_t rel = page - base;
+        if (rel < dir.size() && dir[rel]) {
+            return dir[rel];
+        }
+        if (!dir.empty() && !Dense(page, std::max(dir.size(), rel + 1))) {
+            return nullptr;
+        }
+        if (dir.empty()) {
+            run_page = page;
+            run_ids = 0;
+        }
+        if (rel >= dir.size()) {
+            dir.resize(rel + 1);
+        }
+        if (spare.empty()) {
+            // Doubling keeps large allocations (and the allocator
+            // consolidation they can trigger) off the per-order path.
+            Grow(std::clamp(total_pages, kMinBlockPages, kMaxBlockPages));
+        }
+        dir[rel] = spare.back();
+        spare.pop_back();
+        return dir[rel];
+    }
+
+    // Whether a new page for `page`, with the directory spanning `span`
+    // pages, is likely to fill.
+    [[nodiscard]] bool Dense(uint64_t page, size_t span) const {
+        if ((page == run_page || page == run_page + 1) &&
+            run_ids >= kMinPageFill) {
+            return true;
+        }
+        const size_t live = total_pages - spare.size();
+        return size - overflow.Size() >= live * kMinPageFill &&
+               (live + 1) * kMaxDirSpread >= span;
+    }
+
+    // Counts a newly stored id towards the run of newest ids.
+    void CountRun(uint64_t id) {
+        const uint64_t page = id >> kPageBits;
+        if (page > run_page) {
+            run_page = page;
+            run_ids = 0;
+        }
+        run_ids += page == run_page;
+    }
+
+    void Grow(size_t pages) {
+        blocks.push_back(std::make_unique<Page[]>(pages));
+        for (size_t i = pages; i-- > 0;) {
+            spare.push_back(&blocks.back()[i]);
+        }
+        total_pages += pages;
+    }
+
+    void ReleasePage(uint64_t page) {
+        const size_t rel = page - base;
+        spare.push_back(dir[rel]);
+        dir[rel] = nullptr;
+        if (rel != 0) {
+            return;
+        }
+        // Slide the window forward past drained pages so it follows the
+        // live id range.
+        size_t first = 0;
+        while (first < dir.size() && !dir[first]) {
+            ++first;
+        }
+        if (first == dir.size()) {
+            dir.clear();
+        } else if (first >= kTrimSlack || first * 2 >= dir.size()) {
+            dir.erase(dir.begin(), dir.begin() + static_cast<long>(first));
+            base += first;
+        }
+    }
+
+    std::vector<std::unique_ptr<Page[]>> blocks;
+    std::vector<Page *> dir;
+    std::vector<Page *> spare;
+    size_t total_pages{0};
+    uint64_t base{0};
+    // Page of the newest id stored, and how many ids it has received.
+    uint64_t run_page{0};
+    size_t run_ids{0};
+    FlatIdMap<V> overflow;
+    size_t size{0};
+};
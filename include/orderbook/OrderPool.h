@@ -0,0 +1,130 @@
+#pragma once
+#include "Order.h"
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+// Fixed-capacity slab of resting orders. Slots are addressed by 32-bit
+// handles, chained into per-level FIFO queues through intrusive prev/next
+// links, and recycled through a free list. Storage is reserved once at
+// construction, so acquiring and releasing slots never allocates.
+//
+// A slot holds only what matching, filling and unlinking touch, packed into
+// 32 bytes so two resting orders share a cache line. The rest of an order
+// (timestamp, original size) is cold and kept by the owning book.
+class OrderPool {
+  public:
+    using Handle = uint32_t;
+    static constexpr Handle kNull = UINT32_MAX;
+
+    // Head/tail of one intrusive FIFO of slots (one price level).
+    struct Queue {
+        Handle head{kNull};
+        Handle tail{kNull};
+        [[nodiscard]] bool Empty() const { return head == kNull; }
+    };
+
+    struct Slot {
+        uint64_t order_id;
+        double price;
+        uint32_t qty_remaining;
+        TraderId trader;
+        Handle prev;
+        Handle next;
+    };
+    static_assert(sizeof(Slot) == 32);
+
+    explicit OrderPool(const uint32_t _capacity) : capacity{_capacity} {
+        if (capacity == 0 || capacity == kNull) {
+            throw std::invalid_argument("Invalid order pool capacity");
+        }
+        slots.reserve(capacity);
+    }
+    // Copies reserve the full capacity as well, so they never allocate
+    // either.
+    OrderPool(const OrderPool &other)
+        : free_head{other.free_head}, capacity{other.capacity},
+          live{other.live} {
+        slots.reserve(capacity);
+        slots = other.slots;
+    }
+    OrderPool(OrderPool &&) noexcept = default;
+    OrderPool &operator=(const OrderPool &other) {
+        if (this != &other) {
+            *this = OrderPool(other);
+        }
+        return *this;
+    }
+    OrderPool &operator=(OrderPool &&) noexcept = default;
+
+    // Copies `o` into a free slot. Throws std::length_error when all
+    // `capacity` slots hold live orders.
+    Handle Acquire(const Order &o) {
+        const Slot slot{o.OrderId(), o.Price(), o.QtyRemaining(),
+                        o.Trader(),  kNull,     kNull};
+        Handle h;
+        if (free_head != kNull) {
+            h = free_head;
+            free_head = slots[h].next;
+            slots[h] = slot;
+        } else if (slots.size() < capacity) {
+            h = static_cast<Handle>(slots.size());
+            slots.push_back(slot);
+        } else {
+            throw std::length_error("Order pool exhausted");
+        }
+        ++live;
+        return h;
+    }
+
+    void Release(Handle h) {
+        slots[h].next = free_head;
+        free_head = h;
+        --live;
+    }
+
+    [[nodiscard]] Slot &Get(Handle h) { return slots[h]; }
+    [[nodiscard]] const Slot &Get(Handle h) const { return slots[h]; }
+    [[nodiscard]] Handle Next(Handle h) const { return slots[h].next; }
+
+    void PushBack(Queue &q, Handle h) {
+        slots[h].prev = q.tail;
+        slots[h].next = kNull;
+        if (q.tail == kNull) {
+            q.head = h;
+        } else {
+            slots[q.tail].next = h;
+        }
+        q.tail = h;
+    }
+
+    void Unlink(Queue &q, Handle h) {
+        const Handle prev = slots[h].prev;
+        const Handle next = slots[h].next;
+        if (prev == kNull) {
+            q.head = next;
+        } else {
+            slots[prev].next = next;
+        }
+        if (next == kNull) {
+            q.tail = prev;
+        } else {
+            slots[next].prev = prev;
+        }
+    }
+
+    [[nodiscard]] uint32_t Capacity() const { return capacity; }
+    // Number of slots currently holding live orders.
+    [[nodiscard]] uint32_t Size() const { return live; }
+    [[nodiscard]] bool Full() const { return live == capacity; }
+    // Largest number of slots ever in use at once.
+    [[nodiscard]] uint32_t HighWaterMark() const {
+        return static_cast<uint32_t>(slots.size());
+    }
+
+  private:
+    std::vector<Slot> slots;
+    Handle free_head{kNull};
+    uint32_t capacity;
+    uint32_t live{0};
+};
@@ -0,0 +1,53 @@
+#pragma once
+#include "Fill.h"
+#include "Order.h"
+#include <cstdint>
+
+// Compile-time description of one side of the book, so matching and cancel
+// paths are written once as templates on SIDE and instantiated per side.
+// Prices may be doubles (OrderBook) or tick indices (TickOrderBook).
+template <SIDE S> struct SideTraits;
+
+template <> struct SideTraits<SIDE::BUY> {
+    static constexpr SIDE kOpposite = SIDE::SELL;
+
+    // Whether a resting ask at `resting` trades with a bid limited at `limit`.
+    template <typename P> static constexpr bool Crosses(P resting, P limit) {
+        return resting <= limit;
+    }
+
+    // Trades at the resting order's price.
+    static Fill MakeFill(const Order &incoming, uint64_t resting_id,
+                         TraderId resting_trader, double price, uint32_t qty) {
+        return Fill{incoming.OrderId(), resting_id,        incoming.Timestamp(),
+                    price,              incoming.Trader(), resting_trader,
+                    qty};
+    }
+    static Fill MakeFill(const Order &incoming, const Order &resting,
+                         uint32_t qty) {
+        return MakeFill(incoming, resting.OrderId(), resting.Trader(),
+                        resting.Price(), qty);
+    }
+};
+
+template <> struct SideTraits<SIDE::SELL> {
+    static constexpr SIDE kOpposite = SIDE::BUY;
+
+    // Whether a resting bid at `resting` trades with an ask limited at `limit`.
+    template <typename P> static constexpr bool Crosses(P resting, P limit) {
+        return resting >= limit;
+    }
+
+    // Trades at the resting order's price.
+    static Fill MakeFill(const Order &incoming, uint64_t resting_id,
+                         TraderId resting_trader, double price, uint32_t qty) {
+        return Fill{resting_id,     incoming.OrderId(), incoming.Timestamp(),
+                    price,          resting_trader,     incoming.Trader(),
+                    qty};
+    }
+    static Fill MakeFill(const Order &incoming, const Order &resting,
+                         uint32_t qty) {
+        return MakeFill(incoming, resting.OrderId(), resting.Trader(),
+                        resting.Price(), qty);
+    }
+};
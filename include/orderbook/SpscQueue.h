@@ -0,0 +1,69 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+// Bounded lock-free ring for exactly one producer thread and one consumer
+// thread. Capacity is rounded up to a power of two. Each side keeps a cached
+// copy of the other side's index so the shared cache lines are only read
+// when the ring looks full (producer) or empty (consumer).
+template <typename T> class SpscQueue {
+  public:
+    explicit SpscQueue(size_t _capacity) {
+        if (_capacity < 2) {
+            throw std::invalid_argument("SpscQueue capacity must be >= 2");
+        }
+        size_t cap = 1;
+        while (cap < _capacity) {
+            cap <<= 1;
+        }
+        buffer.resize(cap);
+        mask = cap - 1;
+    }
+
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    // Producer side. Returns false if the ring is full.
+    bool TryPush(const T &value) {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head_cache > mask) {
+            head_cache = head.load(std::memory_order_acquire);
+            if (t - head_cache > mask) {
+                return false;
+            }
+        }
+        buffer[t & mask] = value;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Returns false if the ring is empty.
+    bool TryPop(T &out) {
+        const size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail_cache) {
+            tail_cache = tail.load(std::memory_order_acquire);
+            if (h == tail_cache) {
+                return false;
+            }
+        }
+        out = buffer[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    [[nodiscard]] size_t Capacity() const { return mask + 1; }
+
+  private:
+    static constexpr size_t kCacheLine = 64;
+
+    std::vector<T> buffer;
+    size_t mask{0};
+
+    alignas(kCacheLine) std::atomic<size_t> head{0};
+    size_t tail_cache{0}; // consumer-owned
+    alignas(kCacheLine) std::atomic<size_t> tail{0};
+    size_t head_cache{0}; // producer-owned
+};
@@ -0,0 +1,61 @@
+#pragma once
+#include "Order.h"
+#include "OrderIdIndex.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <map>
+#include <vector>
+
+// Pending stop orders of one book, sorted by stop price per side in the
+// order they fire, so checking a trade only visits the stops it crosses.
+// A stop is set off by trades that happen after it arrives.
+class StopBook {
+  public:
+    StopBook() = default;
+    // Copies rebuild the queues so the id index points into their own.
+    StopBook(const StopBook &other);
+    StopBook(StopBook &&) noexcept = default;
+    StopBook &operator=(const StopBook &other);
+    StopBook &operator=(StopBook &&) noexcept = default;
+
+    [[nodiscard]] static bool IsStop(const Order &o) {
+        return o.Type() == TYPE::STOP_ORDER ||
+               o.Type() == TYPE::STOP_LIMIT_ORDER;
+    }
+
+    void Add(const Order &o);
+    bool Cancel(uint64_t order_id);
+    // Quantity of the pending stop `order_id`, 0 if there is none.
+    [[nodiscard]] uint32_t OpenQty(uint64_t order_id) const {
+        const Locator *loc = ids.Find(order_id);
+        return loc ? loc->it->QtyRemaining() : 0;
+    }
+
+    // Appends to `out` every stop set off by trades spanning [low, high],
+    // already turned into the order it becomes: buy stops at or below
+    // `high` (lowest first), then sell stops at or above `low` (highest
+    // first), first in first out within a stop price.
+    void Trigger(double low, double high, std::vector<Order> &out);
+
+    // Visits pending stops in the order Trigger would fire them, buys
+    // first. Re-adding them in this order rebuilds the same stop book.
+    void ForEach(const std::function<void(const Order &)> &visit) const;
+
+    [[nodiscard]] bool Empty() const { return ids.Size() == 0; }
+    [[nodiscard]] size_t Size() const { return ids.Size(); }
+
+  private:
+    using Queue = std::list<Order>;
+
+    struct Locator {
+        SIDE side;
+        double stop_price;
+        Queue::iterator it;
+    };
+
+    std::map<double, Queue> buy_stops;
+    std::map<double, Queue, std::greater<double>> sell_stops;
+    FlatIdMap<Locator> ids;
+};
@@ -0,0 +1,214 @@
+#pragma once
+#include "BookStats.h"
+#include "Fill.h"
+#include "Instrument.h"
+#include "MarketData.h"
+#include "Order.h"
+#include "OrderIdIndex.h"
+#include "OrderPool.h"
+#include "StopBook.h"
+#include "Trade.h"
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <span>
+#include <vector>
+
+// Price-time priority book over a fixed tick grid. Levels live in flat
+// arrays indexed by tick offset, and the best bid/ask indices are maintained
+// incrementally, so reaching the top of book never walks a tree. It produces
+// the same trades as OrderBook for any input on the instrument's grid.
+// Resting orders live in a fixed-capacity OrderPool sized by `max_orders`.
+class TickOrderBook {
+  public:
+    static constexpr uint32_t kDefaultMaxOrders = 1u << 20;
+
+    explicit TickOrderBook(const InstrumentSpec &_spec,
+                           uint32_t max_orders = kDefaultMaxOrders);
+    // Every container links by index, so a memberwise copy is an
+    // independent book in the same state. It keeps the depth sink.
+    TickOrderBook(const TickOrderBook &) = default;
+    TickOrderBook(TickOrderBook &&) noexcept = default;
+    TickOrderBook &operator=(const TickOrderBook &) = default;
+    TickOrderBook &operator=(TickOrderBook &&) noexcept = default;
+
+    // Throws std::invalid_argument if the price is off the grid or band
+    // (market and stop-market orders carry no price and are not checked).
+    // Stop prices need not be on the grid. Throws std::length_error, before
+    // trading, for a limit order that would rest while every pool slot is
+    // taken; a stop-limit set off in that state is dropped.
+    TradeVector ProcessOrder(const Order &_incoming);
+    // Same matching, but fills are written to `sink` as they happen and no
+    // Trade objects are built. The TradeVector overload wraps this one.
+    void ProcessOrder(const Order &_incoming, FillSink &sink);
+    // Runs `orders` in sequence with exactly the per-order semantics of
+    // ProcessOrder, writing every fill to `sink` (a FillRing or one
+    // CallbackSink gives a single output buffer). If an order throws, the
+    // ones before it stay applied.
+    void ProcessBatch(std::span<const Order> orders, FillSink &sink);
+    // Cancels a resting or pending stop order.
+    bool CancelOrder(uint64_t order_id);
+    // Amends a resting order to `new_price` with `new_qty` left open. A
+    // decrease at the same price is applied in place and keeps queue
+    // priority; an increase or a price change sends the order to the back
+    // of its new level after matching it against the other side. A zero
+    // quantity cancels whatever the price. Returns false for unknown ids
+    // and pending stops; otherwise throws std::invalid_argument if
+    // `new_price` is off the grid or band.
+    // For an iceberg `new_qty` is its whole open quantity; a decrease comes
+    // out of the hidden part first.
+    bool ModifyOrder(uint64_t order_id, double new_price, uint32_t new_qty,
+                     FillSink &sink);
+
+    // Aggregated L2 view, maintained incrementally per level. Top of book is
+    // O(1); Depth writes the best `levels` levels of `side` (best first)
+    // into `out`, replacing its contents, skipping empty ticks 64 at a time.
+    [[nodiscard]] std::optional<DepthLevel> BestBid() const;
+    [[nodiscard]] std::optional<DepthLevel> BestAsk() const;
+    void Depth(SIDE side, size_t levels, std::vector<DepthLevel> &out) const;
+    // Every level change is reported to `sink` (nullptr turns it off).
+    void SetDepthSink(DepthSink *_depth_sink) { depth_sink = _depth_sink; }
+    // Self-trade prevention policy, off (STP::NONE) by default. With it on,
+    // a fill-or-kill order is killed if the levels it needs hold an order
+    // of its own trader.
+    void SetSelfTradePrevention(STP _stp) { stp = _stp; }
+
+    // Visits every resting order: bids then asks, each from the best level
+    // outwards and in queue order within a level, then the pending stops.
+    // Re-submitting them in this order to an empty book rebuilds the same
+    // book. Icebergs are reported with their whole open quantity.
+    void ForEachResting(const std::function<void(const Order &)> &visit) const;
+
+    // Whole open quantity of a resting or pending stop order, 0 if there
+    // is none.
+    [[nodiscard]] uint32_t OpenQty(uint64_t order_id) const;
+
+    // Snapshot of the hot-path counters (see BookStats.h) plus current
+    // order and level counts.
+    [[nodiscard]] BookStats Stats() const;
+
+    [[nodiscard]] const InstrumentSpec &Spec() const { return spec; }
+    [[nodiscard]] const OrderPool &Pool() const { return pool; }
+
+  private:
+    using OrderQueue = OrderPool::Queue;
+
+    // Sentinel tick meaning "this side is empty".
+    static constexpr uint32_t kNoLevel = UINT32_MAX;
+
+    InstrumentSpec spec;
+    OrderPool pool;
+
+    // `qty` is the displayed quantity; `hidden` sums the icebergs'
+    // reserves. `traders` has bit TraderBit(t) set once trader t rests
+    // here and is cleared with the level, so a clear bit rules out a
+    // self-trade without reading the orders.
+    struct PriceLevel {
+        OrderQueue orders;
+        uint64_t qty{0};
+        uint64_t hidden{0};
+        uint32_t count{0};
+        uint32_t traders{0};
+
+        static uint32_t TraderBit(TraderId t) { return 1u << (t & 31); }
+    };
+
+    // Everything one side of the book needs, indexed by tick.
+    struct SideBook {
+        explicit SideBook(uint32_t num_ticks)
+            : levels(num_ticks), occupied((num_ticks + 63) / 64) {}
+
+        std::vector<PriceLevel> levels;
+        // One bit per tick, set while that level is non-empty. Used to find
+        // the next best level in 64-tick strides once the best one empties.
+        std::vector<uint64_t> occupied;
+        uint32_t best{kNoLevel};
+    };
+
+    SideBook bids;
+    SideBook asks;
+
+    DepthSink *depth_sink{nullptr};
+    STP stp{STP::NONE};
+
+    // Where a resting order lives, plus its cold fields: the pool slot only
+    // carries what matching reads. Resting orders are always limit orders;
+    // the slot holds what one shows and `hidden` an iceberg's reserve.
+    struct OrderLocator {
+        int64_t timestamp;
+        uint32_t tick;
+        OrderPool::Handle handle;
+        uint32_t qty;
+        uint32_t display_qty;
+        uint32_t hidden;
+        SIDE side;
+    };
+
+    [[nodiscard]] Order Materialize(const OrderLocator &loc) const;
+
+    template <SIDE S> SideBook &Book() {
+        if constexpr (S == SIDE::BUY) {
+            return bids;
+        } else {
+            return asks;
+        }
+    }
+    template <SIDE S> const SideBook &Book() const {
+        if constexpr (S == SIDE::BUY) {
+            return bids;
+        } else {
+            return asks;
+        }
+    }
+
+    // Orders whose ticks ProcessBatch resolves per pass.
+    static constexpr size_t kBatchChunk = 64;
+
+    // Tick an order trades up to: the far end of the band for market
+    // orders, kNoLevel if a priced order is off the grid.
+    [[nodiscard]] uint32_t LimitTick(const Order &o) const;
+    // ProcessOrder once the tick is known.
+    void ProcessAt(const Order &_incoming, uint32_t tick, FillSink &sink);
+    // Whether `o` can get a pool slot should any of it rest.
+    [[nodiscard]] bool CanRest(const Order &o, uint32_t tick) const;
+    // Runs a non-stop order against the book; the public entry points then
+    // call FireStops.
+    void Execute(Order incoming, uint32_t tick, FillSink &sink);
+    // Runs the stops set off by the range traded since the last call,
+    // including any that those trades set off in turn.
+    void FireStops(FillSink &sink);
+
+    // Matching, resting and cancel paths, written once and instantiated per
+    // side through SideTraits; S is the side of the order being handled.
+    template <SIDE S> void Match(Order &incoming, uint32_t tick, FillSink &sink);
+    template <SIDE S> void AddToBook(const Order &o, uint32_t tick);
+    // Refills the iceberg at the head of `level` whose shown slice just
+    // traded out, moving it to the back; false if it has no reserve left.
+    bool Replenish(PriceLevel &level);
+    // Unlinks the order from its level queue; the slot stays acquired.
+    template <SIDE S> void RemoveFromLevel(const OrderLocator &loc);
+    template <SIDE S> void ClearLevel(uint32_t tick);
+    // Whether matching would take the whole quantity of `o` up to `tick`,
+    // summed from level aggregates; orders are only read in levels where
+    // `o`'s trader may rest under CANCEL_NEWEST or CANCEL_OLDEST.
+    template <SIDE S>
+    [[nodiscard]] bool CanFill(const Order &o, uint32_t tick) const;
+    template <SIDE S>
+    void CollectDepth(size_t levels, std::vector<DepthLevel> &out) const;
+    template <SIDE S>
+    void VisitSide(const std::function<void(const Order &)> &visit) const;
+    void PublishLevel(SIDE side, uint32_t tick, const PriceLevel &level);
+
+    OrderIdIndex<OrderLocator> locators;
+    BookStatsRecorder stats;
+    // Resting orders with a display quantity; while zero, a fully traded
+    // order is removed without looking for a reserve.
+    uint32_t icebergs{0};
+    StopBook stops;
+    std::vector<Order> triggered;
+    // Price range traded since stops were last checked; empty when low >
+    // high.
+    double traded_low{std::numeric_limits<double>::infinity()};
+    double traded_high{-std::numeric_limits<double>::infinity()};
+};
@@ -0,0 +1,34 @@
+#pragma once
+#include "Order.h"
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Symbol table mapping trader names to dense TraderIds. Names are interned
+// once at ingest; the books only ever see ids, and names are resolved back
+// when trades are printed or exported.
+class TraderTable {
+  public:
+    // Returns the id of `name`, assigning the next free id on first sight.
+    // Looking up a known name does not allocate.
+    TraderId Intern(std::string_view name);
+
+    [[nodiscard]] const std::string &Name(TraderId id) const {
+        return names.at(id);
+    }
+    [[nodiscard]] size_t Size() const { return names.size(); }
+
+  private:
+    struct NameHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view s) const {
+            return std::hash<std::string_view>{}(s);
+        }
+    };
+
+    std::vector<std::string> names;
+    std::unordered_map<std::string, TraderId, NameHash, std::equal_to<>> ids;
+};
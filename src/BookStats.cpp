@@ -0,0 +1,65 @@
+#include "orderbook/BookStats.h"
+
+#include <cmath>
+#include <ostream>
+
+const char *StatsClock::Unit() {
+#if defined(__x86_64__) || defined(__i386__)
+    return "tsc";
+#else
+    return "ns";
+#endif
+}
+
+uint64_t LatencyBuckets::Quantile(double q) const {
+    if (samples == 0) {
+        return 0;
+    }
+    const auto rank = static_cast<uint64_t>(
+        std::ceil(q * static_cast<double>(samples)));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        seen += counts[i];
+        if (seen >= rank && seen > 0) {
+            return i >= 64 ? max : (uint64_t{1} << i) - 1;
+        }
+    }
+    return max;
+}
+
+namespace {
+
+void PrintLatency(std::ostream &os, const char *name,
+                  const LatencyBuckets &b) {
+    os << "  " << name << " latency (" << StatsClock::Unit()
+       << "): n=" << b.samples << " p50<=" << b.Quantile(0.50)
+       << " p99<=" << b.Quantile(0.99) << " p99.9<=" << b.Quantile(0.999)
+       << " max=" << b.max << "\n";
+}
+
+} // namespace
+
+void PrintBookStats(std::ostream &os, const BookStats &s) {
+    os << "Book stats:\n";
+    os << "  resting orders: " << s.resting_orders
+       << ", bid levels: " << s.bid_levels
+       << ", ask levels: " << s.ask_levels;
+    if (s.dead_orders != 0) {
+        os << ", dead orders: " << s.dead_orders;
+    }
+    os << "\n";
+    if (!s.enabled) {
+        os << "  (counters compiled out; build with ORDERBOOK_STATS=ON)\n";
+        return;
+    }
+    os << "  orders: " << s.orders << ", fills: " << s.fills
+       << ", cancels: " << s.cancels << ", modifies: " << s.modifies << "\n";
+    os << "  cancel misses: " << s.cancel_misses
+       << ", cancel level misses: " << s.cancel_level_misses
+       << ", self trades prevented: " << s.self_trades_prevented << "\n";
+    os << "  levels swept: " << s.levels_swept
+       << " (max per order " << s.max_levels_swept
+       << "), max queue length: " << s.max_queue_length << "\n";
+    PrintLatency(os, "ProcessOrder", s.process_latency);
+    PrintLatency(os, "CancelOrder", s.cancel_latency);
+}
@@ -0,0 +1,640 @@
+#include "orderbook/Gateway.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+// epoll tokens below kFirstSession name the gateway's own descriptors.
+constexpr uint64_t kWakeToken = 0;
+constexpr uint64_t kUnixToken = 1;
+constexpr uint64_t kTcpToken = 2;
+constexpr uint32_t kFirstSession = 16;
+
+constexpr int kMaxEvents = 256;
+// Requests buffered per session read; a read that fills it is repeated.
+constexpr size_t kReadBufferBytes = 64 * 1024;
+// A session whose unsent reports grow past this is dropped as too slow.
+constexpr size_t kMaxPendingOutput = 64u << 20;
+
+[[noreturn]] void ThrowErrno(const std::string &what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+sockaddr_un UnixAddress(const std::string &path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        throw std::invalid_argument("Unix socket path too long: " + path);
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return addr;
+}
+
+sockaddr_in LoopbackAddress(int port) {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    return addr;
+}
+
+int ListenOn(int domain, const sockaddr *addr, socklen_t len,
+             const std::string &what) {
+    const int fd =
+        ::socket(domain, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        ThrowErrno("socket " + what);
+    }
+    const int one = 1;
+    if (domain == AF_INET) {
+        ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    }
+    if (::bind(fd, addr, len) != 0 || ::listen(fd, SOMAXCONN) != 0) {
+        const int err = errno;
+        ::close(fd);
+        errno = err;
+        ThrowErrno("listen " + what);
+    }
+    return fd;
+}
+
+void EpollAdd(int epoll_fd, int fd, uint32_t events, uint64_t token) {
+    epoll_event ev{};
+    ev.events = events;
+    ev.data.u64 = token;
+    if (::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        ThrowErrno("epoll_ctl");
+    }
+}
+
+int64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+} // namespace
+
+Gateway::Gateway(const GatewayOptions &_opts)
+    : opts{_opts},
+      engine(_opts.workers, this, MatchingEngine::kDefaultQueueCapacity,
+             _opts.pin_threads) {
+    for (uint32_t i = 0; i < engine.NumWorkers(); ++i) {
+        reports.push_back(std::make_unique<SpscQueue<EngineReport>>(
+            opts.report_queue_capacity));
+    }
+    pending.resize(engine.NumWorkers());
+    // A full engine ring means the workers may be waiting on ours.
+    engine.SetBackoff([this] { DrainReports(); });
+
+    epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+    wake_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    reserve_fd = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+    if (epoll_fd < 0 || wake_fd < 0 || reserve_fd < 0) {
+        const int err = errno;
+        ::close(epoll_fd);
+        ::close(wake_fd);
+        ::close(reserve_fd);
+        errno = err;
+        ThrowErrno("gateway event loop");
+    }
+    try {
+        EpollAdd(epoll_fd, wake_fd, EPOLLIN, kWakeToken);
+        if (!opts.unix_path.empty()) {
+            const sockaddr_un addr = UnixAddress(opts.unix_path);
+            ::unlink(opts.unix_path.c_str());
+            unix_fd =
+                ListenOn(AF_UNIX, reinterpret_cast<const sockaddr *>(&addr),
+                         sizeof(addr), opts.unix_path);
+            EpollAdd(epoll_fd, unix_fd, EPOLLIN, kUnixToken);
+        }
+        if (opts.tcp_port >= 0) {
+            sockaddr_in addr = LoopbackAddress(opts.tcp_port);
+            tcp_fd =
+                ListenOn(AF_INET, reinterpret_cast<const sockaddr *>(&addr),
+                         sizeof(addr), "tcp");
+            socklen_t len = sizeof(addr);
+            ::getsockname(tcp_fd, reinterpret_cast<sockaddr *>(&addr), &len);
+            tcp_port = ntohs(addr.sin_port);
+            EpollAdd(epoll_fd, tcp_fd, EPOLLIN, kTcpToken);
+        }
+    } catch (...) {
+        for (int fd : {tcp_fd, unix_fd, reserve_fd, wake_fd, epoll_fd}) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+        }
+        throw;
+    }
+}
+
+Gateway::~Gateway() {
+    try {
+        Stop();
+    } catch (const std::exception &) {
+        // Destructors must not throw; call Stop() to see the error.
+    }
+    for (int fd : {tcp_fd, unix_fd, reserve_fd, wake_fd, epoll_fd}) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+    if (unix_fd >= 0) {
+        ::unlink(opts.unix_path.c_str());
+    }
+}
+
+void Gateway::AddInstrument(SymbolId symbol, const InstrumentSpec &spec,
+                            uint32_t max_orders) {
+    if (running) {
+        throw std::logic_error("Instruments must be added before Start()");
+    }
+    engine.AddInstrument(symbol, spec, max_orders);
+    symbol_worker[symbol] = engine.WorkerOf(symbol);
+}
+
+void Gateway::Start() {
+    if (running) {
+        return;
+    }
+    running = true;
+    engine.Start();
+    network = std::thread([this] { Run(); });
+}
+
+void Gateway::Stop() {
+    if (!running) {
+        return;
+    }
+    stopping.store(true, std::memory_order_release);
+    const uint64_t one = 1;
+    [[maybe_unused]] const ssize_t w = ::write(wake_fd, &one, sizeof(one));
+    network.join();
+    closing.store(true, std::memory_order_release);
+    engine.Stop();
+    while (!sessions.empty()) {
+        CloseSession(sessions.begin()->first);
+    }
+    running = false;
+    if (error) {
+        std::rethrow_exception(std::exchange(error, nullptr));
+    }
+}
+
+// ---- Worker side ----
+
+void Gateway::OnFill(SymbolId symbol, const Fill &fill) {
+    Push(symbol, EngineReport{EngineReport::Kind::FILL, true, fill.qty,
+                              fill.buy_order_id, fill.sell_order_id,
+                              fill.price});
+}
+
+void Gateway::OnProcessed(SymbolId symbol, uint64_t order_id, EngineOp,
+                          bool ok, uint32_t open_qty) {
+    Push(symbol, EngineReport{EngineReport::Kind::DONE, ok, open_qty,
+                              order_id, 0, 0.0});
+    // Every message ends here, so one wakeup covers its fills too. The
+    // network thread clears the flag before draining, so a report pushed
+    // after its drain always finds the flag clear and wakes it again.
+    if (!wake_pending.exchange(true)) {
+        const uint64_t one = 1;
+        [[maybe_unused]] const ssize_t w =
+            ::write(wake_fd, &one, sizeof(one));
+    }
+}
+
+void Gateway::Push(SymbolId symbol, const EngineReport &r) {
+    auto &ring = *reports[symbol_worker.find(symbol)->second];
+    while (!ring.TryPush(r)) {
+        if (closing.load(std::memory_order_acquire)) {
+            return;
+        }
+        std::this_thread::yield();
+    }
+}
+
+// ---- Network thread ----
+
+void Gateway::Run() {
+    try {
+        Loop();
+    } catch (...) {
+        // Nothing reads the workers' output any more, so let them drop it.
+        error = std::current_exception();
+        closing.store(true, std::memory_order_release);
+        failed.store(true, std::memory_order_release);
+    }
+}
+
+void Gateway::Loop() {
+    epoll_event events[kMaxEvents];
+    const int timeout = opts.busy_poll ? 0 : -1;
+    while (!stopping.load(std::memory_order_acquire)) {
+        const int n = ::epoll_wait(epoll_fd, events, kMaxEvents, timeout);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ThrowErrno("epoll_wait");
+        }
+        for (int i = 0; i < n; ++i) {
+            const uint64_t token = events[i].data.u64;
+            if (token == kWakeToken) {
+                uint64_t count;
+                [[maybe_unused]] const ssize_t r =
+                    ::read(wake_fd, &count, sizeof(count));
+                wake_pending.exchange(false);
+            } else if (token == kUnixToken) {
+                Accept(unix_fd);
+            } else if (token == kTcpToken) {
+                Accept(tcp_fd);
+            } else {
+                auto it = sessions.find(static_cast<uint32_t>(token));
+                if (it == sessions.end()) {
+                    continue;
+                }
+                Session &s = *it->second;
+                if (events[i].events & EPOLLOUT) {
+                    if (!s.dirty) {
+                        s.dirty = true;
+                        dirty.push_back(s.id);
+                    }
+                }
+                if (events[i].events &
+                    (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                    ReadSession(s);
+                }
+            }
+        }
+        DrainReports();
+        Flush();
+        requests_handled.store(requests, std::memory_order_relaxed);
+        reports_sent.store(sent, std::memory_order_relaxed);
+    }
+}
+
+void Gateway::Accept(int listen_fd) {
+    while (true) {
+        const int fd = ::accept4(listen_fd, nullptr, nullptr,
+                                 SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return;
+            }
+            if (errno == EINTR || errno == ECONNABORTED || errno == EPROTO) {
+                continue;
+            }
+            if ((errno == EMFILE || errno == ENFILE) && reserve_fd >= 0) {
+                // The pending client would keep the level-triggered
+                // listener ready forever: free the spare descriptor to
+                // accept it, hang up and take the spare back.
+                ::close(reserve_fd);
+                const int shed = ::accept4(listen_fd, nullptr, nullptr,
+                                           SOCK_CLOEXEC);
+                const int err = errno;
+                reserve_fd = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+                if (shed < 0) {
+                    errno = err;
+                    ThrowErrno("accept");
+                }
+                ::close(shed);
+                continue;
+            }
+            ThrowErrno("accept");
+        }
+        if (listen_fd == tcp_fd) {
+            const int one = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+        const uint32_t id = kFirstSession + next_session++;
+        auto s = std::make_unique<Session>();
+        s->fd = fd;
+        s->id = id;
+        s->in.resize(kReadBufferBytes);
+        try {
+            EpollAdd(epoll_fd, fd, EPOLLIN | EPOLLRDHUP, id);
+        } catch (const std::system_error &) {
+            // Out of epoll watches: turn this client away.
+            ::close(fd);
+            continue;
+        }
+        sessions.emplace(id, std::move(s));
+        sessions_accepted.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Gateway::ReadSession(Session &s) {
+    const uint32_t id = s.id;
+    while (true) {
+        const size_t room = s.in.size() - s.in_len;
+        const ssize_t n = ::read(s.fd, s.in.data() + s.in_len, room);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+            CloseSession(id);
+            return;
+        }
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        s.in_len += static_cast<size_t>(n);
+
+        size_t at = 0;
+        for (; s.in_len - at >= sizeof(WireRequest);
+             at += sizeof(WireRequest)) {
+            WireRequest req;
+            std::memcpy(&req, s.in.data() + at, sizeof(req));
+            HandleRequest(s, req);
+        }
+        std::memmove(s.in.data(), s.in.data() + at, s.in_len - at);
+        s.in_len -= at;
+        // A short read drained the socket; skip the read that would only
+        // return EAGAIN.
+        if (static_cast<size_t>(n) < room) {
+            return;
+        }
+    }
+}
+
+void Gateway::HandleRequest(Session &s, const WireRequest &req) {
+    ++requests;
+    auto reject = [&](uint32_t leaves) {
+        Send(s.id, WireReport{ReportKind::REJECTED, req.kind, {}, 0,
+                              req.client_order_id, req.tag, 0.0, leaves, 0});
+    };
+
+    if (req.kind == RequestKind::NEW) {
+        auto worker = symbol_worker.find(req.symbol);
+        // The record has no stop price, so stop types are refused.
+        if (worker == symbol_worker.end() || req.side > SIDE::SELL ||
+            req.type > TYPE::FOK_ORDER ||
+            s.orders.Find(req.client_order_id) ||
+            req.client_order_id == FlatIdMap<uint64_t>::kEmptyKey) {
+            reject(0);
+            return;
+        }
+        const uint64_t id = next_order_id++;
+        s.orders.Assign(req.client_order_id, id);
+        routes.Assign(id, Route{s.id, req.symbol, req.qty,
+                                req.client_order_id});
+        pending[worker->second].push_back(Pending{
+            s.id, req.kind, false, req.qty, id, req.client_order_id, req.tag});
+        engine.Submit(req.symbol, Order(id, NowNs(), req.trader, req.side,
+                                        req.price, req.qty, req.type));
+        return;
+    }
+
+    const uint64_t *id = s.orders.Find(req.client_order_id);
+    if (!id || (req.kind != RequestKind::CANCEL &&
+                req.kind != RequestKind::MODIFY)) {
+        reject(0);
+        return;
+    }
+    const uint64_t order_id = *id;
+    const SymbolId symbol = routes.Find(order_id)->symbol;
+    pending[symbol_worker.find(symbol)->second].push_back(
+        Pending{s.id, req.kind, false, req.qty, order_id, req.client_order_id,
+                req.tag});
+    if (req.kind == RequestKind::CANCEL) {
+        engine.Cancel(symbol, order_id);
+    } else {
+        engine.Modify(symbol, order_id, req.price, req.qty);
+    }
+}
+
+void Gateway::DrainReports() {
+    EngineReport r;
+    for (size_t w = 0; w < reports.size(); ++w) {
+        while (reports[w]->TryPop(r)) {
+            if (r.kind == EngineReport::Kind::FILL) {
+                Pending *current =
+                    pending[w].empty() ? nullptr : &pending[w].front();
+                ReportFill(r.order_id, r.price, r.qty, current);
+                ReportFill(r.other_id, r.price, r.qty, current);
+            } else {
+                const Pending p = pending[w].front();
+                pending[w].pop_front();
+                Complete(p, r);
+            }
+        }
+    }
+}
+
+void Gateway::ReportFill(uint64_t order_id, double price, uint32_t qty,
+                         Pending *current) {
+    Route *route = routes.Find(order_id);
+    if (!route) {
+        return;
+    }
+    if (current && current->kind == RequestKind::MODIFY &&
+        current->order_id == order_id && !current->amended) {
+        // First fill of an amend that re-matched: it trades from the new
+        // quantity, whatever fills reached the old one before.
+        current->amended = true;
+        route->leaves = current->qty;
+    }
+    route->leaves -= std::min(route->leaves, qty);
+    Send(route->session,
+         WireReport{ReportKind::FILL, RequestKind::NEW, {}, qty,
+                    route->client_order_id, 0, price, route->leaves, 0});
+    if (route->leaves == 0) {
+        Forget(order_id, *route);
+    }
+}
+
+void Gateway::Complete(const Pending &p, const EngineReport &r) {
+    ReportKind kind = ReportKind::REJECTED;
+    if (r.ok) {
+        kind = p.kind == RequestKind::NEW      ? ReportKind::ACCEPTED
+               : p.kind == RequestKind::CANCEL ? ReportKind::CANCELED
+                                               : ReportKind::MODIFIED;
+    }
+    Send(p.session, WireReport{kind, p.kind, {}, 0, p.client_order_id, p.tag,
+                               0.0, r.qty, 0});
+    // The engine's open quantity is exact as of this message; later fills
+    // count down from it.
+    if (Route *route = routes.Find(r.order_id)) {
+        route->leaves = r.qty;
+        if (r.qty == 0) {
+            Forget(r.order_id, *route);
+        }
+    }
+}
+
+void Gateway::Forget(uint64_t order_id, const Route &route) {
+    auto it = sessions.find(route.session);
+    if (it != sessions.end()) {
+        FlatIdMap<uint64_t> &orders = it->second->orders;
+        // The client may already reuse the id for a newer order.
+        const uint64_t *current = orders.Find(route.client_order_id);
+        if (current && *current == order_id) {
+            orders.Erase(route.client_order_id);
+        }
+    }
+    routes.Erase(order_id);
+}
+
+void Gateway::Send(uint32_t session, const WireReport &report) {
+    auto it = sessions.find(session);
+    if (it == sessions.end()) {
+        return;
+    }
+    Session &s = *it->second;
+    const size_t at = s.out.size();
+    s.out.resize(at + sizeof(report));
+    std::memcpy(s.out.data() + at, &report, sizeof(report));
+    ++sent;
+    if (!s.dirty) {
+        s.dirty = true;
+        dirty.push_back(session);
+    }
+}
+
+void Gateway::Flush() {
+    for (const uint32_t id : dirty) {
+        auto it = sessions.find(id);
+        if (it == sessions.end()) {
+            continue;
+        }
+        Session &s = *it->second;
+        s.dirty = false;
+        while (s.out_sent < s.out.size()) {
+            const ssize_t n =
+                ::send(s.fd, s.out.data() + s.out_sent,
+                       s.out.size() - s.out_sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno != EAGAIN) {
+                    CloseSession(id);
+                }
+                break;
+            }
+            s.out_sent += static_cast<size_t>(n);
+        }
+        if (!sessions.count(id)) {
+            continue;
+        }
+        const bool blocked = s.out_sent < s.out.size();
+        if (!blocked) {
+            s.out.clear();
+            s.out_sent = 0;
+        } else if (s.out.size() - s.out_sent > kMaxPendingOutput) {
+            CloseSession(id);
+            continue;
+        }
+        if (blocked != s.want_write) {
+            s.want_write = blocked;
+            epoll_event ev{};
+            ev.events = EPOLLIN | EPOLLRDHUP;
+            if (blocked) {
+                ev.events |= EPOLLOUT;
+            }
+            ev.data.u64 = id;
+            ::epoll_ctl(epoll_fd, EPOLL_CTL_MOD, s.fd, &ev);
+        }
+    }
+    dirty.clear();
+}
+
+void Gateway::CloseSession(uint32_t session) {
+    auto it = sessions.find(session);
+    if (it == sessions.end()) {
+        return;
+    }
+    // Closing the descriptor also drops it from the epoll set.
+    ::close(it->second->fd);
+    sessions.erase(it);
+}
+
+// ---- Client ----
+
+GatewayClient::GatewayClient(const std::string &unix_path)
+    : in(kReadBufferBytes) {
+    const sockaddr_un addr = UnixAddress(unix_path);
+    fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<const sockaddr *>(&addr),
+                            sizeof(addr)) != 0) {
+        const int err = errno;
+        ::close(fd);
+        errno = err;
+        ThrowErrno("connect " + unix_path);
+    }
+}
+
+GatewayClient::GatewayClient(int tcp_port) : in(kReadBufferBytes) {
+    const sockaddr_in addr = LoopbackAddress(tcp_port);
+    fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<const sockaddr *>(&addr),
+                            sizeof(addr)) != 0) {
+        const int err = errno;
+        ::close(fd);
+        errno = err;
+        ThrowErrno("connect tcp " + std::to_string(tcp_port));
+    }
+    const int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+GatewayClient::~GatewayClient() { ::close(fd); }
+
+void GatewayClient::Send(std::span<const WireRequest> requests) {
+    const auto *p = reinterpret_cast<const uint8_t *>(requests.data());
+    size_t left = requests.size_bytes();
+    while (left > 0) {
+        const ssize_t n = ::send(fd, p, left, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ThrowErrno("gateway send");
+        }
+        p += n;
+        left -= static_cast<size_t>(n);
+    }
+}
+
+bool GatewayClient::Receive(std::vector<WireReport> &out) {
+    while (true) {
+        const ssize_t n = ::read(fd, in.data() + in_len, in.size() - in_len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ThrowErrno("gateway read");
+        }
+        if (n == 0) {
+            return false;
+        }
+        in_len += static_cast<size_t>(n);
+        size_t at = 0;
+        for (; in_len - at >= sizeof(WireReport); at += sizeof(WireReport)) {
+            WireReport r;
+            std::memcpy(&r, in.data() + at, sizeof(r));
+            out.push_back(r);
+        }
+        std::memmove(in.data(), in.data() + at, in_len - at);
+        in_len -= at;
+        if (at > 0) {
+            return true;
+        }
+    }
+}
@@ -0,0 +1,434 @@
+#include "orderbook/Journal.h"
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+namespace fs = std::filesystem;
+
+constexpr char kSnapshotMagic[8] = {'O', 'B', 'S', 'N', 'A', 'P', '0', '1'};
+constexpr uint32_t kSnapshotVersion = 3;
+// Magic, version, record size, seq, record count, max order id.
+constexpr size_t kSnapshotHeaderSize = 40;
+constexpr size_t kChecksumOffset = kJournalRecordSize - 4;
+// Records buffered by SnapshotWriter between writes.
+constexpr size_t kSnapshotBufferRecords = 4096;
+
+[[noreturn]] void ThrowErrno(const std::string &what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+void PutU32(uint8_t *p, uint32_t v) {
+    for (int i = 0; i < 4; ++i) {
+        p[i] = static_cast<uint8_t>(v >> (8 * i));
+    }
+}
+
+void PutU64(uint8_t *p, uint64_t v) {
+    for (int i = 0; i < 8; ++i) {
+        p[i] = static_cast<uint8_t>(v >> (8 * i));
+    }
+}
+
+uint32_t GetU32(const uint8_t *p) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; ++i) {
+        v |= static_cast<uint32_t>(p[i]) << (8 * i);
+    }
+    return v;
+}
+
+uint64_t GetU64(const uint8_t *p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; ++i) {
+        v |= static_cast<uint64_t>(p[i]) << (8 * i);
+    }
+    return v;
+}
+
+// FNV-1a; enough to tell a complete record from a torn or zeroed one.
+uint32_t Checksum(const uint8_t *p, size_t n) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < n; ++i) {
+        h = (h ^ p[i]) * 16777619u;
+    }
+    return h;
+}
+
+void WriteAll(int fd, const uint8_t *data, size_t n, const std::string &what) {
+    while (n > 0) {
+        const ssize_t w = ::write(fd, data, n);
+        if (w < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ThrowErrno(what);
+        }
+        data += w;
+        n -= static_cast<size_t>(w);
+    }
+}
+
+void SyncDir(const std::string &dir) {
+    const int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        ThrowErrno("open " + dir);
+    }
+    if (::fsync(fd) != 0) {
+        const int err = errno;
+        ::close(fd);
+        errno = err;
+        ThrowErrno("fsync " + dir);
+    }
+    ::close(fd);
+}
+
+// Read-only private mapping of a whole file.
+class MappedFile {
+  public:
+    explicit MappedFile(const std::string &path) {
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            ThrowErrno("open " + path);
+        }
+        struct stat st {};
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            ThrowErrno("stat " + path);
+        }
+        size = static_cast<size_t>(st.st_size);
+        if (size > 0) {
+            void *p = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                ::close(fd);
+                ThrowErrno("mmap " + path);
+            }
+            ::madvise(p, size, MADV_SEQUENTIAL);
+            data = static_cast<const uint8_t *>(p);
+        }
+        ::close(fd);
+    }
+    ~MappedFile() {
+        if (data) {
+            ::munmap(const_cast<uint8_t *>(data), size);
+        }
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const uint8_t *data{nullptr};
+    size_t size{0};
+};
+
+std::string SnapshotPath(const std::string &dir) {
+    return (fs::path(dir) / "snapshot.bin").string();
+}
+
+// Journal segments in `dir` as (first seq, path), oldest first.
+std::vector<std::pair<uint64_t, std::string>>
+ListSegments(const std::string &dir) {
+    std::vector<std::pair<uint64_t, std::string>> segments;
+    for (const auto &entry : fs::directory_iterator(dir)) {
+        const std::string name = entry.path().filename().string();
+        uint64_t first = 0;
+        char tail = 0;
+        if (std::sscanf(name.c_str(), "journal-%20" SCNu64 ".lo%c", &first,
+                        &tail) == 2 &&
+            tail == 'g') {
+            segments.emplace_back(first, entry.path().string());
+        }
+    }
+    std::sort(segments.begin(), segments.end());
+    return segments;
+}
+
+} // namespace
+
+JournalRecord JournalRecord::New(uint64_t seq, const Order &o) {
+    return JournalRecord{Kind::NEW,      o.Side(),      o.Type(),
+                         o.Trader(),     seq,           o.OrderId(),
+                         o.Timestamp(),  o.Price(),     o.QtyRemaining(),
+                         o.StopPrice(),  o.DisplayQty(), o.ShownQty()};
+}
+
+JournalRecord JournalRecord::Cancel(uint64_t seq, uint64_t order_id) {
+    return JournalRecord{Kind::CANCEL, SIDE::BUY, TYPE::LIMIT_ORDER, 0, seq,
+                         order_id,     0,         0.0,               0};
+}
+
+JournalRecord JournalRecord::Modify(uint64_t seq, uint64_t order_id,
+                                    double new_price, uint32_t new_qty) {
+    return JournalRecord{Kind::MODIFY, SIDE::BUY, TYPE::LIMIT_ORDER,
+                         0,            seq,       order_id,
+                         0,            new_price, new_qty};
+}
+
+Order JournalRecord::ToOrder() const {
+    Order o(order_id, timestamp, trader, side, price, qty, type);
+    o.StopPrice(stop_price);
+    o.DisplayQty(display_qty);
+    o.ShownQty(shown_qty);
+    return o;
+}
+
+void EncodeJournalRecord(const JournalRecord &r, uint8_t *out) {
+    out[0] = static_cast<uint8_t>(r.kind);
+    out[1] = static_cast<uint8_t>(r.side);
+    out[2] = static_cast<uint8_t>(r.type);
+    out[3] = 0;
+    PutU32(out + 4, r.trader);
+    PutU64(out + 8, r.seq);
+    PutU64(out + 16, r.order_id);
+    PutU64(out + 24, static_cast<uint64_t>(r.timestamp));
+    PutU64(out + 32, std::bit_cast<uint64_t>(r.price));
+    PutU32(out + 40, r.qty);
+    PutU32(out + 44, r.display_qty);
+    PutU32(out + 48, r.shown_qty);
+    PutU64(out + 52, std::bit_cast<uint64_t>(r.stop_price));
+    PutU32(out + kChecksumOffset, Checksum(out, kChecksumOffset));
+}
+
+bool DecodeJournalRecord(const uint8_t *in, JournalRecord &r) {
+    if (GetU32(in + kChecksumOffset) != Checksum(in, kChecksumOffset) ||
+        in[0] < static_cast<uint8_t>(JournalRecord::Kind::NEW) ||
+        in[0] > static_cast<uint8_t>(JournalRecord::Kind::MODIFY) ||
+        in[1] > static_cast<uint8_t>(SIDE::SELL) ||
+        in[2] > static_cast<uint8_t>(TYPE::STOP_LIMIT_ORDER)) {
+        return false;
+    }
+    r.kind = static_cast<JournalRecord::Kind>(in[0]);
+    r.side = static_cast<SIDE>(in[1]);
+    r.type = static_cast<TYPE>(in[2]);
+    r.trader = GetU32(in + 4);
+    r.seq = GetU64(in + 8);
+    r.order_id = GetU64(in + 16);
+    r.timestamp = static_cast<int64_t>(GetU64(in + 24));
+    r.price = std::bit_cast<double>(GetU64(in + 32));
+    r.qty = GetU32(in + 40);
+    r.display_qty = GetU32(in + 44);
+    r.shown_qty = GetU32(in + 48);
+    r.stop_price = std::bit_cast<double>(GetU64(in + 52));
+    return true;
+}
+
+JournalWriter::JournalWriter(const std::string &path, uint32_t _group_commit,
+                             bool _sync)
+    : group_commit{std::max<uint32_t>(_group_commit, 1)}, sync{_sync} {
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        ThrowErrno("open " + path);
+    }
+    if (sync) {
+        // fdatasync covers the records, not the new segment's name.
+        const fs::path parent = fs::path(path).parent_path();
+        try {
+            SyncDir(parent.empty() ? "." : parent.string());
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
+    }
+    buffer.reserve(static_cast<size_t>(group_commit) * kJournalRecordSize);
+}
+
+JournalWriter::~JournalWriter() {
+    try {
+        Flush();
+    } catch (const std::exception &) {
+        // Destructors must not throw; the unflushed tail is lost exactly as
+        // it would be in a crash.
+    }
+    ::close(fd);
+}
+
+void JournalWriter::Append(const JournalRecord &r) {
+    const size_t at = buffer.size();
+    buffer.resize(at + kJournalRecordSize);
+    EncodeJournalRecord(r, buffer.data() + at);
+    if (++pending >= group_commit) {
+        Flush();
+    }
+}
+
+void JournalWriter::Flush() {
+    if (buffer.empty()) {
+        return;
+    }
+    WriteAll(fd, buffer.data(), buffer.size(), "journal write");
+    if (sync && ::fdatasync(fd) != 0) {
+        ThrowErrno("journal fdatasync");
+    }
+    buffer.clear();
+    pending = 0;
+}
+
+SnapshotWriter::SnapshotWriter(const std::string &_dir, uint64_t _seq,
+                               uint64_t _max_order_id)
+    : dir{_dir}, tmp_path{SnapshotPath(_dir) + ".tmp"}, seq{_seq},
+      max_order_id{_max_order_id} {
+    fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                0644);
+    if (fd < 0) {
+        ThrowErrno("open " + tmp_path);
+    }
+    // Header is rewritten with the final count by Commit().
+    buffer.resize(kSnapshotHeaderSize);
+    buffer.reserve(kSnapshotHeaderSize +
+                   kSnapshotBufferRecords * kJournalRecordSize);
+}
+
+SnapshotWriter::~SnapshotWriter() {
+    if (fd >= 0) {
+        ::close(fd);
+        ::unlink(tmp_path.c_str());
+    }
+}
+
+void SnapshotWriter::Add(const Order &o) {
+    const size_t at = buffer.size();
+    buffer.resize(at + kJournalRecordSize);
+    EncodeJournalRecord(JournalRecord::New(seq, o), buffer.data() + at);
+    ++count;
+    if (buffer.size() >= kSnapshotBufferRecords * kJournalRecordSize) {
+        WriteBuffer();
+    }
+}
+
+void SnapshotWriter::WriteBuffer() {
+    WriteAll(fd, buffer.data(), buffer.size(), "snapshot write");
+    buffer.clear();
+}
+
+void SnapshotWriter::Commit() {
+    WriteBuffer();
+
+    uint8_t header[kSnapshotHeaderSize];
+    std::memcpy(header, kSnapshotMagic, sizeof(kSnapshotMagic));
+    PutU32(header + 8, kSnapshotVersion);
+    PutU32(header + 12, static_cast<uint32_t>(kJournalRecordSize));
+    PutU64(header + 16, seq);
+    PutU64(header + 24, count);
+    PutU64(header + 32, max_order_id);
+    if (::pwrite(fd, header, sizeof(header), 0) !=
+        static_cast<ssize_t>(sizeof(header))) {
+        ThrowErrno("snapshot header write");
+    }
+    if (::fsync(fd) != 0) {
+        ThrowErrno("snapshot fsync");
+    }
+    ::close(fd);
+    fd = -1;
+
+    if (::rename(tmp_path.c_str(), SnapshotPath(dir).c_str()) != 0) {
+        ThrowErrno("rename " + tmp_path);
+    }
+    SyncDir(dir);
+}
+
+std::string JournalSegmentPath(const std::string &dir, uint64_t first_seq) {
+    char name[48];
+    std::snprintf(name, sizeof(name), "journal-%020" PRIu64 ".log", first_seq);
+    return (fs::path(dir) / name).string();
+}
+
+void RemoveJournalSegmentsThrough(const std::string &dir, uint64_t seq) {
+    const auto segments = ListSegments(dir);
+    // A segment ends where the next one starts, so it is covered once its
+    // successor starts at or before seq + 1.
+    for (size_t i = 0; i + 1 < segments.size(); ++i) {
+        if (segments[i + 1].first <= seq + 1) {
+            fs::remove(segments[i].second);
+        }
+    }
+}
+
+RecoveryStats RecoverJournal(
+    const std::string &dir,
+    const std::function<void(const JournalRecord &)> &apply) {
+    fs::create_directories(dir);
+    RecoveryStats stats;
+    JournalRecord r{};
+
+    const std::string snapshot_path = SnapshotPath(dir);
+    if (fs::exists(snapshot_path)) {
+        MappedFile snap(snapshot_path);
+        if (snap.size < kSnapshotHeaderSize ||
+            std::memcmp(snap.data, kSnapshotMagic, sizeof(kSnapshotMagic)) !=
+                0 ||
+            GetU32(snap.data + 8) != kSnapshotVersion ||
+            GetU32(snap.data + 12) != kJournalRecordSize) {
+            throw std::runtime_error("Invalid snapshot header: " +
+                                     snapshot_path);
+        }
+        stats.snapshot_seq = GetU64(snap.data + 16);
+        const uint64_t count = GetU64(snap.data + 24);
+        stats.max_order_id = GetU64(snap.data + 32);
+        if (snap.size != kSnapshotHeaderSize + count * kJournalRecordSize) {
+            throw std::runtime_error("Truncated snapshot: " + snapshot_path);
+        }
+        const uint8_t *p = snap.data + kSnapshotHeaderSize;
+        for (uint64_t i = 0; i < count; ++i, p += kJournalRecordSize) {
+            if (!DecodeJournalRecord(p, r)) {
+                throw std::runtime_error("Corrupt snapshot record in " +
+                                         snapshot_path);
+            }
+            stats.max_order_id = std::max(stats.max_order_id, r.order_id);
+            apply(r);
+        }
+        stats.snapshot_orders = count;
+    }
+    stats.last_seq = stats.snapshot_seq;
+
+    const auto segments = ListSegments(dir);
+    for (size_t s = 0; s < segments.size(); ++s) {
+        const std::string &path = segments[s].second;
+        // Segments fully covered by the snapshot are never read.
+        if (s + 1 < segments.size() &&
+            segments[s + 1].first <= stats.snapshot_seq + 1) {
+            continue;
+        }
+        size_t valid = 0;
+        size_t size = 0;
+        {
+            MappedFile seg(path);
+            size = seg.size;
+            while (valid + kJournalRecordSize <= seg.size &&
+                   DecodeJournalRecord(seg.data + valid, r)) {
+                valid += kJournalRecordSize;
+                if (r.seq <= stats.last_seq) {
+                    continue;
+                }
+                stats.last_seq = r.seq;
+                if (r.kind == JournalRecord::Kind::NEW) {
+                    stats.max_order_id =
+                        std::max(stats.max_order_id, r.order_id);
+                }
+                apply(r);
+                ++stats.replayed;
+            }
+        }
+        if (valid < size) {
+            if (s + 1 < segments.size()) {
+                throw std::runtime_error("Corrupt journal segment: " + path);
+            }
+            // Only the last segment can end in a torn write.
+            fs::resize_file(path, valid);
+            stats.truncated_bytes = size - valid;
+        }
+    }
+    return stats;
+}
@@ -0,0 +1,236 @@
+#include "orderbook/MatchingEngine.h"
+
+#include <stdexcept>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+// Fibonacci hashing spreads consecutive symbol ids across workers.
+uint32_t HashSymbol(SymbolId symbol, uint32_t num_workers) {
+    const uint64_t h = static_cast<uint64_t>(symbol) * 0x9E3779B97F4A7C15ull;
+    return static_cast<uint32_t>((h >> 32) % num_workers);
+}
+
+void PinToCore(std::thread &t, uint32_t index) {
+#ifdef __linux__
+    const unsigned cores = std::thread::hardware_concurrency();
+    if (cores == 0) {
+        return;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(index % cores, &set);
+    pthread_setaffinity_np(t.native_handle(), sizeof(set), &set);
+#else
+    (void)t;
+    (void)index;
+#endif
+}
+
+inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+} // namespace
+
+MatchingEngine::MatchingEngine(uint32_t _num_workers,
+                               EngineListener *_listener,
+                               size_t queue_capacity, bool _pin_threads)
+    : listener{_listener}, pin_threads{_pin_threads} {
+    if (_num_workers == 0) {
+        throw std::invalid_argument("MatchingEngine needs at least 1 worker");
+    }
+    workers.reserve(_num_workers);
+    for (uint32_t i = 0; i < _num_workers; ++i) {
+        workers.push_back(std::make_unique<Worker>(queue_capacity));
+    }
+}
+
+MatchingEngine::~MatchingEngine() { Stop(); }
+
+void MatchingEngine::AddInstrument(SymbolId symbol, const InstrumentSpec &spec,
+                                   uint32_t max_orders) {
+    if (running) {
+        throw std::logic_error("Instruments must be added before Start()");
+    }
+    if (symbol_worker.count(symbol)) {
+        throw std::invalid_argument("Duplicate symbol: " +
+                                    std::to_string(symbol));
+    }
+    const uint32_t w = HashSymbol(symbol, NumWorkers());
+    symbol_worker[symbol] = w;
+    workers[w]->books[symbol] =
+        std::make_unique<TickOrderBook>(spec, max_orders);
+}
+
+void MatchingEngine::Start() {
+    if (running) {
+        return;
+    }
+    stopping.store(false, std::memory_order_relaxed);
+    running = true;
+    for (uint32_t i = 0; i < NumWorkers(); ++i) {
+        workers[i]->thread = std::thread([this, i] { RunWorker(i); });
+        if (pin_threads) {
+            PinToCore(workers[i]->thread, i);
+        }
+    }
+}
+
+void MatchingEngine::Stop() {
+    if (!running) {
+        return;
+    }
+    stopping.store(true, std::memory_order_release);
+    for (auto &w : workers) {
+        w->thread.join();
+    }
+    running = false;
+}
+
+uint32_t MatchingEngine::WorkerOf(SymbolId symbol) const {
+    auto it = symbol_worker.find(symbol);
+    if (it == symbol_worker.end()) {
+        throw std::out_of_range("Unknown symbol: " + std::to_string(symbol));
+    }
+    return it->second;
+}
+
+bool MatchingEngine::Submit(SymbolId symbol, const Order &o) {
+    auto it = symbol_worker.find(symbol);
+    if (it == symbol_worker.end()) {
+        return false;
+    }
+    Enqueue(it->second,
+            Command{EngineOp::NEW, o.Side(), o.Type(), symbol, o.Trader(),
+                    o.Qty(), o.OrderId(), o.Timestamp(), o.Price()});
+    return true;
+}
+
+bool MatchingEngine::Cancel(SymbolId symbol, uint64_t order_id) {
+    auto it = symbol_worker.find(symbol);
+    if (it == symbol_worker.end()) {
+        return false;
+    }
+    Enqueue(it->second, Command{EngineOp::CANCEL, SIDE::BUY,
+                                TYPE::LIMIT_ORDER, symbol, 0, 0, order_id,
+                                0, 0.0});
+    return true;
+}
+
+bool MatchingEngine::Modify(SymbolId symbol, uint64_t order_id,
+                            double new_price, uint32_t new_qty) {
+    auto it = symbol_worker.find(symbol);
+    if (it == symbol_worker.end()) {
+        return false;
+    }
+    Enqueue(it->second, Command{EngineOp::MODIFY, SIDE::BUY,
+                                TYPE::LIMIT_ORDER, symbol, 0, new_qty,
+                                order_id, 0, new_price});
+    return true;
+}
+
+void MatchingEngine::Enqueue(uint32_t worker, const Command &cmd) {
+    auto &q = workers[worker]->queue;
+    while (!q.TryPush(cmd)) {
+        if (backoff) {
+            backoff();
+        } else {
+            CpuRelax();
+        }
+    }
+}
+
+void MatchingEngine::RunWorker(uint32_t index) {
+    Worker &w = *workers[index];
+
+    SymbolId current_symbol = 0;
+    uint64_t fills = 0;
+    CallbackSink sink([&](const Fill &f) {
+        ++fills;
+        if (listener) {
+            listener->OnFill(current_symbol, f);
+        }
+    });
+
+    Command cmd;
+    uint64_t messages = 0;
+    while (true) {
+        if (!w.queue.TryPop(cmd)) {
+            // Publish progress while idle so readers see it without a store
+            // on every message.
+            w.messages.store(messages, std::memory_order_relaxed);
+            w.fills.store(fills, std::memory_order_relaxed);
+            if (stopping.load(std::memory_order_acquire)) {
+                // The producer is done; one final pop closes the race with a
+                // push that landed just before the stop flag.
+                if (!w.queue.TryPop(cmd)) {
+                    break;
+                }
+            } else {
+                CpuRelax();
+                continue;
+            }
+        }
+
+        ++messages;
+        TickOrderBook &book = *w.books.at(cmd.symbol);
+        current_symbol = cmd.symbol;
+        bool ok = true;
+        if (cmd.kind == EngineOp::NEW) {
+            try {
+                book.ProcessOrder(Order(cmd.order_id, cmd.timestamp,
+                                        cmd.trader, cmd.side, cmd.price,
+                                        cmd.qty, cmd.type),
+                                  sink);
+            } catch (const std::exception &) {
+                ok = false;
+                if (listener) {
+                    listener->OnReject(cmd.symbol, cmd.order_id);
+                }
+            }
+        } else if (cmd.kind == EngineOp::MODIFY) {
+            try {
+                ok = book.ModifyOrder(cmd.order_id, cmd.price, cmd.qty, sink);
+            } catch (const std::exception &) {
+                ok = false;
+                if (listener) {
+                    listener->OnReject(cmd.symbol, cmd.order_id);
+                }
+            }
+        } else {
+            ok = book.CancelOrder(cmd.order_id);
+        }
+        if (listener) {
+            listener->OnProcessed(cmd.symbol, cmd.order_id, cmd.kind, ok,
+                                  book.OpenQty(cmd.order_id));
+        }
+    }
+
+    w.messages.store(messages, std::memory_order_relaxed);
+    w.fills.store(fills, std::memory_order_relaxed);
+}
+
+uint64_t MatchingEngine::MessagesProcessed() const {
+    uint64_t total = 0;
+    for (const auto &w : workers) {
+        total += w->messages.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+uint64_t MatchingEngine::FillsEmitted() const {
+    uint64_t total = 0;
+    for (const auto &w : workers) {
+        total += w->fills.load(std::memory_order_relaxed);
+    }
+    return total;
+}
@@ -1,152 +1,517 @@
 #include "orderbook/OrderBook.h"
+#include "orderbook/SideTraits.h"
 
 #include <algorithm>
 #include <iostream>
+#include <limits>
+
+OrderBook::OrderBook(const OrderBook &other)
+    : depth_sink{other.depth_sink}, stp{other.stp}, options{other.options},
+      locators{other.locators}, stops{other.stops}, triggered{other.triggered},
+      traded_low{other.traded_low}, traded_high{other.traded_high},
+      stats{other.stats}, dead_orders{other.dead_orders} {
+    // The locators were copied as they are; re-point each live order's at
+    // its new queue entry and level. Dead orders have no locator.
+    auto copy_side = [this](const auto &from, auto &to) {
+        for (const auto &[price, level] : from) {
+            PriceLevel &copy = to.emplace_hint(to.end(), price, PriceLevel{})
+                                   ->second;
+            copy.qty = level.qty;
+            copy.hidden = level.hidden;
+            copy.live = level.live;
+            copy.traders = level.traders;
+            for (const OrderPtr &o : level.orders) {
+                const auto it = copy.orders.insert(
+                    copy.orders.end(), std::make_shared<Order>(*o));
+                if (o->QtyRemaining() == 0) {
+                    continue;
+                }
+                OrderLocator *loc = locators.Find(o->OrderId());
+                loc->it = it;
+                loc->level = &copy;
+            }
+        }
+    };
+    copy_side(other.buy_book, buy_book);
+    copy_side(other.sell_book, sell_book);
+}
 
-TradeVector OrderBook::ProcessOrder(const Order &_incoming) {
-    OrderPtr incoming = std::make_shared<Order>(_incoming);
+OrderBook &OrderBook::operator=(const OrderBook &other) {
+    if (this != &other) {
+        *this = OrderBook(other);
+    }
+    return *this;
+}
+
+void OrderBook::ProcessOrder(const Order &_incoming, FillSink &sink) {
+    const auto timer = stats.TimeProcess();
+    stats.CountOrder();
+    if (StopBook::IsStop(_incoming)) {
+        stops.Add(_incoming);
+        return;
+    }
+    Execute(_incoming, sink);
+    FireStops(sink);
+}
 
-    if (incoming->Side() == SIDE::BUY) {
-        return MatchBuy(incoming);
+void OrderBook::Execute(Order incoming, FillSink &sink) {
+    if (incoming.Side() == SIDE::BUY) {
+        if (incoming.Type() == TYPE::FOK_ORDER &&
+            !CanFill<SIDE::BUY>(incoming)) {
+            return;
+        }
+        Match<SIDE::BUY>(incoming, sink);
     } else {
-        return MatchSell(incoming);
+        if (incoming.Type() == TYPE::FOK_ORDER &&
+            !CanFill<SIDE::SELL>(incoming)) {
+            return;
+        }
+        Match<SIDE::SELL>(incoming, sink);
     }
 }
 
-TradeVector OrderBook::MatchBuy(OrderPtr incoming) {
-    TradeVector trade_vector;
+void OrderBook::FireStops(FillSink &sink) {
+    while (traded_low <= traded_high) {
+        const double low = traded_low;
+        const double high = traded_high;
+        traded_low = std::numeric_limits<double>::infinity();
+        traded_high = -std::numeric_limits<double>::infinity();
+        if (stops.Empty()) {
+            return;
+        }
+        // Activated stops trade in turn and may widen the range again.
+        triggered.clear();
+        stops.Trigger(low, high, triggered);
+        for (const Order &o : triggered) {
+            Execute(o, sink);
+        }
+    }
+}
 
-    while (!sell_book.empty() && incoming->QtyRemaining() > 0) {
-        auto best_sell_it = sell_book.begin();
-        double best_sell_price = best_sell_it->first;
+void OrderBook::ProcessBatch(std::span<const Order> orders, FillSink &sink) {
+    // Nothing here is worth resolving ahead of time (std::map caches
+    // begin()), so this is a plain loop kept for API parity.
+    for (const Order &o : orders) {
+        ProcessOrder(o, sink);
+    }
+}
 
-        if (best_sell_price > incoming->Price()) {
+template <SIDE S> void OrderBook::Match(Order &incoming, FillSink &sink) {
+    using Traits = SideTraits<S>;
+    constexpr SIDE kOther = Traits::kOpposite;
+    auto &other_book = Book<kOther>();
+    const bool has_limit = incoming.Type() != TYPE::MARKET_ORDER;
+    const bool prevent_self = stp != STP::NONE;
+    uint64_t levels_swept = 0;
+
+    while (!other_book.empty() && incoming.QtyRemaining() > 0) {
+        auto best_it = other_book.begin();
+        const double best_price = best_it->first;
+        auto &level = best_it->second;
+        auto &queue = level.orders;
+
+        if (has_limit && !Traits::Crosses(best_price, incoming.Price())) {
             break;
         }
 
-        auto &sell_queue = best_sell_it->second;
-        OrderPtr resting = sell_queue.front();
+        DropDeadFront(level);
+        Order &resting = *queue.front();
 
         uint32_t match_qty =
-            std::min(incoming->QtyRemaining(), resting->QtyRemaining());
+            std::min(incoming.QtyRemaining(), resting.QtyRemaining());
+
+        if (prevent_self && resting.Trader() == incoming.Trader())
+            [[unlikely]] {
+            stats.CountSelfTrade();
+            if (stp == STP::CANCEL_NEWEST) {
+                incoming.QtyRemaining(0);
+                break;
+            }
+            if (stp == STP::CANCEL_OLDEST) {
+                // Empty the resting order, reserve included, so it leaves
+                // below the way a filled one does.
+                OrderLocator &loc = *locators.Find(resting.OrderId());
+                level.hidden -= loc.hidden;
+                loc.hidden = 0;
+                level.qty -= resting.QtyRemaining();
+                resting.QtyRemaining(0);
+                match_qty = 0;
+            }
+        } else {
+            sink.OnFill(Traits::MakeFill(incoming, resting, match_qty));
+            stats.CountFill();
+            traded_low = std::min(traded_low, best_price);
+            traded_high = std::max(traded_high, best_price);
+        }
 
-        trade_vector.push_back(std::make_shared<Trade>(
-            incoming->Timestamp(), incoming->Trader(), resting->Trader(),
-            resting->Price(), match_qty));
+        incoming.QtyRemaining(incoming.QtyRemaining() - match_qty);
+        resting.QtyRemaining(resting.QtyRemaining() - match_qty);
 
-        incoming->QtyRemaining(incoming->QtyRemaining() - match_qty);
-        resting->QtyRemaining(resting->QtyRemaining() - match_qty);
+        level.qty -= match_qty;
 
-        if (resting->QtyRemaining() == 0) {
-            locators.erase(resting->OrderId());
-            sell_queue.pop_front();
-            if (sell_queue.empty()) {
-                sell_book.erase(best_sell_it);
+        if (resting.QtyRemaining() == 0) {
+            if (resting.DisplayQty() != 0 && Replenish(level)) {
+                PublishLevel(kOther, best_price, &level);
+                continue;
+            }
+            locators.Erase(resting.OrderId());
+            queue.pop_front();
+            if (--level.live == 0) {
+                dead_orders -= queue.size();
+                other_book.erase(best_it);
+                DropDeadLevels<kOther>();
+                PublishLevel(kOther, best_price, nullptr);
+                ++levels_swept;
+                continue;
             }
         }
+        PublishLevel(kOther, best_price, &level);
     }
+    stats.CountSweep(levels_swept);
 
-    if (incoming->QtyRemaining() > 0) {
-        AddToBuyBook(incoming);
+    if (incoming.QtyRemaining() > 0 && incoming.Type() == TYPE::LIMIT_ORDER) {
+        AddToBook<S>(incoming);
     }
+}
 
+TradeVector OrderBook::ProcessOrder(const Order &_incoming) {
+    TradeVector trade_vector;
+    CallbackSink to_trades([&](const Fill &f) {
+        trade_vector.push_back(std::make_shared<Trade>(
+            f.timestamp, f.buyer, f.seller, f.price, f.qty));
+    });
+    ProcessOrder(_incoming, to_trades);
     return trade_vector;
 }
 
-TradeVector OrderBook::MatchSell(OrderPtr incoming) {
-    TradeVector trade_vector;
+bool OrderBook::Replenish(PriceLevel &level) {
+    auto &q = level.orders;
+    Order &o = *q.front();
+    OrderLocator &loc = *locators.Find(o.OrderId());
+    if (loc.hidden == 0) {
+        return false;
+    }
+    const uint32_t slice = std::min(o.DisplayQty(), loc.hidden);
+    loc.hidden -= slice;
+    level.hidden -= slice;
+    o.QtyRemaining(slice);
+    level.qty += slice;
+    // Relinks the node; loc.it stays valid and nothing is allocated.
+    q.splice(q.end(), q, q.begin());
+    return true;
+}
 
-    while (!buy_book.empty() && incoming->QtyRemaining() > 0) {
-        auto best_buy_it = buy_book.begin();
-        double best_buy_price = best_buy_it->first;
+template <SIDE S> void OrderBook::AddToBook(const Order &_o) {
+    OrderPtr o = std::make_shared<Order>(_o);
+    const uint32_t shown = o->RestingShownQty();
+    const uint32_t hidden = o->QtyRemaining() - shown;
+    o->QtyRemaining(shown);
+    o->ShownQty(0);
 
-        if (best_buy_price < incoming->Price()) {
-            break;
-        }
+    auto &level = Book<S>()[o->Price()];
+    auto &q = level.orders;
+    q.push_back(o);
+    level.qty += shown;
+    level.hidden += hidden;
+    ++level.live;
+    level.traders |= PriceLevel::TraderBit(o->Trader());
+    stats.CountQueueLength(level.live);
+    PublishLevel(S, o->Price(), &level);
 
-        auto &buy_queue = best_buy_it->second;
-        OrderPtr resting = buy_queue.front();
+    auto it = std::prev(q.end());
+    locators.Assign(o->OrderId(),
+                    OrderLocator{S, o->Price(), it, &level, hidden});
+}
 
-        uint32_t match_qty =
-            std::min(incoming->QtyRemaining(), resting->QtyRemaining());
+template <SIDE S> bool OrderBook::RemoveFromBook(const OrderLocator &loc) {
+    auto &book = Book<S>();
+    auto lvl = book.find(loc.price);
+    if (lvl == book.end()) {
+        stats.CountCancelLevelMiss();
+        return false;
+    }
 
-        trade_vector.push_back(std::make_shared<Trade>(
-            incoming->Timestamp(), resting->Trader(), incoming->Trader(),
-            resting->Price(), match_qty));
+    auto &q = lvl->second.orders;
+    lvl->second.qty -= (*loc.it)->QtyRemaining();
+    lvl->second.hidden -= loc.hidden;
+    --lvl->second.live;
+    q.erase(loc.it);
 
-        incoming->QtyRemaining(incoming->QtyRemaining() - match_qty);
-        resting->QtyRemaining(resting->QtyRemaining() - match_qty);
+    if (q.empty()) {
+        book.erase(lvl);
+        PublishLevel(S, loc.price, nullptr);
+    } else {
+        PublishLevel(S, loc.price, &lvl->second);
+    }
+    return true;
+}
 
-        if (resting->QtyRemaining() == 0) {
-            locators.erase(resting->OrderId());
-            buy_queue.pop_front();
-            if (buy_queue.empty()) {
-                buy_book.erase(best_buy_it);
+bool OrderBook::CancelOrder(uint64_t order_id) {
+    const auto timer = stats.TimeCancel();
+    const OrderLocator *found = locators.Find(order_id);
+    if (!found) {
+        const bool stop = stops.Cancel(order_id);
+        stats.CountCancel(stop);
+        return stop;
+    }
+    stats.CountCancel(true);
+
+    const OrderLocator loc = *found;
+    locators.Erase(order_id);
+
+    if (options.lazy_cancel) {
+        PriceLevel &level = *loc.level;
+        Order &o = **loc.it;
+        level.qty -= o.QtyRemaining();
+        level.hidden -= loc.hidden;
+        o.QtyRemaining(0);
+        --level.live;
+        ++dead_orders;
+        PublishLevel(loc.side, loc.price, level.live ? &level : nullptr);
+        if (level.live == 0) {
+            if (loc.side == SIDE::BUY) {
+                DropDeadLevels<SIDE::BUY>();
+            } else {
+                DropDeadLevels<SIDE::SELL>();
             }
         }
+        // Waiting until the dead also outnumber the live keeps the sweep
+        // over the whole book amortised O(1) per cancel.
+        if (dead_orders >= options.compact_threshold &&
+            dead_orders >= locators.Size()) {
+            Compact();
+        }
+        return true;
     }
+    return loc.side == SIDE::BUY ? RemoveFromBook<SIDE::BUY>(loc)
+                                 : RemoveFromBook<SIDE::SELL>(loc);
+}
 
-    if (incoming->QtyRemaining() > 0) {
-        AddToSellBook(incoming);
+bool OrderBook::ModifyOrder(uint64_t order_id, double new_price,
+                            uint32_t new_qty, FillSink &sink) {
+    stats.CountModify();
+    if (new_qty == 0) {
+        return CancelOrder(order_id);
     }
 
-    return trade_vector;
-}
+    OrderLocator *found = locators.Find(order_id);
+    if (!found) {
+        return false;
+    }
 
-void OrderBook::AddToSellBook(OrderPtr o) {
-    auto &q = sell_book[o->Price()];
-    q.push_back(o);
+    OrderPtr o = *found->it;
+    if (new_price == found->price &&
+        new_qty <= o->QtyRemaining() + found->hidden) {
+        // Shrink the hidden reserve first, then the shown slice.
+        PriceLevel &level = *found->level;
+        const uint32_t shown = std::min(new_qty, o->QtyRemaining());
+        level.hidden -= found->hidden - (new_qty - shown);
+        found->hidden = new_qty - shown;
+        level.qty -= o->QtyRemaining() - shown;
+        o->QtyRemaining(shown);
+        PublishLevel(o->Side(), found->price, &level);
+        return true;
+    }
 
-    auto it = std::prev(q.end());
-    locators[o->OrderId()] = OrderLocator{SIDE::SELL, o->Price(), it};
+    Order amended = *o;
+    CancelOrder(order_id);
+    amended.Price(new_price);
+    amended.QtyRemaining(new_qty);
+
+    Execute(amended, sink);
+    FireStops(sink);
+    return true;
 }
 
-void OrderBook::AddToBuyBook(OrderPtr o) {
-    auto &q = buy_book[o->Price()];
-    q.push_back(o);
+void OrderBook::DropDeadFront(PriceLevel &level) {
+    auto &q = level.orders;
+    while (q.front()->QtyRemaining() == 0) {
+        q.pop_front();
+        --dead_orders;
+    }
+}
 
-    auto it = std::prev(q.end());
-    locators[o->OrderId()] = OrderLocator{SIDE::BUY, o->Price(), it};
+void OrderBook::CompactLevel(PriceLevel &level) {
+    dead_orders -= level.orders.remove_if(
+        [](const OrderPtr &o) { return o->QtyRemaining() == 0; });
 }
 
-bool OrderBook::CancelOrder(uint64_t order_id) {
-    auto loc_it = locators.find(order_id);
-    if (loc_it == locators.end()) {
-        return false;
+template <SIDE S> void OrderBook::CompactSide() {
+    auto &book = Book<S>();
+    for (auto it = book.begin(); it != book.end();) {
+        PriceLevel &level = it->second;
+        if (level.live == 0) {
+            dead_orders -= level.orders.size();
+            it = book.erase(it);
+            continue;
+        }
+        if (level.orders.size() != level.live) {
+            CompactLevel(level);
+        }
+        ++it;
+    }
+}
+
+template <SIDE S> void OrderBook::DropDeadLevels() {
+    auto &book = Book<S>();
+    while (!book.empty() && book.begin()->second.live == 0) {
+        dead_orders -= book.begin()->second.orders.size();
+        book.erase(book.begin());
     }
+}
 
-    const OrderLocator loc = loc_it->second;
+void OrderBook::Compact() {
+    if (dead_orders == 0) {
+        return;
+    }
+    CompactSide<SIDE::BUY>();
+    CompactSide<SIDE::SELL>();
+}
 
-    if (loc.side == SIDE::BUY) {
-        auto lvl = buy_book.find(loc.price);
-        if (lvl == buy_book.end()) {
-            locators.erase(loc_it);
-            return false;
+template <SIDE S> bool OrderBook::CanFill(const Order &o) const {
+    // DECREMENT_BOTH takes own quantity off the order as if it traded, so
+    // like NONE it only needs the aggregates.
+    const bool by_order =
+        stp == STP::CANCEL_NEWEST || stp == STP::CANCEL_OLDEST;
+    const uint32_t own_bit = PriceLevel::TraderBit(o.Trader());
+    uint64_t available = 0;
+    for (const auto &[price, level] : Book<SideTraits<S>::kOpposite>()) {
+        if (!SideTraits<S>::Crosses(price, o.Price())) {
+            break;
         }
+        if (!by_order || (level.traders & own_bit) == 0) {
+            available += level.qty + level.hidden;
+        } else if (stp == STP::CANCEL_NEWEST) {
+            // Matching stops at the first own order. Reserves refill
+            // behind it, so only the slices shown ahead of it count. Dead
+            // orders under lazy cancel have nothing left.
+            for (const OrderPtr &resting : level.orders) {
+                if (resting->Trader() == o.Trader() &&
+                    resting->QtyRemaining() != 0) {
+                    return available >= o.QtyRemaining();
+                }
+                available += resting->QtyRemaining();
+            }
+        } else {
+            // Own orders are cancelled as they come up, reserves included.
+            uint64_t own = 0;
+            for (const OrderPtr &resting : level.orders) {
+                if (resting->Trader() == o.Trader() &&
+                    resting->QtyRemaining() != 0) {
+                    own += resting->QtyRemaining() +
+                           locators.Find(resting->OrderId())->hidden;
+                }
+            }
+            available += level.qty + level.hidden - own;
+        }
+        if (available >= o.QtyRemaining()) {
+            return true;
+        }
+    }
+    return false;
+}
 
-        auto &q = lvl->second;
-        q.erase(loc.it);
-        locators.erase(loc_it);
+void OrderBook::PublishLevel(SIDE side, double price, const PriceLevel *level) {
+    if (!depth_sink) {
+        return;
+    }
+    if (level) {
+        depth_sink->OnLevelUpdate(
+            LevelUpdate{side, price, level->qty, level->live});
+    } else {
+        depth_sink->OnLevelUpdate(LevelUpdate{side, price, 0, 0});
+    }
+}
 
-        if (q.empty())
-            buy_book.erase(lvl);
-        return true;
+namespace {
 
-    } else {
-        auto lvl = sell_book.find(loc.price);
-        if (lvl == sell_book.end()) {
-            locators.erase(loc_it);
-            return false;
+// Lazy cancel erases a level as soon as it is dead and on top, so the
+// first level is always live.
+template <typename Map>
+std::optional<DepthLevel> FirstLevel(const Map &book) {
+    if (book.empty()) {
+        return std::nullopt;
+    }
+    const auto &[price, level] = *book.begin();
+    return DepthLevel{price, level.qty, level.live};
+}
+
+} // namespace
+
+std::optional<DepthLevel> OrderBook::BestBid() const {
+    return FirstLevel(buy_book);
+}
+
+std::optional<DepthLevel> OrderBook::BestAsk() const {
+    return FirstLevel(sell_book);
+}
+
+void OrderBook::Depth(SIDE side, size_t levels,
+                      std::vector<DepthLevel> &out) const {
+    out.clear();
+    auto collect = [&](const auto &book) {
+        for (const auto &[price, level] : book) {
+            if (out.size() == levels) {
+                break;
+            }
+            if (level.live > 0) {
+                out.push_back(DepthLevel{price, level.qty, level.live});
+            }
         }
+    };
+    if (side == SIDE::BUY) {
+        collect(buy_book);
+    } else {
+        collect(sell_book);
+    }
+}
 
-        auto &q = lvl->second;
-        q.erase(loc.it);
-        locators.erase(loc_it);
+void OrderBook::ForEachResting(
+    const std::function<void(const Order &)> &visit) const {
+    auto visit_side = [&](const auto &book) {
+        for (const auto &[price, level] : book) {
+            for (const auto &o : level.orders) {
+                if (o->QtyRemaining() == 0) {
+                    continue;
+                }
+                if (o->DisplayQty() == 0) {
+                    visit(*o);
+                    continue;
+                }
+                Order whole = *o;
+                whole.QtyRemaining(o->QtyRemaining() +
+                                   locators.Find(o->OrderId())->hidden);
+                whole.ShownQty(o->QtyRemaining());
+                visit(whole);
+            }
+        }
+    };
+    visit_side(buy_book);
+    visit_side(sell_book);
+    stops.ForEach(visit);
+}
 
-        if (q.empty())
-            sell_book.erase(lvl);
-        return true;
+uint32_t OrderBook::OpenQty(uint64_t order_id) const {
+    if (const OrderLocator *loc = locators.Find(order_id)) {
+        return (*loc->it)->QtyRemaining() + loc->hidden;
     }
+    return stops.OpenQty(order_id);
+}
 
-    return false;
+BookStats OrderBook::Stats() const {
+    BookStats s = stats.Counters();
+    s.resting_orders = locators.Size();
+    auto live_levels = [this](const auto &book) -> uint64_t {
+        if (dead_orders == 0) {
+            return book.size();
+        }
+        return static_cast<uint64_t>(
+            std::count_if(book.begin(), book.end(), [](const auto &kv) {
+                return kv.second.live > 0;
+            }));
+    };
+    s.bid_levels = live_levels(buy_book);
+    s.ask_levels = live_levels(sell_book);
+    s.dead_orders = dead_orders;
+    return s;
 }
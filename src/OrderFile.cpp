@@ -0,0 +1,238 @@
+#include "orderbook/OrderFile.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char kOrderFileMagic[8] = {'O', 'B', 'O', 'R', 'D', 'E', 'R', 'S'};
+constexpr uint32_t kOrderFileVersion = 1;
+constexpr uint32_t kHasTimestamps = 1;
+// Records buffered by OrderFileWriter between writes.
+constexpr size_t kWriteBufferRecords = 8192;
+
+struct OrderFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t count;
+    int64_t price_scale;
+    // Byte offset of the trader table, right after the last record.
+    uint64_t trader_offset;
+    uint32_t trader_count;
+    uint32_t flags;
+    uint8_t reserved[16];
+};
+static_assert(sizeof(OrderFileHeader) == 64);
+static_assert(sizeof(OrderFileHeader) % alignof(OrderFileRecord) == 0);
+
+[[noreturn]] void ThrowErrno(const std::string &what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+void WriteAll(int fd, const void *data, size_t n, const std::string &what) {
+    const auto *p = static_cast<const uint8_t *>(data);
+    while (n > 0) {
+        const ssize_t w = ::write(fd, p, n);
+        if (w < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ThrowErrno(what);
+        }
+        p += w;
+        n -= static_cast<size_t>(w);
+    }
+}
+
+} // namespace
+
+OrderFileWriter::OrderFileWriter(const std::string &_path,
+                                 int64_t _price_scale, bool _has_timestamps)
+    : path{_path}, tmp_path{_path + ".tmp"}, price_scale{_price_scale},
+      has_timestamps{_has_timestamps} {
+    if (price_scale <= 0) {
+        throw std::invalid_argument("Order file price scale must be positive");
+    }
+    fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                0644);
+    if (fd < 0) {
+        ThrowErrno("open " + tmp_path);
+    }
+    // Header is written with the final counts by Commit().
+    const OrderFileHeader blank{};
+    WriteAll(fd, &blank, sizeof(blank), "order file write");
+    buffer.reserve(kWriteBufferRecords);
+}
+
+OrderFileWriter::~OrderFileWriter() {
+    if (fd >= 0) {
+        ::close(fd);
+        ::unlink(tmp_path.c_str());
+    }
+}
+
+void OrderFileWriter::Add(int64_t timestamp, TraderId trader, SIDE side,
+                          TYPE type, double price, uint32_t qty) {
+    const double scaled = std::round(price * static_cast<double>(price_scale));
+    if (!(std::abs(scaled) < 0x1p63) ||
+        static_cast<double>(static_cast<int64_t>(scaled)) /
+                static_cast<double>(price_scale) !=
+            price) {
+        throw std::invalid_argument(
+            "Price " + std::to_string(price) +
+            " is not exact at price scale " + std::to_string(price_scale));
+    }
+    OrderFileRecord r{};
+    r.timestamp = has_timestamps ? timestamp : 0;
+    r.price = static_cast<int64_t>(scaled);
+    r.qty = qty;
+    r.trader = trader;
+    r.side = side;
+    r.type = type;
+    buffer.push_back(r);
+    max_trader = std::max(max_trader, trader);
+    ++count;
+    if (buffer.size() == kWriteBufferRecords) {
+        WriteBuffer();
+    }
+}
+
+void OrderFileWriter::WriteBuffer() {
+    WriteAll(fd, buffer.data(), buffer.size() * sizeof(OrderFileRecord),
+             "order file write");
+    buffer.clear();
+}
+
+void OrderFileWriter::Commit(const TraderTable &traders) {
+    if (count > 0 && max_trader >= traders.Size()) {
+        throw std::invalid_argument("Order file trader id outside the table");
+    }
+    WriteBuffer();
+
+    std::vector<uint8_t> names;
+    for (TraderId id = 0; id < traders.Size(); ++id) {
+        const std::string &name = traders.Name(id);
+        const auto len = static_cast<uint32_t>(name.size());
+        const size_t at = names.size();
+        names.resize(at + sizeof(len) + name.size());
+        std::memcpy(names.data() + at, &len, sizeof(len));
+        std::memcpy(names.data() + at + sizeof(len), name.data(), name.size());
+    }
+    WriteAll(fd, names.data(), names.size(), "order file write");
+
+    OrderFileHeader header{};
+    std::memcpy(header.magic, kOrderFileMagic, sizeof(kOrderFileMagic));
+    header.version = kOrderFileVersion;
+    header.record_size = sizeof(OrderFileRecord);
+    header.count = count;
+    header.price_scale = price_scale;
+    header.trader_offset = sizeof(header) + count * sizeof(OrderFileRecord);
+    header.trader_count = static_cast<uint32_t>(traders.Size());
+    header.flags = has_timestamps ? kHasTimestamps : 0;
+    if (::pwrite(fd, &header, sizeof(header), 0) !=
+        static_cast<ssize_t>(sizeof(header))) {
+        ThrowErrno("order file header write");
+    }
+    if (::fsync(fd) != 0) {
+        ThrowErrno("order file fsync");
+    }
+    ::close(fd);
+    fd = -1;
+
+    if (::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        ThrowErrno("rename " + tmp_path);
+    }
+}
+
+bool OrderFile::Detect(const std::string &path) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    char magic[sizeof(kOrderFileMagic)];
+    const bool match = ::read(fd, magic, sizeof(magic)) ==
+                           static_cast<ssize_t>(sizeof(magic)) &&
+                       std::memcmp(magic, kOrderFileMagic, sizeof(magic)) == 0;
+    ::close(fd);
+    return match;
+}
+
+OrderFile::OrderFile(const std::string &path) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        ThrowErrno("open " + path);
+    }
+    struct stat st {};
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        ThrowErrno("stat " + path);
+    }
+    size = static_cast<size_t>(st.st_size);
+    if (size < sizeof(OrderFileHeader)) {
+        ::close(fd);
+        throw std::runtime_error("Not an order file: " + path);
+    }
+    void *p = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        ThrowErrno("mmap " + path);
+    }
+    ::madvise(p, size, MADV_SEQUENTIAL);
+    data = static_cast<const uint8_t *>(p);
+
+    try {
+        OrderFileHeader header;
+        std::memcpy(&header, data, sizeof(header));
+        if (std::memcmp(header.magic, kOrderFileMagic,
+                        sizeof(kOrderFileMagic)) != 0 ||
+            header.version != kOrderFileVersion ||
+            header.record_size != sizeof(OrderFileRecord) ||
+            header.price_scale <= 0) {
+            throw std::runtime_error("Unsupported order file: " + path);
+        }
+        const uint64_t max_count =
+            (size - sizeof(header)) / sizeof(OrderFileRecord);
+        if (header.count > max_count ||
+            header.trader_offset !=
+                sizeof(header) + header.count * sizeof(OrderFileRecord)) {
+            throw std::runtime_error("Truncated order file: " + path);
+        }
+        records = {reinterpret_cast<const OrderFileRecord *>(
+                       data + sizeof(header)),
+                   static_cast<size_t>(header.count)};
+        price_scale = header.price_scale;
+        has_timestamps = (header.flags & kHasTimestamps) != 0;
+
+        size_t at = header.trader_offset;
+        trader_names.reserve(header.trader_count);
+        for (uint32_t i = 0; i < header.trader_count; ++i) {
+            uint32_t len;
+            if (size - at < sizeof(len)) {
+                throw std::runtime_error("Truncated order file: " + path);
+            }
+            std::memcpy(&len, data + at, sizeof(len));
+            at += sizeof(len);
+            if (size - at < len) {
+                throw std::runtime_error("Truncated order file: " + path);
+            }
+            trader_names.emplace_back(
+                reinterpret_cast<const char *>(data + at), len);
+            at += len;
+        }
+    } catch (...) {
+        ::munmap(const_cast<uint8_t *>(data), size);
+        throw;
+    }
+}
+
+OrderFile::~OrderFile() { ::munmap(const_cast<uint8_t *>(data), size); }
@@ -0,0 +1,92 @@
+#include "orderbook/StopBook.h"
+
+namespace {
+
+// The order a stop turns into once it fires.
+Order Activate(Order o) {
+    o.Type(o.Type() == TYPE::STOP_ORDER ? TYPE::MARKET_ORDER
+                                        : TYPE::LIMIT_ORDER);
+    return o;
+}
+
+// Fires the leading levels of `stops` for which `fires(stop_price)` holds.
+template <typename Map, typename Ids, typename Fires>
+void Drain(Map &stops, Ids &ids, Fires fires, std::vector<Order> &out) {
+    auto it = stops.begin();
+    for (; it != stops.end() && fires(it->first); ++it) {
+        for (const Order &o : it->second) {
+            ids.Erase(o.OrderId());
+            out.push_back(Activate(o));
+        }
+    }
+    stops.erase(stops.begin(), it);
+}
+
+} // namespace
+
+StopBook::StopBook(const StopBook &other) {
+    other.ForEach([this](const Order &o) { Add(o); });
+}
+
+StopBook &StopBook::operator=(const StopBook &other) {
+    if (this != &other) {
+        *this = StopBook(other);
+    }
+    return *this;
+}
+
+void StopBook::Add(const Order &o) {
+    Queue::iterator it;
+    if (o.Side() == SIDE::BUY) {
+        auto &q = buy_stops[o.StopPrice()];
+        it = q.insert(q.end(), o);
+    } else {
+        auto &q = sell_stops[o.StopPrice()];
+        it = q.insert(q.end(), o);
+    }
+    ids.Assign(o.OrderId(), Locator{o.Side(), o.StopPrice(), it});
+}
+
+bool StopBook::Cancel(uint64_t order_id) {
+    if (Empty()) {
+        return false;
+    }
+    const Locator *found = ids.Find(order_id);
+    if (!found) {
+        return false;
+    }
+    const Locator loc = *found;
+    ids.Erase(order_id);
+
+    auto remove = [&](auto &stops) {
+        auto level = stops.find(loc.stop_price);
+        level->second.erase(loc.it);
+        if (level->second.empty()) {
+            stops.erase(level);
+        }
+    };
+    if (loc.side == SIDE::BUY) {
+        remove(buy_stops);
+    } else {
+        remove(sell_stops);
+    }
+    return true;
+}
+
+void StopBook::Trigger(double low, double high, std::vector<Order> &out) {
+    Drain(buy_stops, ids, [high](double stop) { return stop <= high; }, out);
+    Drain(sell_stops, ids, [low](double stop) { return stop >= low; }, out);
+}
+
+void StopBook::ForEach(const std::function<void(const Order &)> &visit) const {
+    for (const auto &[stop, q] : buy_stops) {
+        for (const Order &o : q) {
+            visit(o);
+        }
+    }
+    for (const auto &[stop, q] : sell_stops) {
+        for (const Order &o : q) {
+            visit(o);
+        }
+    }
+}
@@ -0,0 +1,560 @@
+#include "orderbook/TickOrderBook.h"
+#include "orderbook/SideTraits.h"
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+void SetBit(std::vector<uint64_t> &bits, uint32_t i) {
+    bits[i >> 6] |= uint64_t{1} << (i & 63);
+}
+
+void ClearBit(std::vector<uint64_t> &bits, uint32_t i) {
+    bits[i >> 6] &= ~(uint64_t{1} << (i & 63));
+}
+
+// Lowest set bit at index >= from, or UINT32_MAX.
+uint32_t NextSetBit(const std::vector<uint64_t> &bits, uint32_t from) {
+    size_t w = from >> 6;
+    if (w >= bits.size()) {
+        return UINT32_MAX;
+    }
+    uint64_t word = bits[w] & (~uint64_t{0} << (from & 63));
+    while (word == 0) {
+        if (++w == bits.size()) {
+            return UINT32_MAX;
+        }
+        word = bits[w];
+    }
+    return static_cast<uint32_t>(w * 64 + std::countr_zero(word));
+}
+
+// Highest set bit at index <= from, or UINT32_MAX.
+uint32_t PrevSetBit(const std::vector<uint64_t> &bits, uint32_t from) {
+    size_t w = from >> 6;
+    uint64_t word = bits[w] & (~uint64_t{0} >> (63 - (from & 63)));
+    while (word == 0) {
+        if (w == 0) {
+            return UINT32_MAX;
+        }
+        word = bits[--w];
+    }
+    return static_cast<uint32_t>(w * 64 + 63 - std::countl_zero(word));
+}
+
+// Best occupied tick at `from` or worse for a book on side S: bids worsen
+// downwards, asks upwards.
+template <SIDE S>
+uint32_t SeekFrom(const std::vector<uint64_t> &bits, uint32_t from) {
+    if constexpr (S == SIDE::BUY) {
+        return PrevSetBit(bits, from);
+    } else {
+        return NextSetBit(bits, from);
+    }
+}
+
+// Next occupied tick strictly worse than `tick` for a book on side S.
+template <SIDE S>
+uint32_t SeekAfter(const std::vector<uint64_t> &bits, uint32_t tick) {
+    if constexpr (S == SIDE::BUY) {
+        return tick == 0 ? UINT32_MAX : PrevSetBit(bits, tick - 1);
+    } else {
+        return NextSetBit(bits, tick + 1);
+    }
+}
+
+} // namespace
+
+TickOrderBook::TickOrderBook(const InstrumentSpec &_spec, uint32_t max_orders)
+    : spec{_spec}, pool{max_orders}, bids(_spec.NumTicks()),
+      asks(_spec.NumTicks()) {}
+
+uint32_t TickOrderBook::LimitTick(const Order &o) const {
+    if (o.Type() == TYPE::MARKET_ORDER || o.Type() == TYPE::STOP_ORDER) {
+        // No limit: reach as far as the band goes on the other side.
+        return o.Side() == SIDE::BUY ? spec.NumTicks() - 1 : 0;
+    }
+    return spec.ToTick(o.Price()).value_or(kNoLevel);
+}
+
+void TickOrderBook::ProcessOrder(const Order &_incoming, FillSink &sink) {
+    ProcessAt(_incoming, LimitTick(_incoming), sink);
+}
+
+void TickOrderBook::ProcessBatch(std::span<const Order> orders,
+                                 FillSink &sink) {
+    uint32_t ticks[kBatchChunk];
+    for (size_t begin = 0; begin < orders.size(); begin += kBatchChunk) {
+        const size_t n = std::min(kBatchChunk, orders.size() - begin);
+        const Order *chunk = orders.data() + begin;
+        // Price-to-tick conversion is independent per order, so doing it
+        // for the whole chunk up front keeps it off the dependent chain of
+        // the match loop.
+        for (size_t i = 0; i < n; ++i) {
+            ticks[i] = LimitTick(chunk[i]);
+        }
+        for (size_t i = 0; i < n; ++i) {
+            ProcessAt(chunk[i], ticks[i], sink);
+        }
+    }
+}
+
+void TickOrderBook::ProcessAt(const Order &_incoming, uint32_t tick,
+                              FillSink &sink) {
+    const auto timer = stats.TimeProcess();
+    stats.CountOrder();
+    if (tick == kNoLevel) {
+        throw std::invalid_argument("Order price off instrument tick grid: " +
+                                    std::to_string(_incoming.Price()));
+    }
+    if (StopBook::IsStop(_incoming)) {
+        stops.Add(_incoming);
+        return;
+    }
+    Execute(_incoming, tick, sink);
+    FireStops(sink);
+}
+
+void TickOrderBook::Execute(Order incoming, uint32_t tick, FillSink &sink) {
+    // Checked before trading: failing once the fills went out would reject
+    // an order that traded.
+    if (!CanRest(incoming, tick)) {
+        throw std::length_error("Order pool exhausted");
+    }
+    if (incoming.Side() == SIDE::BUY) {
+        if (incoming.Type() == TYPE::FOK_ORDER &&
+            !CanFill<SIDE::BUY>(incoming, tick)) {
+            return;
+        }
+        Match<SIDE::BUY>(incoming, tick, sink);
+    } else {
+        if (incoming.Type() == TYPE::FOK_ORDER &&
+            !CanFill<SIDE::SELL>(incoming, tick)) {
+            return;
+        }
+        Match<SIDE::SELL>(incoming, tick, sink);
+    }
+}
+
+void TickOrderBook::FireStops(FillSink &sink) {
+    while (traded_low <= traded_high) {
+        const double low = traded_low;
+        const double high = traded_high;
+        traded_low = std::numeric_limits<double>::infinity();
+        traded_high = -std::numeric_limits<double>::infinity();
+        if (stops.Empty()) {
+            return;
+        }
+        // Activated stops trade in turn and may widen the range again.
+        // Their limits were checked against the grid on arrival.
+        triggered.clear();
+        stops.Trigger(low, high, triggered);
+        for (const Order &o : triggered) {
+            // The order that set it off has already traded, so a
+            // stop-limit with no slot to rest in is dropped instead.
+            const uint32_t tick = LimitTick(o);
+            if (!CanRest(o, tick)) {
+                continue;
+            }
+            Execute(o, tick, sink);
+        }
+    }
+}
+
+bool TickOrderBook::CanRest(const Order &o, uint32_t tick) const {
+    if (o.Type() != TYPE::LIMIT_ORDER || !pool.Full()) {
+        return true;
+    }
+    // A remainder only rests once every order it crossed has left the
+    // book, freeing its slot; so only an order that crosses nothing finds
+    // the pool full.
+    const SideBook &other = o.Side() == SIDE::BUY ? asks : bids;
+    return other.best != kNoLevel &&
+           (o.Side() == SIDE::BUY ? other.best <= tick : other.best >= tick);
+}
+
+template <SIDE S>
+bool TickOrderBook::CanFill(const Order &o, uint32_t tick) const {
+    using Traits = SideTraits<S>;
+    constexpr SIDE kOther = Traits::kOpposite;
+    const SideBook &other = Book<kOther>();
+
+    // DECREMENT_BOTH takes own quantity off the order as if it traded, so
+    // like NONE it only needs the aggregates.
+    const bool by_order =
+        stp == STP::CANCEL_NEWEST || stp == STP::CANCEL_OLDEST;
+    const uint32_t own_bit = PriceLevel::TraderBit(o.Trader());
+    uint64_t available = 0;
+    for (uint32_t t = other.best; t != kNoLevel && Traits::Crosses(t, tick);
+         t = SeekAfter<kOther>(other.occupied, t)) {
+        const PriceLevel &level = other.levels[t];
+        if (!by_order || (level.traders & own_bit) == 0) {
+            available += level.qty + level.hidden;
+        } else if (stp == STP::CANCEL_NEWEST) {
+            // Matching stops at the first own order. Reserves refill
+            // behind it, so only the slices shown ahead of it count.
+            for (OrderPool::Handle h = level.orders.head;
+                 h != OrderPool::kNull; h = pool.Next(h)) {
+                const OrderPool::Slot &slot = pool.Get(h);
+                if (slot.trader == o.Trader()) {
+                    return available >= o.QtyRemaining();
+                }
+                available += slot.qty_remaining;
+            }
+        } else {
+            // Own orders are cancelled as they come up, reserves included.
+            uint64_t own = 0;
+            for (OrderPool::Handle h = level.orders.head;
+                 h != OrderPool::kNull; h = pool.Next(h)) {
+                const OrderPool::Slot &slot = pool.Get(h);
+                if (slot.trader == o.Trader()) {
+                    own += slot.qty_remaining +
+                           locators.Find(slot.order_id)->hidden;
+                }
+            }
+            available += level.qty + level.hidden - own;
+        }
+        if (available >= o.QtyRemaining()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <SIDE S>
+void TickOrderBook::Match(Order &incoming, uint32_t tick, FillSink &sink) {
+    using Traits = SideTraits<S>;
+    constexpr SIDE kOther = Traits::kOpposite;
+    SideBook &other = Book<kOther>();
+    const bool prevent_self = stp != STP::NONE;
+    uint64_t levels_swept = 0;
+
+    while (other.best != kNoLevel && Traits::Crosses(other.best, tick) &&
+           incoming.QtyRemaining() > 0) {
+        const uint32_t best = other.best;
+        auto &level = other.levels[best];
+        auto &queue = level.orders;
+        const OrderPool::Handle head = queue.head;
+        OrderPool::Slot &resting = pool.Get(head);
+
+        uint32_t match_qty =
+            std::min(incoming.QtyRemaining(), resting.qty_remaining);
+
+        if (prevent_self && resting.trader == incoming.Trader()) [[unlikely]] {
+            stats.CountSelfTrade();
+            if (stp == STP::CANCEL_NEWEST) {
+                incoming.QtyRemaining(0);
+                break;
+            }
+            if (stp == STP::CANCEL_OLDEST) {
+                // Empty the resting order, reserve included, so it leaves
+                // below the way a filled one does.
+                OrderLocator &loc = *locators.Find(resting.order_id);
+                level.hidden -= loc.hidden;
+                loc.hidden = 0;
+                level.qty -= resting.qty_remaining;
+                resting.qty_remaining = 0;
+                match_qty = 0;
+            }
+        } else {
+            sink.OnFill(Traits::MakeFill(incoming, resting.order_id,
+                                         resting.trader, resting.price,
+                                         match_qty));
+            stats.CountFill();
+            traded_low = std::min(traded_low, resting.price);
+            traded_high = std::max(traded_high, resting.price);
+        }
+
+        incoming.QtyRemaining(incoming.QtyRemaining() - match_qty);
+        resting.qty_remaining -= match_qty;
+
+        level.qty -= match_qty;
+
+        if (resting.qty_remaining == 0) {
+            if (icebergs != 0 && Replenish(level)) {
+                PublishLevel(kOther, best, level);
+                continue;
+            }
+            locators.Erase(resting.order_id);
+            pool.Unlink(queue, head);
+            pool.Release(head);
+            --level.count;
+            if (queue.Empty()) {
+                PublishLevel(kOther, best, level);
+                ClearLevel<kOther>(best);
+                ++levels_swept;
+                continue;
+            }
+        }
+        PublishLevel(kOther, best, level);
+    }
+    stats.CountSweep(levels_swept);
+
+    if (incoming.QtyRemaining() > 0 && incoming.Type() == TYPE::LIMIT_ORDER) {
+        AddToBook<S>(incoming, tick);
+    }
+}
+
+TradeVector TickOrderBook::ProcessOrder(const Order &_incoming) {
+    TradeVector trade_vector;
+    CallbackSink to_trades([&](const Fill &f) {
+        trade_vector.push_back(std::make_shared<Trade>(
+            f.timestamp, f.buyer, f.seller, f.price, f.qty));
+    });
+    ProcessOrder(_incoming, to_trades);
+    return trade_vector;
+}
+
+bool TickOrderBook::Replenish(PriceLevel &level) {
+    const OrderPool::Handle head = level.orders.head;
+    OrderPool::Slot &slot = pool.Get(head);
+    OrderLocator &loc = *locators.Find(slot.order_id);
+    if (loc.hidden == 0) {
+        if (loc.display_qty != 0) {
+            --icebergs;
+        }
+        return false;
+    }
+    const uint32_t refill = std::min(loc.display_qty, loc.hidden);
+    loc.hidden -= refill;
+    level.hidden -= refill;
+    slot.qty_remaining = refill;
+    level.qty += refill;
+    // Relinking keeps the slot and handle, so nothing is allocated.
+    pool.Unlink(level.orders, head);
+    pool.PushBack(level.orders, head);
+    return true;
+}
+
+template <SIDE S>
+void TickOrderBook::AddToBook(const Order &_o, uint32_t tick) {
+    Order o = _o;
+    const uint32_t shown = o.RestingShownQty();
+    const uint32_t hidden = o.QtyRemaining() - shown;
+    o.QtyRemaining(shown);
+    const OrderPool::Handle h = pool.Acquire(o);
+    SideBook &book = Book<S>();
+    auto &level = book.levels[tick];
+    auto &q = level.orders;
+    if (q.Empty()) {
+        SetBit(book.occupied, tick);
+        const bool improves = S == SIDE::BUY ? tick > book.best
+                                             : tick < book.best;
+        if (book.best == kNoLevel || improves) {
+            book.best = tick;
+        }
+    }
+    pool.PushBack(q, h);
+    level.qty += shown;
+    level.hidden += hidden;
+    ++level.count;
+    level.traders |= PriceLevel::TraderBit(o.Trader());
+    stats.CountQueueLength(level.count);
+    PublishLevel(S, tick, level);
+
+    if (o.DisplayQty() != 0) {
+        ++icebergs;
+    }
+    locators.Assign(o.OrderId(), OrderLocator{o.Timestamp(), tick, h, o.Qty(),
+                                              o.DisplayQty(), hidden, S});
+}
+
+template <SIDE S> void TickOrderBook::ClearLevel(uint32_t tick) {
+    SideBook &book = Book<S>();
+    ClearBit(book.occupied, tick);
+    book.levels[tick].traders = 0;
+    if (tick == book.best) {
+        book.best = SeekFrom<S>(book.occupied, tick);
+    }
+}
+
+template <SIDE S>
+void TickOrderBook::RemoveFromLevel(const OrderLocator &loc) {
+    auto &level = Book<S>().levels[loc.tick];
+    pool.Unlink(level.orders, loc.handle);
+    level.qty -= pool.Get(loc.handle).qty_remaining;
+    level.hidden -= loc.hidden;
+    --level.count;
+    if (loc.display_qty != 0) {
+        --icebergs;
+    }
+    PublishLevel(S, loc.tick, level);
+    if (level.orders.Empty()) {
+        ClearLevel<S>(loc.tick);
+    }
+}
+
+bool TickOrderBook::CancelOrder(uint64_t order_id) {
+    const auto timer = stats.TimeCancel();
+    const OrderLocator *found = locators.Find(order_id);
+    if (!found) {
+        const bool stop = stops.Cancel(order_id);
+        stats.CountCancel(stop);
+        return stop;
+    }
+    stats.CountCancel(true);
+
+    const OrderLocator loc = *found;
+    locators.Erase(order_id);
+
+    if (loc.side == SIDE::BUY) {
+        RemoveFromLevel<SIDE::BUY>(loc);
+    } else {
+        RemoveFromLevel<SIDE::SELL>(loc);
+    }
+    pool.Release(loc.handle);
+    return true;
+}
+
+bool TickOrderBook::ModifyOrder(uint64_t order_id, double new_price,
+                                uint32_t new_qty, FillSink &sink) {
+    stats.CountModify();
+    // A cancel ignores the price, as in OrderBook.
+    if (new_qty == 0) {
+        return CancelOrder(order_id);
+    }
+    OrderLocator *found = locators.Find(order_id);
+    if (!found) {
+        return false;
+    }
+    const auto tick = spec.ToTick(new_price);
+    if (!tick) {
+        throw std::invalid_argument("Order price off instrument tick grid: " +
+                                    std::to_string(new_price));
+    }
+
+    OrderPool::Slot &resting = pool.Get(found->handle);
+    if (*tick == found->tick &&
+        new_qty <= resting.qty_remaining + found->hidden) {
+        // Shrink the hidden reserve first, then the shown slice.
+        auto &level = found->side == SIDE::BUY ? bids.levels[found->tick]
+                                               : asks.levels[found->tick];
+        const uint32_t shown = std::min(new_qty, resting.qty_remaining);
+        level.hidden -= found->hidden - (new_qty - shown);
+        found->hidden = new_qty - shown;
+        level.qty -= resting.qty_remaining - shown;
+        resting.qty_remaining = shown;
+        PublishLevel(found->side, found->tick, level);
+        return true;
+    }
+
+    // Anything else loses priority: take the order out and run it through
+    // matching again. Releasing first means the re-add reuses this slot, so
+    // it cannot fail on a full pool.
+    const OrderLocator loc = *found;
+    locators.Erase(order_id);
+    Order amended = Materialize(loc);
+    amended.Price(new_price);
+    amended.QtyRemaining(new_qty);
+    amended.ShownQty(0);
+
+    if (loc.side == SIDE::BUY) {
+        RemoveFromLevel<SIDE::BUY>(loc);
+    } else {
+        RemoveFromLevel<SIDE::SELL>(loc);
+    }
+    pool.Release(loc.handle);
+    Execute(amended, *tick, sink);
+    FireStops(sink);
+    return true;
+}
+
+void TickOrderBook::PublishLevel(SIDE side, uint32_t tick,
+                                 const PriceLevel &level) {
+    if (depth_sink) {
+        depth_sink->OnLevelUpdate(
+            LevelUpdate{side, spec.ToPrice(tick), level.qty, level.count});
+    }
+}
+
+std::optional<DepthLevel> TickOrderBook::BestBid() const {
+    if (bids.best == kNoLevel) {
+        return std::nullopt;
+    }
+    const auto &level = bids.levels[bids.best];
+    return DepthLevel{spec.ToPrice(bids.best), level.qty, level.count};
+}
+
+std::optional<DepthLevel> TickOrderBook::BestAsk() const {
+    if (asks.best == kNoLevel) {
+        return std::nullopt;
+    }
+    const auto &level = asks.levels[asks.best];
+    return DepthLevel{spec.ToPrice(asks.best), level.qty, level.count};
+}
+
+template <SIDE S>
+void TickOrderBook::CollectDepth(size_t levels,
+                                 std::vector<DepthLevel> &out) const {
+    const SideBook &book = Book<S>();
+    for (uint32_t t = book.best; t != kNoLevel && out.size() < levels;
+         t = SeekAfter<S>(book.occupied, t)) {
+        const auto &level = book.levels[t];
+        out.push_back(DepthLevel{spec.ToPrice(t), level.qty, level.count});
+    }
+}
+
+template <SIDE S>
+void TickOrderBook::VisitSide(
+    const std::function<void(const Order &)> &visit) const {
+    const SideBook &book = Book<S>();
+    for (uint32_t t = book.best; t != kNoLevel;
+         t = SeekAfter<S>(book.occupied, t)) {
+        for (OrderPool::Handle h = book.levels[t].orders.head;
+             h != OrderPool::kNull; h = pool.Next(h)) {
+            visit(Materialize(*locators.Find(pool.Get(h).order_id)));
+        }
+    }
+}
+
+Order TickOrderBook::Materialize(const OrderLocator &loc) const {
+    const OrderPool::Slot &slot = pool.Get(loc.handle);
+    Order o(slot.order_id, loc.timestamp, slot.trader, loc.side, slot.price,
+            loc.qty);
+    o.QtyRemaining(slot.qty_remaining + loc.hidden);
+    if (loc.display_qty != 0) {
+        o.DisplayQty(loc.display_qty);
+        o.ShownQty(slot.qty_remaining);
+    }
+    return o;
+}
+
+void TickOrderBook::ForEachResting(
+    const std::function<void(const Order &)> &visit) const {
+    VisitSide<SIDE::BUY>(visit);
+    VisitSide<SIDE::SELL>(visit);
+    stops.ForEach(visit);
+}
+
+void TickOrderBook::Depth(SIDE side, size_t levels,
+                          std::vector<DepthLevel> &out) const {
+    out.clear();
+    if (side == SIDE::BUY) {
+        CollectDepth<SIDE::BUY>(levels, out);
+    } else {
+        CollectDepth<SIDE::SELL>(levels, out);
+    }
+}
+
+uint32_t TickOrderBook::OpenQty(uint64_t order_id) const {
+    if (const OrderLocator *loc = locators.Find(order_id)) {
+        return pool.Get(loc->handle).qty_remaining + loc->hidden;
+    }
+    return stops.OpenQty(order_id);
+}
+
+BookStats TickOrderBook::Stats() const {
+    BookStats s = stats.Counters();
+    s.resting_orders = locators.Size();
+    for (const uint64_t word : bids.occupied) {
+        s.bid_levels += std::popcount(word);
+    }
+    for (const uint64_t word : asks.occupied) {
+        s.ask_levels += std::popcount(word);
+    }
+    return s;
+}
@@ -0,0 +1,17 @@
+#include "orderbook/TraderTable.h"
+
+#include <stdexcept>
+
+TraderId TraderTable::Intern(std::string_view name) {
+    auto it = ids.find(name);
+    if (it != ids.end()) {
+        return it->second;
+    }
+    if (names.size() >= UINT32_MAX) {
+        throw std::length_error("Trader table full");
+    }
+    const auto id = static_cast<TraderId>(names.size());
+    names.emplace_back(name);
+    ids.emplace(names.back(), id);
+    return id;
+}
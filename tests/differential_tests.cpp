@@ -0,0 +1,516 @@
+#include "orderbook/OrderBook.h"
+#include "orderbook/TickOrderBook.h"
+
+#include <cmath>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// Differential fuzzing of the optimised books against the plain std::map
+// OrderBook, kept as the reference matcher. Each seed generates a random
+// stream of new orders (every type, icebergs and stops), cancels and
+// amends, runs it through the reference and one candidate, and compares
+// the fills, the return values and the whole resting book after every
+// message. A failing stream is shrunk to a minimal reproducer and printed.
+//
+//   orderbook_differential [--seeds N] [--first-seed S] [--messages M]
+
+namespace {
+
+struct Message {
+    enum class Kind : uint8_t { NEW, CANCEL, MODIFY };
+    Kind kind;
+    // NEW: the order. CANCEL / MODIFY: the target id, and for MODIFY the
+    // new price and open quantity.
+    Order order;
+};
+
+struct Options {
+    uint64_t seeds = 200;
+    uint64_t first_seed = 1;
+    uint64_t messages = 1000;
+};
+
+// Prices stay on one tick grid, so every candidate accepts them. Only
+// zero-quantity amends, which cancel, and amends of unused ids go off it.
+const InstrumentSpec kSpec(0.01, 99.0, 101.0);
+constexpr uint32_t kPoolSize = 1u << 16;
+
+const char *Name(SIDE side) { return side == SIDE::BUY ? "BUY" : "SELL"; }
+
+const char *Name(TYPE type) {
+    switch (type) {
+    case TYPE::LIMIT_ORDER:
+        return "LIMIT";
+    case TYPE::MARKET_ORDER:
+        return "MARKET";
+    case TYPE::IOC_ORDER:
+        return "IOC";
+    case TYPE::FOK_ORDER:
+        return "FOK";
+    case TYPE::STOP_ORDER:
+        return "STOP";
+    case TYPE::STOP_LIMIT_ORDER:
+        return "STOP_LIMIT";
+    }
+    return "?";
+}
+
+const char *Name(STP stp) {
+    switch (stp) {
+    case STP::NONE:
+        return "NONE";
+    case STP::CANCEL_NEWEST:
+        return "CANCEL_NEWEST";
+    case STP::CANCEL_OLDEST:
+        return "CANCEL_OLDEST";
+    case STP::DECREMENT_BOTH:
+        return "DECREMENT_BOTH";
+    }
+    return "?";
+}
+
+std::string Describe(const Message &m) {
+    std::ostringstream os;
+    const Order &o = m.order;
+    if (m.kind == Message::Kind::CANCEL) {
+        os << "CANCEL id=" << o.OrderId();
+    } else if (m.kind == Message::Kind::MODIFY) {
+        os << "MODIFY id=" << o.OrderId() << " " << o.Price() << " x "
+           << o.QtyRemaining();
+    } else {
+        os << "NEW id=" << o.OrderId() << " " << Name(o.Side()) << " "
+           << Name(o.Type()) << " " << o.Price() << " x " << o.QtyRemaining()
+           << " trader=" << o.Trader();
+        if (o.DisplayQty() != 0) {
+            os << " display=" << o.DisplayQty();
+        }
+        if (StopBook::IsStop(o)) {
+            os << " stop=" << o.StopPrice();
+        }
+    }
+    return os.str();
+}
+
+// A few traders and a narrow band, so orders cross, queue up and
+// self-match often.
+std::vector<Message> Generate(uint64_t seed, uint64_t count) {
+    std::mt19937_64 rng(seed);
+    auto price = [&] { return 99.9 + static_cast<double>(rng() % 21) * 0.01; };
+    std::vector<Message> out;
+    uint64_t next_id = 1;
+    for (uint64_t i = 0; i < count; ++i) {
+        // Cancels and amends mostly hit earlier orders, sometimes ids that
+        // were never used.
+        const uint64_t target = 1 + rng() % (next_id + 2);
+        const auto qty = static_cast<uint32_t>(1 + rng() % 30);
+        const uint64_t roll = rng() % 100;
+        if (roll < 15) {
+            out.push_back({Message::Kind::CANCEL,
+                           Order(target, 0, 0, SIDE::BUY, 0.0, 0)});
+            continue;
+        }
+        if (roll < 25) {
+            // Zero quantity cancels, and ids never used are unknown,
+            // whatever the price says.
+            const bool cancel = rng() % 8 == 0;
+            const double at = (cancel || target >= next_id) && (rng() & 1)
+                                  ? price() + 0.005
+                                  : price();
+            out.push_back({Message::Kind::MODIFY,
+                           Order(target, 0, 0, SIDE::BUY, at,
+                                 cancel ? 0 : qty)});
+            continue;
+        }
+        const uint64_t id = next_id++;
+        Order o(id, static_cast<int64_t>(id),
+                static_cast<TraderId>(rng() % 3),
+                (rng() & 1) ? SIDE::BUY : SIDE::SELL, price(), qty);
+        const uint64_t kind = rng() % 100;
+        if (kind < 5) {
+            o.Type(TYPE::MARKET_ORDER);
+        } else if (kind < 12) {
+            o.Type(TYPE::IOC_ORDER);
+        } else if (kind < 19) {
+            o.Type(TYPE::FOK_ORDER);
+        } else if (kind < 27) {
+            o.Type(rng() & 1 ? TYPE::STOP_ORDER : TYPE::STOP_LIMIT_ORDER);
+            o.StopPrice(price());
+        } else if (kind < 40) {
+            o.DisplayQty(static_cast<uint32_t>(1 + rng() % 8));
+        }
+        out.push_back({Message::Kind::NEW, o});
+    }
+    return out;
+}
+
+// What one message did to a book.
+struct Outcome {
+    bool threw{false};
+    bool result{false};
+    std::vector<Fill> fills;
+};
+
+using RestingKey = std::tuple<uint64_t, SIDE, TYPE, double, uint32_t,
+                              uint32_t, uint32_t, TraderId>;
+
+struct BookState {
+    std::vector<RestingKey> resting;
+    std::vector<DepthLevel> bids;
+    std::vector<DepthLevel> asks;
+};
+
+// Common face of the books under test.
+class Engine {
+  public:
+    virtual ~Engine() = default;
+    virtual Outcome Apply(const Message &m) = 0;
+    virtual BookState State() const = 0;
+    virtual uint32_t OpenQty(uint64_t order_id) const = 0;
+};
+
+template <typename Book> class BookEngine : public Engine {
+  public:
+    // `copy_every` > 0 replaces the book with a copy of itself every that
+    // many messages, so the copy constructor is fuzzed along with the book.
+    BookEngine(std::unique_ptr<Book> _book, STP stp, uint64_t _copy_every)
+        : book{std::move(_book)}, copy_every{_copy_every} {
+        book->SetSelfTradePrevention(stp);
+    }
+
+    Outcome Apply(const Message &m) override {
+        if (copy_every != 0 && ++applied % copy_every == 0) {
+            book = std::make_unique<Book>(*book);
+        }
+        Outcome out;
+        CallbackSink sink([&](const Fill &f) { out.fills.push_back(f); });
+        try {
+            switch (m.kind) {
+            case Message::Kind::NEW:
+                book->ProcessOrder(m.order, sink);
+                break;
+            case Message::Kind::CANCEL:
+                out.result = book->CancelOrder(m.order.OrderId());
+                break;
+            case Message::Kind::MODIFY:
+                out.result = book->ModifyOrder(m.order.OrderId(),
+                                               m.order.Price(),
+                                               m.order.QtyRemaining(), sink);
+                break;
+            }
+        } catch (const std::exception &) {
+            out.threw = true;
+        }
+        return out;
+    }
+
+    BookState State() const override {
+        BookState s;
+        book->ForEachResting([&](const Order &o) {
+            s.resting.emplace_back(o.OrderId(), o.Side(), o.Type(),
+                                   o.Price(), o.QtyRemaining(),
+                                   o.DisplayQty(), o.RestingShownQty(),
+                                   o.Trader());
+        });
+        book->Depth(SIDE::BUY, SIZE_MAX, s.bids);
+        book->Depth(SIDE::SELL, SIZE_MAX, s.asks);
+        return s;
+    }
+
+    uint32_t OpenQty(uint64_t order_id) const override {
+        return book->OpenQty(order_id);
+    }
+
+  private:
+    std::unique_ptr<Book> book;
+    uint64_t copy_every;
+    uint64_t applied{0};
+};
+
+struct Candidate {
+    std::string name;
+    std::function<std::unique_ptr<Engine>(STP)> make;
+};
+
+bool SamePrice(double a, double b) { return std::abs(a - b) < 1e-9; }
+
+std::optional<std::string> CompareOutcome(const Outcome &want,
+                                          const Outcome &got) {
+    if (want.threw != got.threw) {
+        return std::string("threw: reference ") +
+               (want.threw ? "yes" : "no") + ", candidate " +
+               (got.threw ? "yes" : "no");
+    }
+    if (want.result != got.result) {
+        return "returned " + std::to_string(got.result) + ", reference " +
+               std::to_string(want.result);
+    }
+    if (want.fills.size() != got.fills.size()) {
+        return std::to_string(got.fills.size()) + " fills, reference " +
+               std::to_string(want.fills.size());
+    }
+    for (size_t i = 0; i < want.fills.size(); ++i) {
+        const Fill &a = want.fills[i];
+        const Fill &b = got.fills[i];
+        if (a.buy_order_id != b.buy_order_id ||
+            a.sell_order_id != b.sell_order_id || a.qty != b.qty ||
+            !SamePrice(a.price, b.price) || a.timestamp != b.timestamp ||
+            a.buyer != b.buyer || a.seller != b.seller) {
+            std::ostringstream os;
+            os << "fill " << i << ": " << b.buy_order_id << "/"
+               << b.sell_order_id << " " << b.qty << " @ " << b.price
+               << ", reference " << a.buy_order_id << "/" << a.sell_order_id
+               << " " << a.qty << " @ " << a.price;
+            return os.str();
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<std::string> CompareState(const BookState &want,
+                                        const BookState &got) {
+    if (want.resting.size() != got.resting.size()) {
+        return std::to_string(got.resting.size()) +
+               " resting orders, reference " +
+               std::to_string(want.resting.size());
+    }
+    for (size_t i = 0; i < want.resting.size(); ++i) {
+        auto a = want.resting[i];
+        auto b = got.resting[i];
+        if (!SamePrice(std::get<3>(a), std::get<3>(b))) {
+            return "resting order " + std::to_string(i) + " price differs";
+        }
+        std::get<3>(a) = std::get<3>(b);
+        if (a != b) {
+            return "resting order " + std::to_string(i) + " (id " +
+                   std::to_string(std::get<0>(a)) + ") differs";
+        }
+    }
+    for (const auto &[side, a, b] :
+         {std::tuple{"bid", &want.bids, &got.bids},
+          std::tuple{"ask", &want.asks, &got.asks}}) {
+        if (a->size() != b->size()) {
+            return std::string(side) + " levels: " +
+                   std::to_string(b->size()) + ", reference " +
+                   std::to_string(a->size());
+        }
+        for (size_t i = 0; i < a->size(); ++i) {
+            if (!SamePrice((*a)[i].price, (*b)[i].price) ||
+                (*a)[i].qty != (*b)[i].qty ||
+                (*a)[i].orders != (*b)[i].orders) {
+                return std::string(side) + " level " + std::to_string(i) +
+                       " differs";
+            }
+        }
+    }
+    return std::nullopt;
+}
+
+struct Divergence {
+    size_t index;
+    std::string what;
+};
+
+// Runs `msgs` through the reference and `candidate`, checking after every
+// message.
+std::optional<Divergence> Replay(const std::vector<Message> &msgs, STP stp,
+                                 const Candidate &candidate) {
+    BookEngine<OrderBook> reference(std::make_unique<OrderBook>(), stp, 0);
+    const auto engine = candidate.make(stp);
+    for (size_t i = 0; i < msgs.size(); ++i) {
+        const Outcome want = reference.Apply(msgs[i]);
+        const Outcome got = engine->Apply(msgs[i]);
+        auto diff = CompareOutcome(want, got);
+        if (!diff) {
+            diff = CompareState(reference.State(), engine->State());
+        }
+        if (!diff) {
+            const uint64_t id = msgs[i].order.OrderId();
+            if (reference.OpenQty(id) != engine->OpenQty(id)) {
+                diff = "open quantity of id " + std::to_string(id) +
+                       " differs";
+            }
+        }
+        if (diff) {
+            return Divergence{i, *diff};
+        }
+    }
+    return std::nullopt;
+}
+
+// Greedy delta debugging: drops ever smaller runs of messages for as long
+// as the stream still diverges. Dropping a new order turns later cancels
+// and amends of it into misses, which is still a valid stream.
+std::vector<Message> Shrink(std::vector<Message> msgs, STP stp,
+                            const Candidate &candidate) {
+    // Nothing after the first divergence matters.
+    if (const auto d = Replay(msgs, stp, candidate)) {
+        msgs.erase(msgs.begin() + static_cast<long>(d->index) + 1, msgs.end());
+    }
+    for (size_t chunk = msgs.size() / 2; chunk >= 1;) {
+        bool dropped = false;
+        for (size_t start = 0; start < msgs.size();) {
+            std::vector<Message> trial;
+            trial.reserve(msgs.size());
+            trial.insert(trial.end(), msgs.begin(),
+                         msgs.begin() + static_cast<long>(start));
+            trial.insert(trial.end(),
+                         msgs.begin() + static_cast<long>(std::min(
+                                            msgs.size(), start + chunk)),
+                         msgs.end());
+            if (const auto d = Replay(trial, stp, candidate)) {
+                trial.erase(trial.begin() + static_cast<long>(d->index) + 1,
+                            trial.end());
+                msgs = std::move(trial);
+                dropped = true;
+            } else {
+                start += chunk;
+            }
+        }
+        if (!dropped) {
+            chunk /= 2;
+        }
+    }
+    return msgs;
+}
+
+void Report(uint64_t seed, STP stp, const Candidate &candidate,
+            const std::vector<Message> &msgs) {
+    const auto minimal = Shrink(msgs, stp, candidate);
+    const auto d = Replay(minimal, stp, candidate);
+    std::cerr << "[FAIL] " << candidate.name << " diverges from the reference"
+              << " (seed " << seed << ", stp " << Name(stp) << "): "
+              << d->what << "\nMinimal stream (" << minimal.size()
+              << " of " << msgs.size() << " messages):\n";
+    for (const Message &m : minimal) {
+        std::cerr << "  " << Describe(m) << "\n";
+    }
+}
+
+std::vector<Candidate> Candidates() {
+    auto tick = [](uint64_t copy_every) {
+        return [copy_every](STP stp) -> std::unique_ptr<Engine> {
+            return std::make_unique<BookEngine<TickOrderBook>>(
+                std::make_unique<TickOrderBook>(kSpec, kPoolSize), stp,
+                copy_every);
+        };
+    };
+    auto map = [](OrderBookOptions options, uint64_t copy_every) {
+        return [options, copy_every](STP stp) -> std::unique_ptr<Engine> {
+            return std::make_unique<BookEngine<OrderBook>>(
+                std::make_unique<OrderBook>(options), stp, copy_every);
+        };
+    };
+    // A small threshold so lazy compaction also runs mid-stream.
+    const OrderBookOptions lazy{.lazy_cancel = true, .compact_threshold = 16};
+    return {
+        {"TickOrderBook", tick(0)},
+        {"OrderBook (lazy cancel)", map(lazy, 0)},
+        {"TickOrderBook (copied every 97 messages)", tick(97)},
+        {"OrderBook (lazy cancel, copied every 89 messages)", map(lazy, 89)},
+    };
+}
+
+// The harness must catch and shrink a real divergence: a candidate that
+// runs a different self-trade prevention policy from the reference.
+bool SelfCheck() {
+    const Candidate wrong{"OrderBook (other STP)", [](STP) {
+                              return std::make_unique<BookEngine<OrderBook>>(
+                                  std::make_unique<OrderBook>(),
+                                  STP::CANCEL_NEWEST, 0);
+                          }};
+    const auto msgs = Generate(1, 500);
+    if (!Replay(msgs, STP::NONE, wrong)) {
+        std::cerr << "[FAIL] Self-check: a wrong candidate went unnoticed\n";
+        return false;
+    }
+    const auto minimal = Shrink(msgs, STP::NONE, wrong);
+    // Two crossing orders of one trader are enough.
+    if (minimal.size() > 2) {
+        std::cerr << "[FAIL] Self-check: shrunk to " << minimal.size()
+                  << " messages\n";
+        return false;
+    }
+    std::cout << "[PASS] Self-check: a wrong candidate is caught and shrunk "
+                 "to "
+              << minimal.size() << " messages\n";
+    return true;
+}
+
+Options ParseArgs(int argc, char **argv) {
+    Options opts;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::runtime_error("Missing value for " + arg);
+            }
+            return argv[++i];
+        };
+        if (arg == "--seeds") {
+            opts.seeds = std::stoull(value());
+        } else if (arg == "--first-seed") {
+            opts.first_seed = std::stoull(value());
+        } else if (arg == "--messages") {
+            opts.messages = std::stoull(value());
+        } else {
+            throw std::runtime_error("Unknown argument: " + arg);
+        }
+    }
+    return opts;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    try {
+        const Options opts = ParseArgs(argc, argv);
+        int failures = SelfCheck() ? 0 : 1;
+
+        const auto candidates = Candidates();
+        constexpr STP kPolicies[] = {STP::NONE, STP::CANCEL_NEWEST,
+                                     STP::CANCEL_OLDEST, STP::DECREMENT_BOTH};
+        for (const Candidate &candidate : candidates) {
+            uint64_t failed = 0;
+            for (uint64_t seed = opts.first_seed;
+                 seed < opts.first_seed + opts.seeds; ++seed) {
+                const STP stp = kPolicies[seed % 4];
+                const auto msgs = Generate(seed, opts.messages);
+                if (Replay(msgs, stp, candidate)) {
+                    // One reproducer per candidate is enough to go on.
+                    if (failed++ == 0) {
+                        Report(seed, stp, candidate, msgs);
+                    }
+                }
+            }
+            if (failed == 0) {
+                std::cout << "[PASS] " << candidate.name << " matches the "
+                          << "reference on " << opts.seeds << " streams of "
+                          << opts.messages << " messages\n";
+            } else {
+                std::cerr << "[FAIL] " << candidate.name << " diverged on "
+                          << failed << " of " << opts.seeds << " streams\n";
+                ++failures;
+            }
+        }
+
+        if (failures == 0) {
+            std::cout << "\nALL TESTS PASSED\n";
+            return 0;
+        }
+        std::cerr << "\nTESTS FAILED: " << failures << "\n";
+        return 1;
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+}
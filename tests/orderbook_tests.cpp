@@ -1,10 +1,38 @@
+#include "orderbook/Journal.h"
+#ifdef __linux__
+#include "orderbook/Gateway.h"
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+#include "orderbook/MatchingEngine.h"
 #include "orderbook/OrderBook.h"
+#include "orderbook/OrderFile.h"
+#include "orderbook/OrderIdIndex.h"
+#include "orderbook/TickOrderBook.h"
+#include "orderbook/TraderTable.h"
 
+#include <algorithm>
+#include <cmath>
 #include <cstdlib>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <random>
+#include <span>
+#include <stdexcept>
 #include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
 
 static int failures{0};
+static TraderTable trader_table;
+
+static TraderId Id(const std::string &name) {
+    return trader_table.Intern(name);
+}
 
 static void CHECK(bool cond, const std::string &msg) {
     if (!cond) {
@@ -21,7 +49,7 @@ static void test_cancel_prevents_match() {
     OrderBook book;
 
     {
-        Order buy1(1, 1, "Biden", SIDE::BUY, 100.0, 10);
+        Order buy1(1, 1, Id("Biden"), SIDE::BUY, 100.0, 10);
         auto trade_vector = book.ProcessOrder(buy1);
         CHECK(trade_vector.empty(), "Resting BUY produces no trade_vector");
     }
@@ -32,7 +60,7 @@ static void test_cancel_prevents_match() {
     }
 
     {
-        Order sell1(2, 2, "Donald", SIDE::SELL, 100.0, 5);
+        Order sell1(2, 2, Id("Donald"), SIDE::SELL, 100.0, 5);
         auto trade_vector = book.ProcessOrder(sell1);
 
         CHECK(trade_vector.empty(), "SELL after cancellation produces 0 trade_vector");
@@ -40,8 +68,8 @@ static void test_cancel_prevents_match() {
         if (!trade_vector.empty()) {
             std::cout << "Unexpected trade_vector:\n";
             for (const auto &t : trade_vector) {
-                std::cout << " ts=" << t->Timestamp() << " buyer=" << t->Buyer()
-                          << " seller=" << t->Seller()
+                std::cout << " ts=" << t->Timestamp() << " buyer=" << trader_table.Name(t->Buyer())
+                          << " seller=" << trader_table.Name(t->Seller())
                           << " price=" << t->Price() << " qty=" << t->Qty()
                           << "\n";
             }
@@ -55,18 +83,18 @@ static void test_fifo_same_price_sell_side() {
     OrderBook book;
 
     {
-        Order sell1(1, 1, "Donald", SIDE::SELL, 100.0, 2);
+        Order sell1(1, 1, Id("Donald"), SIDE::SELL, 100.0, 2);
         auto trade_vector = book.ProcessOrder(sell1);
         CHECK(trade_vector.empty(), "Resting SELL #1 produces no trade_vector");
     }
     {
-        Order sell2(2, 2, "Trump", SIDE::SELL, 100.0, 2);
+        Order sell2(2, 2, Id("Trump"), SIDE::SELL, 100.0, 2);
         auto trade_vector = book.ProcessOrder(sell2);
         CHECK(trade_vector.empty(), "Resting SELL #2 produces no trade_vector");
     }
 
     {
-        Order buy1(3, 3, "Biden", SIDE::BUY, 100.0, 3);
+        Order buy1(3, 3, Id("Biden"), SIDE::BUY, 100.0, 3);
         auto trade_vector = book.ProcessOrder(buy1);
 
         CHECK(trade_vector.size() == 2, "Incoming BUY produces exactly 2 trade_vector");
@@ -75,20 +103,20 @@ static void test_fifo_same_price_sell_side() {
             auto t0 = trade_vector[0];
             auto t1 = trade_vector[1];
 
-            CHECK(t0->Buyer() == "Biden", "Trade 0 buyer is Biden");
-            CHECK(t0->Seller() == "Donald", "Trade 0 seller is Donald (FIFO)");
+            CHECK(t0->Buyer() == Id("Biden"), "Trade 0 buyer is Biden");
+            CHECK(t0->Seller() == Id("Donald"), "Trade 0 seller is Donald (FIFO)");
             CHECK(t0->Qty() == 2, "Trade 0 qty is 2 (fills Donald)");
             CHECK(t0->Price() == 100.0, "Trade 0 price is resting price 100.0");
 
-            CHECK(t1->Buyer() == "Biden", "Trade 1 buyer is Biden");
-            CHECK(t1->Seller() == "Trump", "Trade 1 seller is Trump (second)");
+            CHECK(t1->Buyer() == Id("Biden"), "Trade 1 buyer is Biden");
+            CHECK(t1->Seller() == Id("Trump"), "Trade 1 seller is Trump (second)");
             CHECK(t1->Qty() == 1, "Trade 1 qty is 1 (partial fill)");
             CHECK(t1->Price() == 100.0, "Trade 1 price is resting price 100.0");
         }
     }
 
     {
-        Order buy2(4, 4, "Obama", SIDE::BUY, 101.0, 2);
+        Order buy2(4, 4, Id("Obama"), SIDE::BUY, 101.0, 2);
         auto trade_vector = book.ProcessOrder(buy2);
 
         CHECK(trade_vector.size() == 1,
@@ -96,8 +124,8 @@ static void test_fifo_same_price_sell_side() {
 
         if (!trade_vector.empty()) {
             auto t = trade_vector[0];
-            CHECK(t->Buyer() == "Obama", "Remainder trade buyer is Obama");
-            CHECK(t->Seller() == "Trump", "Remainder trade seller is Trump");
+            CHECK(t->Buyer() == Id("Obama"), "Remainder trade buyer is Obama");
+            CHECK(t->Seller() == Id("Trump"), "Remainder trade seller is Trump");
             CHECK(t->Qty() == 1, "Remainder trade qty is 1");
             CHECK(t->Price() == 100.0,
                   "Remainder trade price is resting price 100.0");
@@ -111,26 +139,26 @@ static void test_price_priority() {
     OrderBook book;
 
     {
-        Order buy1(1, 1, "Biden", SIDE::BUY, 100, 1);
+        Order buy1(1, 1, Id("Biden"), SIDE::BUY, 100, 1);
         auto trade_vector = book.ProcessOrder(buy1);
         CHECK(trade_vector.empty(), "Resting BUY #1 produces no trade_vector");
     }
     {
-        Order buy2(2, 2, "Obama", SIDE::BUY, 102, 1);
+        Order buy2(2, 2, Id("Obama"), SIDE::BUY, 102, 1);
         auto trade_vector = book.ProcessOrder(buy2);
         CHECK(trade_vector.empty(), "Resting BUY #2 produces no trade_vector");
     }
     {
-        Order sell1(3, 3, "Donald", SIDE::SELL, 100, 1);
+        Order sell1(3, 3, Id("Donald"), SIDE::SELL, 100, 1);
         auto trade_vector = book.ProcessOrder(sell1);
         CHECK(trade_vector.size() == 1, "Incoming SELL produces 1 trade.");
 
         if (trade_vector.size() == 1) {
             auto t = trade_vector[0];
 
-            CHECK(t->Buyer() == "Obama",
+            CHECK(t->Buyer() == Id("Obama"),
                   "Trade buyer is Obama (Price Priority)");
-            CHECK(t->Seller() == "Donald",
+            CHECK(t->Seller() == Id("Donald"),
                   "Trade buyer is Obama (Price Priority)");
             CHECK(t->Qty() == 1, "Trade qty is 1");
             CHECK(t->Price() == 102.0, "Trade price is resting price 102.0");
@@ -138,10 +166,1576 @@ static void test_price_priority() {
     }
 }
 
+static bool SameTrades(const TradeVector &a, const TradeVector &b) {
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i]->Timestamp() != b[i]->Timestamp() ||
+            a[i]->Buyer() != b[i]->Buyer() ||
+            a[i]->Seller() != b[i]->Seller() ||
+            a[i]->Price() != b[i]->Price() || a[i]->Qty() != b[i]->Qty())
+            return false;
+    }
+    return true;
+}
+
+static void test_tick_book_matches_map_book() {
+    std::cout << "\n=== test_tick_book_matches_map_book ===\n";
+
+    OrderBook map_book;
+    TickOrderBook tick_book(InstrumentSpec(0.01, 99.0, 101.0));
+
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<int> tick_dist(0, 200);
+    std::uniform_int_distribution<uint32_t> qty_dist(1, 50);
+    std::uniform_int_distribution<int> action_dist(0, 9);
+    const char *traders[] = {"Biden", "Donald", "Obama", "Trump"};
+
+    size_t mismatches = 0;
+    size_t total_trades = 0;
+    for (uint64_t id = 1; id <= 20000; ++id) {
+        if (action_dist(rng) < 3) {
+            std::uniform_int_distribution<uint64_t> id_dist(1, id);
+            const uint64_t victim = id_dist(rng);
+            if (map_book.CancelOrder(victim) != tick_book.CancelOrder(victim))
+                ++mismatches;
+            continue;
+        }
+        if (action_dist(rng) < 3) {
+            std::uniform_int_distribution<uint64_t> id_dist(1, id);
+            const uint64_t victim = id_dist(rng);
+            const double price = 99.0 + tick_dist(rng) * 0.01;
+            const uint32_t qty = qty_dist(rng) - 1;
+            TradeVector expected, actual;
+            CallbackSink to_expected([&](const Fill &f) {
+                expected.push_back(std::make_shared<Trade>(
+                    f.timestamp, f.buyer, f.seller, f.price, f.qty));
+            });
+            CallbackSink to_actual([&](const Fill &f) {
+                actual.push_back(std::make_shared<Trade>(
+                    f.timestamp, f.buyer, f.seller, f.price, f.qty));
+            });
+            if (map_book.ModifyOrder(victim, price, qty, to_expected) !=
+                tick_book.ModifyOrder(victim, price, qty, to_actual))
+                ++mismatches;
+            total_trades += expected.size();
+            if (!SameTrades(expected, actual))
+                ++mismatches;
+            continue;
+        }
+        const double price = 99.0 + tick_dist(rng) * 0.01;
+        const SIDE side = (rng() & 1) ? SIDE::BUY : SIDE::SELL;
+        const TYPE types[] = {TYPE::LIMIT_ORDER, TYPE::LIMIT_ORDER,
+                              TYPE::LIMIT_ORDER, TYPE::MARKET_ORDER,
+                              TYPE::IOC_ORDER, TYPE::FOK_ORDER};
+        Order o(id, static_cast<int64_t>(id), Id(traders[rng() % 4]), side, price,
+                qty_dist(rng), types[rng() % 6]);
+
+        auto expected = map_book.ProcessOrder(o);
+        auto actual = tick_book.ProcessOrder(o);
+        total_trades += expected.size();
+        if (!SameTrades(expected, actual))
+            ++mismatches;
+    }
+
+    CHECK(total_trades > 0, "Random stream produces trades");
+    CHECK(mismatches == 0,
+          "Tick book trades, cancels and amends match the map book");
+}
+
+static void test_modify_order_priority() {
+    std::cout << "\n=== test_modify_order_priority ===\n";
+
+    TickOrderBook book(InstrumentSpec(1.0, 1.0, 10.0));
+    CallbackSink ignore([](const Fill &) {});
+
+    book.ProcessOrder(Order(1, 0, Id("Biden"), SIDE::SELL, 5.0, 10));
+    book.ProcessOrder(Order(2, 0, Id("Obama"), SIDE::SELL, 5.0, 10));
+
+    // Shrinking in place keeps order 1 ahead of order 2.
+    CHECK(book.ModifyOrder(1, 5.0, 4, ignore), "Resting order can be amended");
+    auto trades = book.ProcessOrder(Order(3, 0, Id("Trump"), SIDE::BUY, 5.0, 6));
+    CHECK(trades.size() == 2 && trades[0]->Seller() == Id("Biden") &&
+              trades[0]->Qty() == 4 && trades[1]->Seller() == Id("Obama"),
+          "Quantity decrease keeps queue priority");
+
+    // Growing sends order 2 behind order 4.
+    book.ProcessOrder(Order(4, 0, Id("Donald"), SIDE::SELL, 5.0, 1));
+    CHECK(book.ModifyOrder(2, 5.0, 20, ignore), "Quantity can be increased");
+    trades = book.ProcessOrder(Order(5, 0, Id("Trump"), SIDE::BUY, 5.0, 1));
+    CHECK(trades.size() == 1 && trades[0]->Seller() == Id("Donald"),
+          "Quantity increase loses queue priority");
+
+    // Repricing through the bid trades immediately at the resting price.
+    book.ProcessOrder(Order(6, 0, Id("Biden"), SIDE::BUY, 3.0, 5));
+    std::vector<Fill> fills;
+    CallbackSink collect([&](const Fill &f) { fills.push_back(f); });
+    CHECK(book.ModifyOrder(2, 3.0, 8, collect), "Order can be repriced");
+    CHECK(fills.size() == 1 && fills[0].buy_order_id == 6 &&
+              fills[0].sell_order_id == 2 && fills[0].qty == 5 &&
+              fills[0].price == 3.0,
+          "Repriced order re-matches against the other side");
+
+    CHECK(book.ModifyOrder(2, 3.0, 0, ignore), "Zero quantity cancels");
+    CHECK(!book.CancelOrder(2), "Cancelled amend leaves nothing resting");
+    CHECK(!book.ModifyOrder(42, 5.0, 1, ignore), "Unknown id is not amended");
+    CHECK(!book.ModifyOrder(42, 5.5, 1, ignore),
+          "Unknown id with an off-grid price is not amended either");
+    Order stop(7, 0, Id("Biden"), SIDE::BUY, 9.0, 1, TYPE::STOP_LIMIT_ORDER);
+    stop.StopPrice(9.0);
+    book.ProcessOrder(stop);
+    CHECK(!book.ModifyOrder(7, 5.5, 1, ignore),
+          "Pending stop with an off-grid price is not amended");
+}
+
+static bool SameLevel(SIDE sa, const DepthLevel &a, SIDE sb,
+                      const DepthLevel &b) {
+    return sa == sb && std::abs(a.price - b.price) < 1e-9 && a.qty == b.qty &&
+           a.orders == b.orders;
+}
+
+static void test_depth_matches_map_book() {
+    std::cout << "\n=== test_depth_matches_map_book ===\n";
+
+    OrderBook map_book;
+    TickOrderBook tick_book(InstrumentSpec(0.01, 99.0, 101.0));
+
+    std::vector<LevelUpdate> map_updates, tick_updates;
+    struct Recorder : DepthSink {
+        std::vector<LevelUpdate> &out;
+        explicit Recorder(std::vector<LevelUpdate> &_out) : out{_out} {}
+        void OnLevelUpdate(const LevelUpdate &u) override { out.push_back(u); }
+    };
+    Recorder map_recorder(map_updates), tick_recorder(tick_updates);
+    map_book.SetDepthSink(&map_recorder);
+    tick_book.SetDepthSink(&tick_recorder);
+    CallbackSink ignore([](const Fill &) {});
+
+    std::mt19937_64 rng(7);
+    std::vector<DepthLevel> map_depth, tick_depth;
+    bool same = true;
+    for (uint64_t id = 1; id <= 5000; ++id) {
+        const double price = 99.0 + static_cast<double>(rng() % 201) * 0.01;
+        const uint32_t qty = static_cast<uint32_t>(1 + rng() % 50);
+        switch (rng() % 4) {
+        case 0: {
+            const uint64_t victim = 1 + rng() % id;
+            map_book.CancelOrder(victim);
+            tick_book.CancelOrder(victim);
+            break;
+        }
+        case 1: {
+            const uint64_t victim = 1 + rng() % id;
+            map_book.ModifyOrder(victim, price, qty / 2, ignore);
+            tick_book.ModifyOrder(victim, price, qty / 2, ignore);
+            break;
+        }
+        default: {
+            const Order o(id, 0, Id("Biden"),
+                          (rng() & 1) ? SIDE::BUY : SIDE::SELL, price, qty);
+            map_book.ProcessOrder(o, ignore);
+            tick_book.ProcessOrder(o, ignore);
+        }
+        }
+        for (SIDE side : {SIDE::BUY, SIDE::SELL}) {
+            map_book.Depth(side, 5, map_depth);
+            tick_book.Depth(side, 5, tick_depth);
+            same &= map_depth.size() == tick_depth.size();
+            for (size_t i = 0; same && i < map_depth.size(); ++i) {
+                same &= SameLevel(side, map_depth[i], side, tick_depth[i]);
+            }
+        }
+    }
+    CHECK(same, "Top-5 depth agrees with the map book after every message");
+
+    bool same_stream = map_updates.size() == tick_updates.size();
+    for (size_t i = 0; same_stream && i < map_updates.size(); ++i) {
+        const auto &m = map_updates[i];
+        const auto &t = tick_updates[i];
+        same_stream &= SameLevel(m.side, {m.price, m.qty, m.orders}, t.side,
+                                 {t.price, t.qty, t.orders});
+    }
+    CHECK(!map_updates.empty() && same_stream,
+          "Level update streams agree with the map book");
+
+    const auto bid = tick_book.BestBid();
+    tick_book.Depth(SIDE::BUY, 1, tick_depth);
+    CHECK(bid && !tick_depth.empty() &&
+              SameLevel(SIDE::BUY, *bid, SIDE::BUY, tick_depth[0]),
+          "BestBid is the first depth level");
+}
+
+template <typename Book>
+static void CheckNonRestingTypes(Book &book, const std::string &name) {
+    std::vector<Fill> fills;
+    CallbackSink collect([&](const Fill &f) { fills.push_back(f); });
+
+    book.ProcessOrder(Order(1, 0, Id("Biden"), SIDE::SELL, 5.0, 3), collect);
+    book.ProcessOrder(Order(2, 0, Id("Obama"), SIDE::SELL, 6.0, 3), collect);
+
+    // FOK for more than the book holds within its limit does nothing.
+    book.ProcessOrder(
+        Order(3, 0, Id("Trump"), SIDE::BUY, 5.0, 4, TYPE::FOK_ORDER), collect);
+    CHECK(fills.empty() && book.BestAsk()->qty == 3,
+          name + ": unfillable FOK leaves the book untouched");
+
+    // IOC takes what is there up to its limit and drops the rest.
+    book.ProcessOrder(
+        Order(4, 0, Id("Trump"), SIDE::BUY, 5.0, 4, TYPE::IOC_ORDER), collect);
+    CHECK(fills.size() == 1 && fills[0].qty == 3 && !book.BestBid() &&
+              !book.CancelOrder(4),
+          name + ": IOC remainder does not rest");
+
+    // FOK that can be filled across levels trades in full.
+    fills.clear();
+    book.ProcessOrder(Order(5, 0, Id("Biden"), SIDE::SELL, 7.0, 5), collect);
+    book.ProcessOrder(
+        Order(6, 0, Id("Trump"), SIDE::BUY, 7.0, 6, TYPE::FOK_ORDER), collect);
+    CHECK(fills.size() == 2 && fills[0].qty == 3 && fills[1].qty == 3 &&
+              book.BestAsk()->qty == 2,
+          name + ": fillable FOK trades its whole quantity");
+
+    // Market orders ignore price and never rest.
+    fills.clear();
+    book.ProcessOrder(
+        Order(7, 0, Id("Trump"), SIDE::BUY, 0.0, 10, TYPE::MARKET_ORDER),
+        collect);
+    CHECK(fills.size() == 1 && fills[0].price == 7.0 && fills[0].qty == 2 &&
+              !book.BestAsk() && !book.BestBid(),
+          name + ": market order sweeps the book and does not rest");
+}
+
+static void test_market_ioc_fok() {
+    std::cout << "\n=== test_market_ioc_fok ===\n";
+
+    OrderBook map_book;
+    CheckNonRestingTypes(map_book, "map");
+    TickOrderBook tick_book(InstrumentSpec(1.0, 1.0, 10.0));
+    CheckNonRestingTypes(tick_book, "tick");
+}
+
+static void test_tick_book_rejects_off_grid() {
+    std::cout << "\n=== test_tick_book_rejects_off_grid ===\n";
+
+    TickOrderBook book(InstrumentSpec(0.05, 90.0, 110.0));
+
+    bool threw = false;
+    try {
+        book.ProcessOrder(Order(1, 1, Id("Biden"), SIDE::BUY, 100.02, 1));
+    } catch (const std::invalid_argument &) {
+        threw = true;
+    }
+    CHECK(threw, "Off-grid price is rejected");
+
+    threw = false;
+    try {
+        book.ProcessOrder(Order(2, 2, Id("Biden"), SIDE::BUY, 120.0, 1));
+    } catch (const std::invalid_argument &) {
+        threw = true;
+    }
+    CHECK(threw, "Price outside the band is rejected");
+
+    auto trades = book.ProcessOrder(Order(3, 3, Id("Biden"), SIDE::BUY, 110.0, 1));
+    CHECK(trades.empty(), "Order at the top of the band rests");
+    CHECK(book.CancelOrder(3), "Order at the top of the band can be cancelled");
+}
+
+static void test_tick_book_pool_recycles_slots() {
+    std::cout << "\n=== test_tick_book_pool_recycles_slots ===\n";
+
+    TickOrderBook book(InstrumentSpec(1.0, 1.0, 10.0), 4);
+
+    for (uint64_t id = 1; id <= 3; ++id) {
+        book.ProcessOrder(Order(id, 0, Id("Biden"), SIDE::BUY, 5.0, 1));
+    }
+    CHECK(book.Pool().Size() == 3, "Three resting orders hold three slots");
+
+    book.CancelOrder(2);
+    book.ProcessOrder(Order(4, 0, Id("Donald"), SIDE::SELL, 5.0, 2));
+    CHECK(book.Pool().Size() == 0, "Cancel and fills release their slots");
+
+    for (uint64_t id = 5; id <= 8; ++id) {
+        book.ProcessOrder(Order(id, 0, Id("Obama"), SIDE::SELL, 6.0, 1));
+    }
+    CHECK(book.Pool().HighWaterMark() == 4,
+          "Freed slots are reused before new ones are taken");
+
+    bool threw = false;
+    try {
+        book.ProcessOrder(Order(9, 0, Id("Obama"), SIDE::SELL, 7.0, 1));
+    } catch (const std::length_error &) {
+        threw = true;
+    }
+    CHECK(threw, "Resting beyond pool capacity is rejected");
+
+    auto trades = book.ProcessOrder(Order(10, 0, Id("Trump"), SIDE::BUY, 7.0, 4));
+    CHECK(trades.size() == 4, "Book is intact after a rejected order");
+}
+
+static void test_tick_book_full_pool_rejects_before_trading() {
+    std::cout << "\n=== test_tick_book_full_pool_rejects_before_trading ===\n";
+
+    TickOrderBook book(InstrumentSpec(1.0, 90.0, 110.0), 2);
+    std::vector<Fill> fills;
+    CallbackSink sink([&](const Fill &f) { fills.push_back(f); });
+    book.ProcessOrder(Order(1, 1, Id("Donald"), SIDE::SELL, 100.0, 10), sink);
+    book.ProcessOrder(Order(2, 2, Id("Trump"), SIDE::BUY, 98.0, 5), sink);
+
+    bool threw = false;
+    try {
+        book.ProcessOrder(Order(3, 3, Id("Biden"), SIDE::BUY, 99.0, 15),
+                          sink);
+    } catch (const std::length_error &) {
+        threw = true;
+    }
+    CHECK(threw && book.OpenQty(3) == 0 && book.Pool().Size() == 2,
+          "Order that cannot rest on a full pool is rejected");
+
+    // Trades through the ask, whose slot then takes the remainder.
+    book.ProcessOrder(Order(6, 6, Id("Biden"), SIDE::BUY, 100.0, 15), sink);
+    CHECK(fills.size() == 1 && fills[0].qty == 10 && book.OpenQty(6) == 5,
+          "Crossing order on a full pool trades and rests its remainder");
+    book.CancelOrder(6);
+    book.ProcessOrder(Order(1, 1, Id("Donald"), SIDE::SELL, 100.0, 10), sink);
+    fills.clear();
+
+    // The market order trades and sets off a stop-limit that cannot rest.
+    Order stop(4, 4, Id("Obama"), SIDE::BUY, 99.0, 3, TYPE::STOP_LIMIT_ORDER);
+    stop.StopPrice(100.0);
+    book.ProcessOrder(stop, sink);
+    book.ProcessOrder(Order(5, 5, Id("Biden"), SIDE::BUY, 0.0, 1,
+                            TYPE::MARKET_ORDER),
+                      sink);
+    CHECK(fills.size() == 1 && book.OpenQty(1) == 9 && book.OpenQty(4) == 0 &&
+              book.Pool().Size() == 2,
+          "Trade that sets off a stop-limit stands when the stop cannot rest");
+}
+
+static void test_fill_sink_matches_trade_vector() {
+    std::cout << "\n=== test_fill_sink_matches_trade_vector ===\n";
+
+    TickOrderBook vector_book(InstrumentSpec(1.0, 90.0, 110.0));
+    TickOrderBook sink_book(InstrumentSpec(1.0, 90.0, 110.0));
+    FillRing ring(16);
+
+    const Order resting[] = {
+        Order(1, 1, Id("Donald"), SIDE::SELL, 100.0, 2),
+        Order(2, 2, Id("Trump"), SIDE::SELL, 100.0, 2),
+        Order(3, 3, Id("Obama"), SIDE::SELL, 101.0, 5),
+    };
+    for (const auto &o : resting) {
+        vector_book.ProcessOrder(o);
+        sink_book.ProcessOrder(o, ring);
+    }
+    CHECK(ring.Empty(), "Resting orders write no fills");
+
+    Order sweep(4, 4, Id("Biden"), SIDE::BUY, 101.0, 6);
+    auto trades = vector_book.ProcessOrder(sweep);
+    sink_book.ProcessOrder(sweep, ring);
+
+    CHECK(ring.Size() == 3 && trades.size() == 3,
+          "Sweep writes one fill per trade");
+    const uint64_t expected_sells[] = {1, 2, 3};
+    bool same = ring.Size() == trades.size();
+    for (size_t i = 0; same && i < ring.Size(); ++i) {
+        const Fill &f = ring[i];
+        same = f.buy_order_id == 4 && f.sell_order_id == expected_sells[i] &&
+               f.buyer == trades[i]->Buyer() &&
+               f.seller == trades[i]->Seller() &&
+               f.timestamp == trades[i]->Timestamp() &&
+               f.price == trades[i]->Price() && f.qty == trades[i]->Qty();
+    }
+    CHECK(same, "Fills carry the same ids, prices and qtys as the trades");
+
+    bool threw = false;
+    FillRing tiny(1);
+    try {
+        OrderBook map_book;
+        map_book.ProcessOrder(Order(5, 5, Id("Donald"), SIDE::SELL, 100.0, 1), tiny);
+        map_book.ProcessOrder(Order(6, 6, Id("Trump"), SIDE::SELL, 100.0, 1), tiny);
+        map_book.ProcessOrder(Order(7, 7, Id("Biden"), SIDE::BUY, 100.0, 2), tiny);
+    } catch (const std::length_error &) {
+        threw = true;
+    }
+    CHECK(threw, "A full FillRing reports overflow instead of dropping fills");
+}
+
+static void test_trader_table_interns_names() {
+    std::cout << "\n=== test_trader_table_interns_names ===\n";
+
+    TraderTable table;
+    const TraderId a = table.Intern("Biden");
+    const TraderId b = table.Intern("Donald");
+    CHECK(a != b, "Distinct names get distinct ids");
+    CHECK(table.Intern(std::string_view("Biden")) == a,
+          "Re-interning a name returns its existing id");
+    CHECK(table.Size() == 2, "Table holds one entry per distinct name");
+    CHECK(table.Name(b) == "Donald", "Ids resolve back to their names");
+}
+
+static void test_matching_engine_preserves_per_symbol_order() {
+    std::cout << "\n=== test_matching_engine_preserves_per_symbol_order ===\n";
+
+    constexpr SymbolId kSymbols = 8;
+    const InstrumentSpec spec(1.0, 1.0, 64.0);
+
+    struct Recorder : EngineListener {
+        std::vector<std::vector<Fill>> fills =
+            std::vector<std::vector<Fill>>(kSymbols);
+        void OnFill(SymbolId symbol, const Fill &fill) override {
+            fills[symbol].push_back(fill);
+        }
+    } recorder;
+
+    MatchingEngine engine(3, &recorder, 64, false);
+    std::vector<TickOrderBook> reference;
+    std::vector<FillRing> expected;
+    for (SymbolId s = 0; s < kSymbols; ++s) {
+        engine.AddInstrument(s, spec, 4096);
+        reference.emplace_back(spec, 4096);
+        expected.emplace_back(100000);
+    }
+    engine.Start();
+
+    std::mt19937_64 rng(7);
+    for (uint64_t id = 1; id <= 50000; ++id) {
+        const SymbolId symbol = static_cast<SymbolId>(rng() % kSymbols);
+        if (rng() % 4 == 0) {
+            const uint64_t victim = 1 + rng() % id;
+            engine.Cancel(symbol, victim);
+            reference[symbol].CancelOrder(victim);
+            continue;
+        }
+        Order o(id, static_cast<int64_t>(id), static_cast<TraderId>(rng() % 5),
+                (rng() & 1) ? SIDE::BUY : SIDE::SELL,
+                static_cast<double>(24 + rng() % 16), 1 + rng() % 20);
+        engine.Submit(symbol, o);
+        reference[symbol].ProcessOrder(o, expected[symbol]);
+    }
+    engine.Stop();
+
+    bool same = true;
+    uint64_t total = 0;
+    for (SymbolId s = 0; s < kSymbols; ++s) {
+        const auto &got = recorder.fills[s];
+        total += got.size();
+        same = same && got.size() == expected[s].Size();
+        for (size_t i = 0; same && i < got.size(); ++i) {
+            const Fill &e = expected[s][i];
+            same = got[i].buy_order_id == e.buy_order_id &&
+                   got[i].sell_order_id == e.sell_order_id &&
+                   got[i].qty == e.qty && got[i].price == e.price;
+        }
+    }
+    CHECK(engine.MessagesProcessed() == 50000, "Every message is processed");
+    CHECK(engine.FillsEmitted() == total && total > 0,
+          "Engine fill count matches the listener");
+    CHECK(same, "Sharded fills equal single-threaded fills per symbol");
+}
+
+static void test_order_id_index_churn() {
+    std::cout << "\n=== test_order_id_index_churn ===\n";
+
+    // Mostly dense increasing ids with random erases, plus a few far-away
+    // ids that must take the overflow path, checked against a std map.
+    OrderIdIndex<uint32_t> index;
+    std::unordered_map<uint64_t, uint32_t> expected;
+    std::mt19937_64 rng(11);
+    uint64_t next_id = 1;
+    bool consistent = true;
+    for (uint32_t step = 0; step < 200000; ++step) {
+        const uint64_t r = rng() % 100;
+        if (r < 55) {
+            const uint64_t id = next_id++;
+            index.Assign(id, step);
+            expected[id] = step;
+        } else if (r < 57) {
+            const uint64_t id = (rng() | (uint64_t{1} << 40)) - 1;
+            index.Assign(id, step);
+            expected[id] = step;
+        } else if (!expected.empty()) {
+            // Erase an existing id most of the time, a missing one otherwise.
+            const uint64_t id =
+                r < 95 ? expected.begin()->first : rng() % (next_id + 10);
+            const bool had = expected.erase(id) > 0;
+            consistent &= index.Erase(id) == had;
+        }
+        if (step % 1000 == 0) {
+            for (const auto &[id, v] : expected) {
+                const uint32_t *found = index.Find(id);
+                consistent &= found && *found == v;
+            }
+            consistent &= index.Size() == expected.size();
+        }
+    }
+    CHECK(consistent, "Index agrees with std::unordered_map under churn");
+    CHECK(index.Find(next_id + 5) == nullptr, "Unknown id is not found");
+}
+
+static void test_order_id_index_sparse_ids() {
+    std::cout << "\n=== test_order_id_index_sparse_ids ===\n";
+
+    // Ids four pages apart would each open a page of their own.
+    OrderIdIndex<uint32_t> sparse;
+    bool found = true;
+    for (uint32_t i = 0; i < 20000; ++i) {
+        sparse.Assign(1 + uint64_t{i} * 4096, i);
+    }
+    for (uint32_t i = 0; i < 20000; i += 2) {
+        found &= sparse.Erase(1 + uint64_t{i} * 4096);
+    }
+    for (uint32_t i = 1; i < 20000; i += 2) {
+        const uint32_t *v = sparse.Find(1 + uint64_t{i} * 4096);
+        found &= v && *v == i;
+    }
+    CHECK(found && sparse.Size() == 10000, "Sparse ids are all indexed");
+    CHECK(sparse.Pages() <= 16, "Sparse ids do not get a page each");
+
+    // Dense ids after the sparse ones still fill pages.
+    OrderIdIndex<uint32_t> dense;
+    dense.Assign(1, 0);
+    dense.Assign(1 + 4096 * 100, 0);
+    for (uint32_t i = 0; i < 100000; ++i) {
+        dense.Assign(1'000'000 + uint64_t{i}, i);
+    }
+    for (uint32_t i = 0; i < 100000; ++i) {
+        const uint32_t *v = dense.Find(1'000'000 + uint64_t{i});
+        found &= v && *v == i;
+    }
+    CHECK(found && dense.Size() == 100002, "Dense run is indexed");
+    CHECK(dense.Pages() >= 98 && dense.Pages() <= 128,
+          "Dense run is paged");
+}
+
+static void test_journal_recovery() {
+    std::cout << "\n=== test_journal_recovery ===\n";
+
+    namespace fs = std::filesystem;
+    const fs::path dir = fs::temp_directory_path() / "orderbook_journal_test";
+    fs::remove_all(dir);
+
+    const InstrumentSpec spec(0.01, 99.0, 101.0);
+    JournalOptions opts;
+    opts.dir = dir.string();
+    opts.group_commit = 64;
+    opts.sync = false;
+    opts.snapshot_every = 0;
+
+    auto resting = [](const TickOrderBook &book) {
+        std::vector<std::tuple<uint64_t, double, uint32_t>> out;
+        book.ForEachResting([&](const Order &o) {
+            out.emplace_back(o.OrderId(), o.Price(), o.QtyRemaining());
+        });
+        return out;
+    };
+
+    TickOrderBook original(spec);
+    CallbackSink ignore([](const Fill &) {});
+    std::mt19937_64 rng(5);
+    {
+        JournaledBook<TickOrderBook> journaled(original, opts);
+        for (uint64_t id = 1; id <= 4000; ++id) {
+            const double price = 99.0 + static_cast<double>(rng() % 201) * 0.01;
+            const uint32_t qty = static_cast<uint32_t>(1 + rng() % 50);
+            const SIDE side = rng() % 2 ? SIDE::BUY : SIDE::SELL;
+            switch (rng() % 4) {
+            case 0:
+                journaled.CancelOrder(1 + rng() % id);
+                break;
+            case 1:
+                journaled.ModifyOrder(1 + rng() % id, price, qty, ignore);
+                break;
+            default:
+                journaled.ProcessOrder(Order(id, id, 1, side, price, qty),
+                                       ignore);
+                break;
+            }
+            if (id == 2500) {
+                journaled.Snapshot();
+            }
+        }
+        // Off-grid, so rejected both now and on replay.
+        try {
+            journaled.ProcessOrder(Order(4001, 4001, 1, SIDE::BUY, 100.005, 1),
+                                   ignore);
+        } catch (const std::invalid_argument &) {
+        }
+        journaled.Flush();
+    }
+
+    // A record torn by a crash mid-write.
+    std::ofstream(JournalSegmentPath(opts.dir, 2501),
+                  std::ios::binary | std::ios::app)
+        << std::string(20, '\x7f');
+
+    TickOrderBook recovered(spec);
+    JournaledBook<TickOrderBook> journaled(recovered, opts);
+    const RecoveryStats &stats = journaled.Recovery();
+    CHECK(stats.snapshot_seq == 2500, "Snapshot covers the first 2500 ops");
+    CHECK(stats.replayed == 1501, "Only the journal tail is replayed");
+    CHECK(stats.truncated_bytes == 20, "Torn tail record is discarded");
+    CHECK(stats.max_order_id == 4001, "Largest order id is recovered");
+    CHECK(resting(recovered) == resting(original),
+          "Recovered book equals the original, order by order");
+    CHECK(fs::file_size(JournalSegmentPath(opts.dir, 2501)) == 1501 * kJournalRecordSize,
+          "Journal is truncated to its last whole record");
+
+    fs::remove_all(dir);
+}
+
+static void test_journal_resume_after_fills() {
+    std::cout << "\n=== test_journal_resume_after_fills ===\n";
+
+    namespace fs = std::filesystem;
+    const fs::path dir = fs::temp_directory_path() / "orderbook_resume_test";
+    fs::remove_all(dir);
+
+    JournalOptions opts;
+    opts.dir = dir.string();
+    opts.sync = false;
+    opts.snapshot_every = 4;
+
+    CallbackSink ignore([](const Fill &) {});
+    {
+        OrderBook book;
+        JournaledBook<OrderBook> journaled(book, opts);
+        journaled.ProcessOrder(Order(1, 1, 1, SIDE::BUY, 99.50, 5), ignore);
+        journaled.ProcessOrder(Order(2, 2, 1, SIDE::SELL, 100.50, 5), ignore);
+        // Orders 3 and 4 trade out before the automatic snapshot.
+        journaled.ProcessOrder(Order(3, 3, 1, SIDE::BUY, 100.00, 5), ignore);
+        journaled.ProcessOrder(Order(4, 4, 2, SIDE::SELL, 100.00, 5), ignore);
+    }
+
+    OrderBook recovered;
+    JournaledBook<OrderBook> journaled(recovered, opts);
+    const RecoveryStats &stats = journaled.Recovery();
+    CHECK(stats.snapshot_seq == 4 && stats.replayed == 0,
+          "Recovery starts from the snapshot with an empty tail");
+    CHECK(stats.snapshot_orders == 2, "Only the resting orders are saved");
+    CHECK(stats.max_order_id == 4,
+          "Ids of orders filled before the snapshot are not reused");
+
+    fs::remove_all(dir);
+}
+
+template <typename Book>
+static void CheckBookStats(Book &book, const std::string &name) {
+    CallbackSink ignore([](const Fill &) {});
+    book.ProcessOrder(Order(1, 1, 1, SIDE::SELL, 100.00, 10), ignore);
+    book.ProcessOrder(Order(2, 2, 1, SIDE::SELL, 100.01, 10), ignore);
+    book.ProcessOrder(Order(3, 3, 1, SIDE::SELL, 100.01, 10), ignore);
+    book.ProcessOrder(Order(4, 4, 1, SIDE::BUY, 99.00, 5), ignore);
+    // Clears 100.00 and one order of 100.01.
+    book.ProcessOrder(Order(5, 5, 2, SIDE::BUY, 100.01, 20), ignore);
+    book.CancelOrder(3);
+    book.CancelOrder(42);
+
+    const BookStats s = book.Stats();
+    CHECK(s.resting_orders == 1 && s.bid_levels == 1 && s.ask_levels == 0,
+          name + " gauges reflect the book");
+    if (!s.enabled) {
+        CHECK(s.orders == 0 && s.process_latency.samples == 0,
+              name + " counters stay zero when compiled out");
+        return;
+    }
+    CHECK(s.orders == 5 && s.fills == 2, name + " counts orders and fills");
+    CHECK(s.cancels == 1 && s.cancel_misses == 1,
+          name + " counts cancel hits and misses");
+    CHECK(s.levels_swept == 1 && s.max_levels_swept == 1,
+          name + " counts swept levels");
+    CHECK(s.max_queue_length == 2, name + " tracks the longest queue");
+    CHECK(s.process_latency.samples == 5 && s.cancel_latency.samples == 2,
+          name + " times every call");
+}
+
+static void test_book_stats() {
+    std::cout << "\n=== test_book_stats ===\n";
+    OrderBook map_book;
+    CheckBookStats(map_book, "OrderBook");
+    TickOrderBook tick_book(InstrumentSpec(0.01, 99.0, 101.0));
+    CheckBookStats(tick_book, "TickOrderBook");
+}
+
+template <typename Book> static void CheckProcessBatch(const std::string &name) {
+    auto make_book = [] {
+        if constexpr (std::is_same_v<Book, TickOrderBook>) {
+            return TickOrderBook(InstrumentSpec(0.01, 99.0, 101.0));
+        } else {
+            return OrderBook();
+        }
+    };
+    Book one = make_book();
+    Book batched = make_book();
+
+    std::mt19937_64 rng(9);
+    std::vector<Order> orders;
+    for (uint64_t id = 1; id <= 3000; ++id) {
+        const double price = 99.5 + static_cast<double>(rng() % 101) * 0.01;
+        const TYPE type = rng() % 10 == 0 ? TYPE::IOC_ORDER : TYPE::LIMIT_ORDER;
+        orders.emplace_back(id, id, static_cast<TraderId>(rng() % 7),
+                            rng() % 2 ? SIDE::BUY : SIDE::SELL, price,
+                            static_cast<uint32_t>(1 + rng() % 40), type);
+    }
+
+    std::vector<Fill> expected, got;
+    CallbackSink to_expected([&](const Fill &f) { expected.push_back(f); });
+    CallbackSink to_got([&](const Fill &f) { got.push_back(f); });
+    for (const Order &o : orders) {
+        one.ProcessOrder(o, to_expected);
+    }
+    // Uneven slices so batches straddle the internal chunking.
+    for (size_t begin = 0; begin < orders.size();) {
+        const size_t n = std::min<size_t>(1 + rng() % 150, orders.size() - begin);
+        batched.ProcessBatch(std::span<const Order>(&orders[begin], n), to_got);
+        begin += n;
+    }
+
+    bool same = expected.size() == got.size();
+    for (size_t i = 0; same && i < got.size(); ++i) {
+        const Fill &x = expected[i], &y = got[i];
+        same = x.buy_order_id == y.buy_order_id &&
+               x.sell_order_id == y.sell_order_id && x.price == y.price &&
+               x.qty == y.qty;
+    }
+    std::vector<DepthLevel> a, b;
+    for (SIDE side : {SIDE::BUY, SIDE::SELL}) {
+        one.Depth(side, 1000, a);
+        batched.Depth(side, 1000, b);
+        same &= a.size() == b.size();
+        for (size_t i = 0; same && i < a.size(); ++i) {
+            same = SameLevel(side, a[i], side, b[i]);
+        }
+    }
+    CHECK(same && !got.empty(),
+          name + " ProcessBatch matches ProcessOrder fill for fill");
+}
+
+static void test_process_batch() {
+    std::cout << "\n=== test_process_batch ===\n";
+    CheckProcessBatch<OrderBook>("OrderBook");
+    CheckProcessBatch<TickOrderBook>("TickOrderBook");
+
+    // An off-grid order stops the batch there; earlier orders are applied.
+    TickOrderBook book(InstrumentSpec(0.01, 99.0, 101.0));
+    CallbackSink ignore([](const Fill &) {});
+    const std::vector<Order> orders{
+        Order(1, 1, 1, SIDE::BUY, 100.00, 5),
+        Order(2, 2, 1, SIDE::BUY, 100.005, 5),
+        Order(3, 3, 1, SIDE::BUY, 100.01, 5)};
+    bool threw = false;
+    try {
+        book.ProcessBatch(orders, ignore);
+    } catch (const std::invalid_argument &) {
+        threw = true;
+    }
+    const auto bid = book.BestBid();
+    CHECK(threw && bid && bid->price == 100.00 && bid->orders == 1,
+          "Off-grid order in a batch throws after applying earlier ones");
+}
+
+static void test_lazy_cancel_matches_eager() {
+    std::cout << "\n=== test_lazy_cancel_matches_eager ===\n";
+
+    OrderBook eager;
+    // A small threshold so compaction also runs in the middle of the flow.
+    OrderBook lazy(OrderBookOptions{.lazy_cancel = true,
+                                    .compact_threshold = 64});
+
+    std::vector<LevelUpdate> eager_updates, lazy_updates;
+    struct Recorder : DepthSink {
+        std::vector<LevelUpdate> &out;
+        explicit Recorder(std::vector<LevelUpdate> &_out) : out{_out} {}
+        void OnLevelUpdate(const LevelUpdate &u) override { out.push_back(u); }
+    };
+    Recorder eager_recorder(eager_updates), lazy_recorder(lazy_updates);
+    eager.SetDepthSink(&eager_recorder);
+    lazy.SetDepthSink(&lazy_recorder);
+
+    std::vector<Fill> expected, got;
+    CallbackSink to_expected([&](const Fill &f) { expected.push_back(f); });
+    CallbackSink to_got([&](const Fill &f) { got.push_back(f); });
+
+    std::mt19937_64 rng(11);
+    std::vector<DepthLevel> a, b;
+    bool same_depth = true;
+    bool same_cancels = true;
+    for (uint64_t id = 1; id <= 6000; ++id) {
+        const double price = 99.8 + static_cast<double>(rng() % 41) * 0.01;
+        const uint32_t qty = static_cast<uint32_t>(1 + rng() % 40);
+        switch (rng() % 8) {
+        case 0:
+        case 1:
+        case 2: {
+            const uint64_t victim = 1 + rng() % id;
+            const bool hit = eager.CancelOrder(victim);
+            same_cancels &= hit == lazy.CancelOrder(victim);
+            break;
+        }
+        case 3: {
+            const uint64_t victim = 1 + rng() % id;
+            eager.ModifyOrder(victim, price, qty, to_expected);
+            lazy.ModifyOrder(victim, price, qty, to_got);
+            break;
+        }
+        default: {
+            const Order o(id, id, static_cast<TraderId>(rng() % 5),
+                          (rng() & 1) ? SIDE::BUY : SIDE::SELL, price, qty);
+            eager.ProcessOrder(o, to_expected);
+            lazy.ProcessOrder(o, to_got);
+        }
+        }
+        if (id % 1000 == 0) {
+            lazy.Compact();
+        }
+        for (SIDE side : {SIDE::BUY, SIDE::SELL}) {
+            eager.Depth(side, 5, a);
+            lazy.Depth(side, 5, b);
+            same_depth &= a.size() == b.size();
+            for (size_t i = 0; same_depth && i < a.size(); ++i) {
+                same_depth &= SameLevel(side, a[i], side, b[i]);
+            }
+        }
+    }
+    CHECK(same_cancels, "Lazy cancel reports the same hits and misses");
+    CHECK(same_depth, "Lazy cancel depth agrees with eager on every message");
+
+    bool same_fills = expected.size() == got.size();
+    for (size_t i = 0; same_fills && i < got.size(); ++i) {
+        same_fills = expected[i].buy_order_id == got[i].buy_order_id &&
+                     expected[i].sell_order_id == got[i].sell_order_id &&
+                     expected[i].qty == got[i].qty;
+    }
+    CHECK(same_fills && !got.empty(), "Lazy cancel fills match eager");
+
+    bool same_stream = eager_updates.size() == lazy_updates.size();
+    for (size_t i = 0; same_stream && i < lazy_updates.size(); ++i) {
+        const auto &e = eager_updates[i];
+        const auto &l = lazy_updates[i];
+        same_stream &= SameLevel(e.side, {e.price, e.qty, e.orders}, l.side,
+                                 {l.price, l.qty, l.orders});
+    }
+    CHECK(same_stream, "Lazy cancel level updates match eager");
+
+    std::vector<uint64_t> eager_ids, lazy_ids;
+    eager.ForEachResting(
+        [&](const Order &o) { eager_ids.push_back(o.OrderId()); });
+    lazy.ForEachResting(
+        [&](const Order &o) { lazy_ids.push_back(o.OrderId()); });
+    const BookStats es = eager.Stats(), ls = lazy.Stats();
+    CHECK(eager_ids == lazy_ids && es.resting_orders == ls.resting_orders &&
+              es.bid_levels == ls.bid_levels && es.ask_levels == ls.ask_levels,
+          "Lazy cancel leaves the same resting orders and levels");
+}
+
+static void test_lazy_cancel_keeps_best_level_live() {
+    std::cout << "\n=== test_lazy_cancel_keeps_best_level_live ===\n";
+
+    // One bid on each of ten levels, order i at 100.01 - i / 100.
+    OrderBook book(OrderBookOptions{.lazy_cancel = true});
+    for (uint64_t id = 1; id <= 10; ++id) {
+        const double price = static_cast<double>(10001 - id) / 100.0;
+        book.ProcessOrder(Order(id, static_cast<int64_t>(id), Id("Biden"),
+                                SIDE::BUY, price, 10));
+    }
+
+    CHECK(book.CancelOrder(5) && book.Stats().dead_orders == 1 &&
+              book.BestBid()->price == 100.0,
+          "A level emptied below the top stays until it is reached");
+
+    for (uint64_t id = 1; id <= 4; ++id) {
+        book.CancelOrder(id);
+    }
+    BookStats s = book.Stats();
+    CHECK(book.BestBid()->price == 99.95 && s.dead_orders == 0 &&
+              s.bid_levels == 5,
+          "Cancelling the top levels erases them and the dead level below");
+
+    book.CancelOrder(7);
+    book.ProcessOrder(Order(11, 11, Id("Donald"), SIDE::SELL, 99.95, 10));
+    s = book.Stats();
+    CHECK(book.BestBid()->price == 99.93 && s.dead_orders == 0 &&
+              s.bid_levels == 3,
+          "A fill that empties the top level erases the dead level below");
+}
+
+static void test_book_copies_are_independent() {
+    std::cout << "\n=== test_book_copies_are_independent ===\n";
+
+    // Mixed flow with cancels, amends, stops and icebergs; the same seed
+    // sends the same messages to any book.
+    auto run = [](auto &book, uint64_t seed, uint64_t first_id,
+                  uint64_t last_id) {
+        std::vector<Fill> fills;
+        CallbackSink sink([&](const Fill &f) { fills.push_back(f); });
+        std::mt19937_64 rng(seed);
+        for (uint64_t id = first_id; id <= last_id; ++id) {
+            const double price = 99.8 + static_cast<double>(rng() % 41) * 0.01;
+            const uint32_t qty = static_cast<uint32_t>(1 + rng() % 40);
+            Order o(id, static_cast<int64_t>(id),
+                    static_cast<TraderId>(rng() % 5),
+                    (rng() & 1) ? SIDE::BUY : SIDE::SELL, price, qty);
+            switch (rng() % 8) {
+            case 0:
+            case 1:
+                book.CancelOrder(1 + rng() % id);
+                continue;
+            case 2:
+                book.ModifyOrder(1 + rng() % id, price, qty, sink);
+                continue;
+            case 3:
+                o.Type(TYPE::STOP_LIMIT_ORDER);
+                o.StopPrice(99.8 + static_cast<double>(rng() % 41) * 0.01);
+                break;
+            case 4:
+                o.DisplayQty(static_cast<uint32_t>(1 + rng() % 8));
+                break;
+            default:
+                break;
+            }
+            book.ProcessOrder(o, sink);
+        }
+        return fills;
+    };
+    auto same = [](const std::vector<Fill> &a, const std::vector<Fill> &b) {
+        bool eq = a.size() == b.size() && !a.empty();
+        for (size_t i = 0; eq && i < a.size(); ++i) {
+            eq = a[i].buy_order_id == b[i].buy_order_id &&
+                 a[i].sell_order_id == b[i].sell_order_id &&
+                 a[i].qty == b[i].qty && a[i].price == b[i].price;
+        }
+        return eq;
+    };
+
+    // The copy runs the continuation first, so anything it shared with the
+    // original would make the original's run diverge.
+    auto check = [&](auto &book, auto copy, auto &assigned,
+                     const std::string &name) {
+        const auto from_copy = run(copy, 2, 5001, 10000);
+        assigned = book;
+        const auto from_original = run(book, 2, 5001, 10000);
+        const auto from_assigned = run(assigned, 2, 5001, 10000);
+        CHECK(same(from_copy, from_original),
+              name + ": copy trades like the original");
+        CHECK(same(from_assigned, from_original),
+              name + ": assigned copy trades like the original");
+        CHECK(copy.Stats().resting_orders == book.Stats().resting_orders &&
+                  copy.Stats().bid_levels == book.Stats().bid_levels,
+              name + ": copy ends with the same book");
+    };
+
+    OrderBook eager;
+    run(eager, 1, 1, 5000);
+    OrderBook eager_assigned;
+    check(eager, eager, eager_assigned, "Map book");
+
+    // A large threshold keeps lazily cancelled orders in the queues.
+    OrderBook lazy(OrderBookOptions{.lazy_cancel = true});
+    run(lazy, 1, 1, 5000);
+    OrderBook lazy_assigned;
+    check(lazy, lazy, lazy_assigned, "Lazy map book");
+
+    const InstrumentSpec spec(0.01, 99.0, 101.0);
+    TickOrderBook tick(spec, 4096);
+    run(tick, 1, 1, 5000);
+    TickOrderBook tick_assigned(spec, 16);
+    check(tick, tick, tick_assigned, "Tick book");
+}
+
+static void test_order_file_round_trip() {
+    std::cout << "\n=== test_order_file_round_trip ===\n";
+
+    namespace fs = std::filesystem;
+    const fs::path path = fs::temp_directory_path() / "orderbook_test.obo";
+    fs::remove(path);
+
+    TraderTable traders;
+    std::vector<Order> orders;
+    std::mt19937_64 rng(13);
+    for (uint64_t id = 1; id <= 3000; ++id) {
+        const TraderId trader =
+            traders.Intern("trader" + std::to_string(rng() % 9));
+        const double price = 99.0 + static_cast<double>(rng() % 201) * 0.01;
+        const TYPE type = rng() % 10 == 0 ? TYPE::IOC_ORDER : TYPE::LIMIT_ORDER;
+        orders.emplace_back(id, static_cast<int64_t>(id * 1000), trader,
+                            rng() % 2 ? SIDE::BUY : SIDE::SELL, price,
+                            static_cast<uint32_t>(1 + rng() % 40), type);
+    }
+    {
+        OrderFileWriter writer(path.string(), 100, true);
+        for (const Order &o : orders) {
+            writer.Add(o.Timestamp(), o.Trader(), o.Side(), o.Type(),
+                       o.Price(), o.Qty());
+        }
+        bool threw = false;
+        try {
+            writer.Add(0, 0, SIDE::BUY, TYPE::LIMIT_ORDER, 100.005, 1);
+        } catch (const std::invalid_argument &) {
+            threw = true;
+        }
+        CHECK(threw, "Price finer than the price scale is rejected");
+        CHECK(!fs::exists(path), "Order file appears only on commit");
+        writer.Commit(traders);
+    }
+
+    CHECK(OrderFile::Detect(path.string()), "Order file is detected");
+    const OrderFile file(path.string());
+    const auto records = file.Records();
+    bool same = records.size() == orders.size() && file.HasTimestamps() &&
+                file.TraderNames().size() == traders.Size();
+    for (size_t i = 0; same && i < records.size(); ++i) {
+        const OrderFileRecord &r = records[i];
+        const Order &o = orders[i];
+        same = file.Valid(r) && r.timestamp == o.Timestamp() &&
+               file.TraderNames()[r.trader] == traders.Name(o.Trader()) &&
+               r.side == o.Side() && r.type == o.Type() &&
+               file.Price(r) == o.Price() && r.qty == o.Qty();
+    }
+    CHECK(same, "Records read back exactly as written");
+
+    // A copy cut short inside the trader table is refused.
+    const fs::path cut = path.string() + ".cut";
+    fs::copy_file(path, cut, fs::copy_options::overwrite_existing);
+    fs::resize_file(cut, fs::file_size(path) - 3);
+    bool threw = false;
+    try {
+        const OrderFile truncated(cut.string());
+    } catch (const std::runtime_error &) {
+        threw = true;
+    }
+    CHECK(threw, "Truncated order file is rejected");
+
+    fs::remove(path);
+    fs::remove(cut);
+}
+
+static void test_stop_and_iceberg_orders() {
+    std::cout << "\n=== test_stop_and_iceberg_orders ===\n";
+
+    auto make = [](uint64_t id, SIDE side, double price, uint32_t qty,
+                   TYPE type = TYPE::LIMIT_ORDER) {
+        return Order(id, static_cast<int64_t>(id), Id("Stop"), side, price,
+                     qty, type);
+    };
+    auto stop = [&](uint64_t id, SIDE side, double stop_price, double price,
+                    uint32_t qty, TYPE type) {
+        Order o = make(id, side, price, qty, type);
+        o.StopPrice(stop_price);
+        return o;
+    };
+
+    {
+        OrderBook book;
+        book.ProcessOrder(make(1, SIDE::SELL, 100.00, 10));
+        book.ProcessOrder(make(2, SIDE::SELL, 100.05, 10));
+        book.ProcessOrder(make(3, SIDE::SELL, 100.10, 10));
+        // Fires once 100.05 trades; its own fill at 100.10 then sets off
+        // the stop limit, which finds no asks left and rests.
+        book.ProcessOrder(stop(4, SIDE::BUY, 100.05, 0, 10, TYPE::STOP_ORDER));
+        book.ProcessOrder(
+            stop(5, SIDE::BUY, 100.10, 100.20, 15, TYPE::STOP_LIMIT_ORDER));
+        CHECK(book.ProcessOrder(make(6, SIDE::BUY, 100.00, 5)).size() == 1,
+              "Trades below the stop price leave stops pending");
+        auto trades = book.ProcessOrder(make(7, SIDE::BUY, 100.05, 15));
+        CHECK(trades.size() == 3 && trades[2]->Price() == 100.10 &&
+                  trades[2]->Qty() == 10,
+              "Stop fires as a market order after the triggering trade");
+        CHECK(book.BestBid() && book.BestBid()->price == 100.20 &&
+                  book.BestBid()->qty == 15 && !book.BestAsk(),
+              "Stop fill cascades into a stop limit that rests");
+
+        book.ProcessOrder(
+            stop(8, SIDE::SELL, 99.00, 0, 5, TYPE::STOP_ORDER));
+        CallbackSink ignore([](const Fill &) {});
+        CHECK(!book.ModifyOrder(8, 99.0, 1, ignore),
+              "Pending stop cannot be amended");
+        CHECK(book.CancelOrder(8) && !book.CancelOrder(8),
+              "Pending stop can be cancelled once");
+    }
+
+    {
+        OrderBook book;
+        Order iceberg = make(1, SIDE::SELL, 100.0, 25);
+        iceberg.DisplayQty(10);
+        book.ProcessOrder(iceberg);
+        book.ProcessOrder(make(2, SIDE::SELL, 100.0, 5));
+        CHECK(book.BestAsk() && book.BestAsk()->qty == 15,
+              "Iceberg shows only its display slice");
+        auto trades = book.ProcessOrder(make(3, SIDE::BUY, 100.0, 12));
+        CHECK(trades.size() == 2 && trades[0]->Qty() == 10 &&
+                  trades[1]->Qty() == 2,
+              "Refilled iceberg slice queues behind later orders");
+        CHECK(book.ProcessOrder(make(4, SIDE::BUY, 100.0, 18, TYPE::FOK_ORDER))
+                      .size() == 3,
+              "Fill or kill counts the hidden reserve");
+        CHECK(!book.BestAsk(), "Iceberg fully consumed");
+    }
+
+    // Random flow with stops and icebergs: both books must agree on fills,
+    // depth and the resting orders they report.
+    OrderBook map_book;
+    TickOrderBook tick_book(InstrumentSpec(0.01, 99.0, 101.0));
+    std::vector<Fill> expected, got;
+    CallbackSink to_expected([&](const Fill &f) { expected.push_back(f); });
+    CallbackSink to_got([&](const Fill &f) { got.push_back(f); });
+    std::mt19937_64 rng(21);
+    std::vector<DepthLevel> a, b;
+    bool same_depth = true;
+    bool same_cancels = true;
+    for (uint64_t id = 1; id <= 20000; ++id) {
+        const double price = 99.8 + static_cast<double>(rng() % 41) * 0.01;
+        const uint32_t qty = static_cast<uint32_t>(1 + rng() % 40);
+        const SIDE side = (rng() & 1) ? SIDE::BUY : SIDE::SELL;
+        Order o = make(id, side, price, qty);
+        switch (rng() % 10) {
+        case 0:
+        case 1: {
+            const uint64_t victim = 1 + rng() % id;
+            const bool hit = map_book.CancelOrder(victim);
+            same_cancels &= hit == tick_book.CancelOrder(victim);
+            continue;
+        }
+        case 2: {
+            const uint64_t victim = 1 + rng() % id;
+            map_book.ModifyOrder(victim, price, qty, to_expected);
+            tick_book.ModifyOrder(victim, price, qty, to_got);
+            continue;
+        }
+        case 3:
+            o.Type(rng() & 1 ? TYPE::STOP_ORDER : TYPE::STOP_LIMIT_ORDER);
+            o.StopPrice(99.8 + static_cast<double>(rng() % 41) * 0.01);
+            break;
+        case 4:
+        case 5:
+            o.DisplayQty(static_cast<uint32_t>(1 + rng() % 8));
+            break;
+        case 6:
+            o.Type(rng() & 1 ? TYPE::MARKET_ORDER : TYPE::FOK_ORDER);
+            break;
+        default:
+            break;
+        }
+        map_book.ProcessOrder(o, to_expected);
+        tick_book.ProcessOrder(o, to_got);
+        for (SIDE s : {SIDE::BUY, SIDE::SELL}) {
+            map_book.Depth(s, 5, a);
+            tick_book.Depth(s, 5, b);
+            same_depth &= a.size() == b.size();
+            for (size_t i = 0; same_depth && i < a.size(); ++i) {
+                same_depth &= SameLevel(s, a[i], s, b[i]);
+            }
+        }
+    }
+    bool same_fills = expected.size() == got.size();
+    for (size_t i = 0; same_fills && i < got.size(); ++i) {
+        same_fills = expected[i].buy_order_id == got[i].buy_order_id &&
+                     expected[i].sell_order_id == got[i].sell_order_id &&
+                     expected[i].qty == got[i].qty;
+    }
+    CHECK(same_cancels, "Stop flow: cancels agree between books");
+    CHECK(same_fills && !got.empty(), "Stop flow: fills agree between books");
+    CHECK(same_depth, "Stop flow: depth agrees between books");
+
+    auto key = [](const Order &o) {
+        return std::make_tuple(o.OrderId(), o.Type(), o.QtyRemaining(),
+                               o.DisplayQty(), o.RestingShownQty());
+    };
+    std::vector<decltype(key(std::declval<Order>()))> map_orders,
+        tick_orders, rebuilt_orders;
+    size_t pending_stops = 0;
+    map_book.ForEachResting([&](const Order &o) {
+        map_orders.push_back(key(o));
+        pending_stops += StopBook::IsStop(o);
+    });
+    tick_book.ForEachResting(
+        [&](const Order &o) { tick_orders.push_back(key(o)); });
+    CHECK(map_orders == tick_orders && pending_stops > 0,
+          "Both books report the same resting orders and stops");
+
+    // Records written for the resting orders restore icebergs with their
+    // current slice and stops still pending.
+    OrderBook rebuilt;
+    map_book.ForEachResting([&](const Order &o) {
+        uint8_t block[kJournalRecordSize];
+        EncodeJournalRecord(JournalRecord::New(1, o), block);
+        JournalRecord r{};
+        if (DecodeJournalRecord(block, r)) {
+            rebuilt.ProcessOrder(r.ToOrder());
+        }
+    });
+    rebuilt.ForEachResting(
+        [&](const Order &o) { rebuilt_orders.push_back(key(o)); });
+    bool same_rebuilt_depth = true;
+    for (SIDE s : {SIDE::BUY, SIDE::SELL}) {
+        map_book.Depth(s, 50, a);
+        rebuilt.Depth(s, 50, b);
+        same_rebuilt_depth &= a.size() == b.size();
+        for (size_t i = 0; same_rebuilt_depth && i < a.size(); ++i) {
+            same_rebuilt_depth &= SameLevel(s, a[i], s, b[i]);
+        }
+    }
+    CHECK(rebuilt_orders == map_orders && same_rebuilt_depth,
+          "Journal records round-trip stops and iceberg slices");
+}
+
+static void test_self_trade_prevention() {
+    std::cout << "\n=== test_self_trade_prevention ===\n";
+
+    struct Outcome {
+        std::vector<uint32_t> fills;
+        uint64_t ask_qty;
+        uint64_t bid_qty;
+        bool first_ask_resting;
+    };
+    // Order 1 (Self unless `other_first`) and order 2 rest 10 each at one
+    // price, then Self buys `qty`.
+    auto run = [](auto &book, STP stp, TYPE type, uint32_t qty,
+                  bool other_first) {
+        book.SetSelfTradePrevention(stp);
+        const TraderId first = Id(other_first ? "Other" : "Self");
+        const TraderId second = Id(other_first ? "Self" : "Other");
+        book.ProcessOrder(Order(1, 1, first, SIDE::SELL, 100.0, 10));
+        book.ProcessOrder(Order(2, 2, second, SIDE::SELL, 100.0, 10));
+        Outcome out{};
+        CallbackSink sink([&](const Fill &f) { out.fills.push_back(f.qty); });
+        book.ProcessOrder(
+            Order(3, 3, Id("Self"), SIDE::BUY, 100.0, qty, type), sink);
+        out.ask_qty = book.BestAsk() ? book.BestAsk()->qty : 0;
+        out.bid_qty = book.BestBid() ? book.BestBid()->qty : 0;
+        out.first_ask_resting = book.CancelOrder(1);
+        return out;
+    };
+    auto check = [&](STP stp, TYPE type, const Outcome &want,
+                     const std::string &what, uint32_t qty = 15,
+                     bool other_first = false) {
+        OrderBook map_book;
+        OrderBook lazy_book(OrderBookOptions{.lazy_cancel = true});
+        TickOrderBook tick_book(InstrumentSpec(0.01, 99.0, 101.0));
+        bool ok = true;
+        for (const Outcome &got : {run(map_book, stp, type, qty, other_first),
+                                   run(lazy_book, stp, type, qty, other_first),
+                                   run(tick_book, stp, type, qty,
+                                       other_first)}) {
+            ok &= got.fills == want.fills && got.ask_qty == want.ask_qty &&
+                  got.bid_qty == want.bid_qty &&
+                  got.first_ask_resting == want.first_ask_resting;
+        }
+        CHECK(ok, what);
+    };
+    check(STP::NONE, TYPE::LIMIT_ORDER, {{10, 5}, 5, 0, false},
+          "Without STP an order trades with its own trader");
+    check(STP::CANCEL_NEWEST, TYPE::LIMIT_ORDER, {{}, 20, 0, true},
+          "Cancel newest drops the incoming order at its own order");
+    check(STP::CANCEL_OLDEST, TYPE::LIMIT_ORDER, {{10}, 0, 5, false},
+          "Cancel oldest removes the resting order and keeps matching");
+    check(STP::DECREMENT_BOTH, TYPE::LIMIT_ORDER, {{5}, 5, 0, false},
+          "Decrement both reduces both sides without a trade");
+    check(STP::CANCEL_OLDEST, TYPE::FOK_ORDER, {{}, 20, 0, true},
+          "Fill or kill is killed rather than meet its own order");
+
+    // Fill or kill counts what matching under each policy would take.
+    check(STP::NONE, TYPE::FOK_ORDER, {{10, 5}, 5, 0, false},
+          "Fill or kill without STP trades with its own trader");
+    check(STP::CANCEL_NEWEST, TYPE::FOK_ORDER, {{}, 20, 0, true},
+          "Fill or kill is killed by an own order ahead under cancel newest");
+    check(STP::CANCEL_NEWEST, TYPE::FOK_ORDER, {{10}, 10, 0, false},
+          "Fill or kill fills from orders ahead of its own under cancel "
+          "newest",
+          10, true);
+    check(STP::CANCEL_NEWEST, TYPE::FOK_ORDER, {{}, 20, 0, true},
+          "Fill or kill is killed when too little is ahead of its own order",
+          15, true);
+    check(STP::CANCEL_OLDEST, TYPE::FOK_ORDER, {{10}, 0, 0, false},
+          "Fill or kill cancels its own order and fills under cancel oldest",
+          10);
+    check(STP::DECREMENT_BOTH, TYPE::FOK_ORDER, {{5}, 5, 0, false},
+          "Fill or kill counts own quantity under decrement both");
+
+    // Few traders make self-matches common; every policy must leave both
+    // books (and the lazy map book) agreeing on fills and depth.
+    for (STP stp : {STP::CANCEL_NEWEST, STP::CANCEL_OLDEST,
+                    STP::DECREMENT_BOTH}) {
+        OrderBook map_book;
+        OrderBook lazy_book(OrderBookOptions{.lazy_cancel = true,
+                                             .compact_threshold = 64});
+        TickOrderBook tick_book(InstrumentSpec(0.01, 99.0, 101.0));
+        map_book.SetSelfTradePrevention(stp);
+        lazy_book.SetSelfTradePrevention(stp);
+        tick_book.SetSelfTradePrevention(stp);
+        std::vector<Fill> expected, lazy, got;
+        CallbackSink to_expected([&](const Fill &f) { expected.push_back(f); });
+        CallbackSink to_lazy([&](const Fill &f) { lazy.push_back(f); });
+        CallbackSink to_got([&](const Fill &f) { got.push_back(f); });
+        std::mt19937_64 rng(5 + static_cast<int>(stp));
+        std::vector<DepthLevel> a, b, c;
+        bool same_depth = true;
+        for (uint64_t id = 1; id <= 10000; ++id) {
+            const double price = 99.8 + static_cast<double>(rng() % 41) * 0.01;
+            const uint32_t qty = static_cast<uint32_t>(1 + rng() % 40);
+            const uint64_t victim = 1 + rng() % id;
+            switch (rng() % 8) {
+            case 0:
+                map_book.CancelOrder(victim);
+                lazy_book.CancelOrder(victim);
+                tick_book.CancelOrder(victim);
+                continue;
+            case 1:
+                map_book.ModifyOrder(victim, price, qty, to_expected);
+                lazy_book.ModifyOrder(victim, price, qty, to_lazy);
+                tick_book.ModifyOrder(victim, price, qty, to_got);
+                continue;
+            default:
+                break;
+            }
+            const TYPE types[] = {TYPE::LIMIT_ORDER, TYPE::LIMIT_ORDER,
+                                  TYPE::IOC_ORDER, TYPE::FOK_ORDER};
+            Order o(id, id, static_cast<TraderId>(rng() % 3),
+                    (rng() & 1) ? SIDE::BUY : SIDE::SELL, price, qty,
+                    types[rng() % 4]);
+            if (rng() % 4 == 0) {
+                o.DisplayQty(static_cast<uint32_t>(1 + rng() % 8));
+            }
+            map_book.ProcessOrder(o, to_expected);
+            lazy_book.ProcessOrder(o, to_lazy);
+            tick_book.ProcessOrder(o, to_got);
+            for (SIDE side : {SIDE::BUY, SIDE::SELL}) {
+                map_book.Depth(side, 5, a);
+                lazy_book.Depth(side, 5, b);
+                tick_book.Depth(side, 5, c);
+                same_depth &= a.size() == b.size() && a.size() == c.size();
+                for (size_t i = 0; same_depth && i < a.size(); ++i) {
+                    same_depth &= SameLevel(side, a[i], side, b[i]) &&
+                                  SameLevel(side, a[i], side, c[i]);
+                }
+            }
+        }
+        bool same_fills = expected.size() == got.size() &&
+                          expected.size() == lazy.size();
+        bool no_self_fills = true;
+        for (size_t i = 0; same_fills && i < got.size(); ++i) {
+            same_fills = expected[i].buy_order_id == got[i].buy_order_id &&
+                         expected[i].sell_order_id == got[i].sell_order_id &&
+                         expected[i].qty == got[i].qty &&
+                         lazy[i].buy_order_id == got[i].buy_order_id &&
+                         lazy[i].qty == got[i].qty;
+            no_self_fills &= got[i].buyer != got[i].seller;
+        }
+        const std::string name =
+            "STP policy " + std::to_string(static_cast<int>(stp));
+        CHECK(same_fills && !got.empty() && no_self_fills,
+              name + ": books agree and never fill a trader with itself");
+        CHECK(same_depth, name + ": depth agrees between books");
+    }
+}
+
+#ifdef __linux__
+static void test_gateway_round_trip() {
+    std::cout << "\n=== test_gateway_round_trip ===\n";
+    namespace fs = std::filesystem;
+    const fs::path sock = fs::temp_directory_path() / "orderbook_test.sock";
+
+    GatewayOptions opts;
+    opts.unix_path = sock.string();
+    opts.tcp_port = 0;
+    opts.workers = 2;
+    Gateway gateway(opts);
+    const InstrumentSpec spec(1.0, 1.0, 64.0);
+    gateway.AddInstrument(0, spec, 4096);
+    gateway.AddInstrument(1, spec, 4096);
+    gateway.Start();
+    CHECK(gateway.TcpPort() > 0, "Gateway picks an ephemeral TCP port");
+
+    auto request = [](RequestKind kind, uint64_t client_id, SIDE side,
+                      double price, uint32_t qty, uint64_t tag) {
+        WireRequest r{};
+        r.kind = kind;
+        r.side = side;
+        r.type = TYPE::LIMIT_ORDER;
+        r.client_order_id = client_id;
+        r.tag = tag;
+        r.price = price;
+        r.qty = qty;
+        return r;
+    };
+    // Reads until `completions` requests have been answered.
+    auto await = [](GatewayClient &c, size_t completions) {
+        std::vector<WireReport> got;
+        size_t done = 0;
+        while (done < completions && c.Receive(got)) {
+            done = static_cast<size_t>(
+                std::count_if(got.begin(), got.end(), [](const auto &r) {
+                    return r.kind != ReportKind::FILL;
+                }));
+        }
+        return got;
+    };
+
+    GatewayClient maker(sock.string());
+    GatewayClient taker(gateway.TcpPort());
+
+    // Two sessions use the same client id without colliding.
+    const WireRequest bid =
+        request(RequestKind::NEW, 1, SIDE::BUY, 30.0, 10, 100);
+    maker.Send(std::span(&bid, 1));
+    auto got = await(maker, 1);
+    CHECK(got.size() == 1 && got[0].kind == ReportKind::ACCEPTED &&
+              got[0].tag == 100 && got[0].leaves_qty == 10,
+          "Resting order is accepted with its full size open");
+
+    const WireRequest ask =
+        request(RequestKind::NEW, 1, SIDE::SELL, 30.0, 4, 200);
+    taker.Send(std::span(&ask, 1));
+    got = await(taker, 1);
+    CHECK(got.size() == 2 && got[0].kind == ReportKind::FILL &&
+              got[0].qty == 4 && got[0].price == 30.0 &&
+              got[1].kind == ReportKind::ACCEPTED && got[1].tag == 200 &&
+              got[1].leaves_qty == 0,
+          "Crossing order gets its fill before its completion");
+    got.clear();
+    maker.Receive(got);
+    CHECK(got.size() == 1 && got[0].kind == ReportKind::FILL &&
+              got[0].client_order_id == 1 && got[0].leaves_qty == 6,
+          "Resting side is told of the fill under its own id");
+
+    const WireRequest cancel =
+        request(RequestKind::CANCEL, 1, SIDE::BUY, 0.0, 0, 101);
+    maker.Send(std::span(&cancel, 1));
+    got = await(maker, 1);
+    CHECK(got.size() == 1 && got[0].kind == ReportKind::CANCELED &&
+              got[0].tag == 101,
+          "Cancel of an open order is confirmed");
+    maker.Send(std::span(&cancel, 1));
+    got = await(maker, 1);
+    CHECK(got.size() == 1 && got[0].kind == ReportKind::REJECTED,
+          "Second cancel is rejected");
+
+    WireRequest unknown =
+        request(RequestKind::NEW, 2, SIDE::BUY, 30.0, 1, 102);
+    unknown.symbol = 9;
+    maker.Send(std::span(&unknown, 1));
+    got = await(maker, 1);
+    CHECK(got.size() == 1 && got[0].kind == ReportKind::REJECTED &&
+              got[0].tag == 102,
+          "Order for an unknown symbol is rejected");
+
+    WireRequest stop = request(RequestKind::NEW, 3, SIDE::BUY, 31.0, 1, 103);
+    stop.type = TYPE::STOP_LIMIT_ORDER;
+    maker.Send(std::span(&stop, 1));
+    got = await(maker, 1);
+    CHECK(got.size() == 1 && got[0].kind == ReportKind::REJECTED &&
+              got[0].tag == 103,
+          "Stop order without a stop price field is rejected");
+
+    // A pipelined burst, answered in order per symbol.
+    std::vector<WireRequest> burst;
+    for (uint64_t i = 0; i < 1000; ++i) {
+        WireRequest r = request(RequestKind::NEW, 10 + i,
+                                i % 2 ? SIDE::BUY : SIDE::SELL,
+                                static_cast<double>(20 + i % 20), 5, i);
+        r.symbol = static_cast<uint32_t>(i % 3 == 0);
+        burst.push_back(r);
+    }
+    maker.Send(burst);
+    got = await(maker, burst.size());
+    std::vector<uint64_t> tags;
+    for (const WireReport &r : got) {
+        if (r.kind != ReportKind::FILL) {
+            tags.push_back(r.tag);
+        }
+    }
+    std::sort(tags.begin(), tags.end());
+    bool all = tags.size() == burst.size();
+    for (size_t i = 0; all && i < tags.size(); ++i) {
+        all = tags[i] == i;
+    }
+    CHECK(all, "Every pipelined request is answered once");
+
+    gateway.Stop();
+    CHECK(gateway.RequestsHandled() == 1006,
+          "Gateway counts every request");
+    fs::remove(sock);
+}
+
+static void test_gateway_sheds_clients_without_descriptors() {
+    std::cout << "\n=== test_gateway_sheds_clients_without_descriptors ===\n";
+
+    GatewayOptions opts;
+    opts.tcp_port = 0;
+    Gateway gateway(opts);
+    gateway.AddInstrument(0, InstrumentSpec(1.0, 1.0, 64.0), 64);
+    gateway.Start();
+
+    // Take every descriptor but the one the client's socket needs, so the
+    // gateway's accept fails with EMFILE.
+    rlimit saved{};
+    ::getrlimit(RLIMIT_NOFILE, &saved);
+    rlimit low = saved;
+    low.rlim_cur = std::min<rlim_t>(saved.rlim_cur, 1024);
+    ::setrlimit(RLIMIT_NOFILE, &low);
+    std::vector<int> filler;
+    for (int fd; (fd = ::open("/dev/null", O_RDONLY | O_CLOEXEC)) >= 0;) {
+        filler.push_back(fd);
+    }
+    ::close(filler.back());
+    filler.pop_back();
+    bool hung_up = false;
+    {
+        GatewayClient client(gateway.TcpPort());
+        std::vector<WireReport> got;
+        hung_up = !client.Receive(got);
+    }
+    for (int fd : filler) {
+        ::close(fd);
+    }
+    ::setrlimit(RLIMIT_NOFILE, &saved);
+    CHECK(hung_up && !gateway.Failed(),
+          "Client beyond the descriptor limit is hung up on");
+
+    GatewayClient client(gateway.TcpPort());
+    WireRequest r{};
+    r.kind = RequestKind::NEW;
+    r.client_order_id = 1;
+    r.price = 10.0;
+    r.qty = 1;
+    client.Send(std::span(&r, 1));
+    std::vector<WireReport> got;
+    client.Receive(got);
+    CHECK(got.size() == 1 && got[0].kind == ReportKind::ACCEPTED &&
+              gateway.SessionsAccepted() == 1,
+          "Gateway keeps serving once descriptors are free again");
+    gateway.Stop();
+}
+#endif
+
 int main() {
     test_cancel_prevents_match();
     test_fifo_same_price_sell_side();
     test_price_priority();
+    test_tick_book_matches_map_book();
+    test_modify_order_priority();
+    test_depth_matches_map_book();
+    test_market_ioc_fok();
+    test_tick_book_rejects_off_grid();
+    test_tick_book_pool_recycles_slots();
+    test_order_id_index_churn();
+    test_order_id_index_sparse_ids();
+    test_journal_recovery();
+    test_journal_resume_after_fills();
+    test_book_stats();
+    test_process_batch();
+    test_lazy_cancel_matches_eager();
+    test_lazy_cancel_keeps_best_level_live();
+    test_book_copies_are_independent();
+    test_order_file_round_trip();
+    test_stop_and_iceberg_orders();
+    test_self_trade_prevention();
+    test_tick_book_full_pool_rejects_before_trading();
+    test_fill_sink_matches_trade_vector();
+    test_trader_table_interns_names();
+    test_matching_engine_preserves_per_symbol_order();
+#ifdef __linux__
+    test_gateway_round_trip();
+    test_gateway_sheds_clients_without_descriptors();
+#endif
 
     if (failures == 0) {
         std::cout << "\nALL TESTS PASSED\n";